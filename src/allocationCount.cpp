@@ -0,0 +1,73 @@
+/* allocationCount.cpp -- counting the program's allocations
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cstddef>
+#include <cstdlib>
+
+#include <atomic>
+#include <new>
+
+#include "allocationCount.h"
+
+/* These live in a file of their own so the compiler cannot inline them into
+ * callers, where it mistakes the calls to free for mismatched
+ * deallocations. */
+
+namespace {
+
+    std::atomic<unsigned long long> nAllocations(0);
+
+}
+
+unsigned long long allocationCount() {
+    return nAllocations.load(std::memory_order_relaxed);
+}
+
+void *operator new(const std::size_t size) {
+    nAllocations.fetch_add(1, std::memory_order_relaxed);
+    // malloc(0) may return null, which would look like a failure.
+    void *const result = std::malloc(size == 0 ? 1 : size);
+    if (result == nullptr) {
+        throw std::bad_alloc();
+    }
+    return result;
+}
+
+void *operator new(const std::size_t size, const std::nothrow_t &) noexcept {
+    nAllocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void operator delete(void *const p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *const p, const std::nothrow_t &) noexcept {
+    std::free(p);
+}
+
+// Since C++14, deletes which know the size come here.
+void operator delete(void *const p, std::size_t) noexcept {
+    std::free(p);
+}
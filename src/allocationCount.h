@@ -0,0 +1,35 @@
+/* allocationCount.h -- counting the program's allocations
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifndef PPAML_VREP_AUTOMOBILE_PLUGIN_ALLOCATIONCOUNT_H_
+#define PPAML_VREP_AUTOMOBILE_PLUGIN_ALLOCATIONCOUNT_H_
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+/* Linking allocationCount.cpp into a program replaces the global operator new
+ * with one which counts its calls, from every thread.  This is for
+ * benchmarks; the plugin itself must never replace V-REP's allocator. */
+
+// The number of calls to operator new so far
+unsigned long long allocationCount();
+
+#endif
@@ -0,0 +1,85 @@
+/* arena-inl.h -- append-only storage carved out of large chunks
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifndef PPAML_VREP_AUTOMOBILE_PLUGIN_ARENA_INL_H
+#define PPAML_VREP_AUTOMOBILE_PLUGIN_ARENA_INL_H
+
+#include <algorithm>
+
+template<typename T>
+Arena<T>::Chunk::Chunk(const std::size_t capacity)
+    : data(new T[capacity]), capacity(capacity), size(0) {
+}
+
+template<typename T>
+Arena<T>::Arena(const std::size_t chunkSize)
+    : chunkSize(chunkSize), chunks(), bytes_(0) {
+}
+
+template<typename T>
+T *Arena<T>::allocate(const std::size_t n) {
+    if (n == 0) {
+        return nullptr;
+    }
+    if (chunks.empty() || chunks.back().capacity - chunks.back().size < n) {
+        // Values larger than a chunk get a chunk of their own.
+        chunks.emplace_back(std::max(n, chunkSize));
+        bytes_ += chunks.back().capacity * sizeof(T);
+    }
+    Chunk &last = chunks.back();
+    T *const result = last.data.get() + last.size;
+    last.size += n;
+    return result;
+}
+
+template<typename T>
+std::size_t Arena<T>::growth(const std::size_t n) const {
+    if (n == 0
+        || (! chunks.empty()
+            && chunks.back().capacity - chunks.back().size >= n)) {
+        return 0;
+    } else {
+        return std::max(n, chunkSize) * sizeof(T);
+    }
+}
+
+template<typename T>
+std::size_t Arena<T>::bytes() const {
+    return bytes_;
+}
+
+template<typename T>
+std::size_t Arena<T>::nChunks() const {
+    return chunks.size();
+}
+
+template<typename T>
+Span<const T> Arena<T>::chunk(const std::size_t i) const {
+    return Span<const T>(chunks[i].data.get(), chunks[i].size);
+}
+
+template<typename T>
+void Arena<T>::clear() {
+    // Swap rather than clear, so the vector's own storage goes too.
+    std::vector<Chunk>().swap(chunks);
+    bytes_ = 0;
+}
+
+#endif
@@ -0,0 +1,81 @@
+/* arena.h -- append-only storage carved out of large chunks
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifndef PPAML_VREP_AUTOMOBILE_PLUGIN_ARENA_H
+#define PPAML_VREP_AUTOMOBILE_PLUGIN_ARENA_H
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cstddef>
+
+#include <memory>
+#include <vector>
+
+#include "span.h"
+
+/* Append-only storage for plain values.  Values are carved out of large
+ * chunks, so storing one costs an allocation only when a chunk fills up, and
+ * nothing already stored ever moves.  Everything is freed at once. */
+template<typename T>
+class Arena {
+public:
+    // Chunks hold at least the passed number of values.
+    explicit Arena(std::size_t chunkSize);
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    /* Returns room for the passed number of values, side by side, after
+     * everything allocated so far.  The values are uninitialized. */
+    T *allocate(std::size_t);
+
+    /* The number of bytes 'allocate' would add to 'bytes' if called with the
+     * passed number of values */
+    inline std::size_t growth(std::size_t) const;
+
+    // The number of bytes held by the arena
+    inline std::size_t bytes() const;
+
+    /* The values allocated so far, in order, one span per chunk.  Room a
+     * chunk had left when a larger allocation started a new one is not
+     * included. */
+    inline std::size_t nChunks() const;
+    inline Span<const T> chunk(std::size_t) const;
+
+    // Frees every chunk.
+    void clear();
+
+private:
+    struct Chunk {
+        inline explicit Chunk(std::size_t capacity);
+        std::unique_ptr<T[]> data;
+        std::size_t capacity;
+        std::size_t size;
+    };
+
+    const std::size_t chunkSize;
+    std::vector<Chunk> chunks;
+    std::size_t bytes_;
+};
+
+#include "arena-inl.h"
+
+#endif
@@ -0,0 +1,66 @@
+/* arrowIpc-inl.h -- writing Apache Arrow IPC streams
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifndef PPAML_VREP_AUTOMOBILE_PLUGIN_ARROWIPC_INL_H
+#define PPAML_VREP_AUTOMOBILE_PLUGIN_ARROWIPC_INL_H
+
+#include <cstring>
+
+namespace arrowIpc {
+
+    // struct Field
+
+    Field::Field(const std::string &name, const Type type,
+                 const std::int32_t listSize)
+        : name(name), type(type), listSize(listSize) {
+    }
+
+
+    // class BatchBuilder
+
+    void BatchBuilder::put(const float value) {
+        putScalar(Type::FLOAT32, value);
+    }
+
+    void BatchBuilder::put(const std::uint16_t value) {
+        putScalar(Type::UINT16, value);
+    }
+
+    template<typename T>
+    void BatchBuilder::putScalar(const Type type, const T value) {
+        nextColumn(type, false, 0);
+        std::vector<char> &data = columns[column - 1];
+        const std::vector<char>::size_type end = data.size();
+        data.resize(end + sizeof value);
+        std::memcpy(&data[end], &value, sizeof value);
+        nBytes += sizeof value;
+    }
+
+    std::size_t BatchBuilder::rows() const {
+        return nRows;
+    }
+
+    std::size_t BatchBuilder::bytes() const {
+        return nBytes;
+    }
+
+}
+
+#endif
@@ -0,0 +1,488 @@
+/* arrowIpc.cpp -- writing Apache Arrow IPC streams
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <exception>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "arrowIpc.h"
+
+namespace arrowIpc {
+
+    namespace {
+
+        // Constants from Schema.fbs and Message.fbs //
+
+        const std::int16_t METADATA_V5 = 4;
+
+        const std::uint8_t HEADER_SCHEMA = 1;
+        const std::uint8_t HEADER_RECORD_BATCH = 3;
+
+        const std::uint8_t TYPE_INT = 2;
+        const std::uint8_t TYPE_FLOATING_POINT = 3;
+        const std::uint8_t TYPE_FIXED_SIZE_LIST = 16;
+
+        const std::int16_t PRECISION_SINGLE = 1;
+
+        const std::int16_t ENDIANNESS_LITTLE = 0;
+        const std::int16_t ENDIANNESS_BIG = 1;
+
+        // Messages are framed by this marker and padded to this alignment.
+        const std::uint32_t CONTINUATION = 0xFFFFFFFF;
+        const std::size_t ALIGNMENT = 8;
+
+
+        // Building flatbuffers //
+
+        /* Flatbuffers are usually built back to front, but nothing in the
+         * format requires it: offsets to child objects just have to point
+         * forward.  This builder writes each table and then its children, so
+         * it can work in a single forward pass. */
+        class Flatbuffer {
+        public:
+            inline std::size_t size() const {
+                return bytes.size();
+            }
+
+            inline void pad(const std::size_t alignment) {
+                while (bytes.size() % alignment != 0) {
+                    bytes.push_back(0);
+                }
+            }
+
+            template<typename T>
+            inline void put(const T value) {
+                const std::size_t at = bytes.size();
+                bytes.resize(at + sizeof value);
+                putAt(at, value);
+            }
+
+            template<typename T>
+            inline void putAt(const std::size_t at, const T value) {
+                // Flatbuffers are always little-endian.
+                const std::uint64_t bits = static_cast<std::uint64_t>(value);
+                for (std::size_t i = 0; i < sizeof value; i++) {
+                    bytes[at + i] = static_cast<char>((bits >> (8 * i)) & 0xFF);
+                }
+            }
+
+            // Points the offset at 'at' to the object at 'target'.
+            inline void patchOffset(const std::size_t at,
+                                    const std::size_t target) {
+                putAt(at, static_cast<std::uint32_t>(target - at));
+            }
+
+            std::string bytes;
+        };
+
+        /* A table under construction.  Add fields, then call 'write'; after
+         * that, 'at' gives the position of each offset field so the caller
+         * can write the child object and patch the offset. */
+        class Table {
+        public:
+            template<typename T>
+            void scalar(const unsigned int slot, const T value) {
+                fields.push_back(
+                    FieldSlot(slot, sizeof value,
+                              static_cast<std::uint64_t>(value)));
+            }
+
+            // Adds an offset field and returns its index.
+            unsigned int offset(const unsigned int slot) {
+                fields.push_back(FieldSlot(slot, 4, 0));
+                return fields.size() - 1;
+            }
+
+            std::size_t write(Flatbuffer &fb) {
+                // Lay out the table.  The leading soffset takes four bytes.
+                unsigned int nSlots = 0;
+                std::size_t tableSize = 4;
+                for (FieldSlot &field : fields) {
+                    tableSize = (tableSize + field.size - 1)
+                        / field.size * field.size;
+                    field.local = tableSize;
+                    tableSize += field.size;
+                    if (field.slot + 1 > nSlots) {
+                        nSlots = field.slot + 1;
+                    }
+                }
+                // Write the vtable.
+                fb.pad(2);
+                const std::size_t vtable = fb.size();
+                fb.put(static_cast<std::uint16_t>(4 + 2 * nSlots));
+                fb.put(static_cast<std::uint16_t>(tableSize));
+                for (unsigned int slot = 0; slot < nSlots; slot++) {
+                    std::uint16_t local = 0;
+                    for (const FieldSlot &field : fields) {
+                        if (field.slot == slot) {
+                            local = field.local;
+                        }
+                    }
+                    fb.put(local);
+                }
+                /* Write the table itself.  Aligning its start to eight bytes
+                 * aligns every field. */
+                fb.pad(ALIGNMENT);
+                position = fb.size();
+                fb.put(static_cast<std::int32_t>(position - vtable));
+                for (const FieldSlot &field : fields) {
+                    while (fb.size() < position + field.local) {
+                        fb.put(static_cast<std::uint8_t>(0));
+                    }
+                    for (std::size_t i = 0; i < field.size; i++) {
+                        fb.put(static_cast<std::uint8_t>(
+                                   (field.value >> (8 * i)) & 0xFF));
+                    }
+                }
+                return position;
+            }
+
+            inline std::size_t at(const unsigned int field) const {
+                return position + fields[field].local;
+            }
+
+        private:
+            struct FieldSlot {
+                FieldSlot(unsigned int slot, std::size_t size,
+                          std::uint64_t value)
+                    : slot(slot), size(size), value(value), local(0) {
+                }
+                unsigned int slot;
+                std::size_t size;
+                std::uint64_t value;
+                std::size_t local;
+            };
+
+            std::vector<FieldSlot> fields;
+            std::size_t position;
+        };
+
+        void writeString(Flatbuffer &fb, const std::size_t ref,
+                         const std::string &s) {
+            fb.pad(4);
+            fb.patchOffset(ref, fb.size());
+            fb.put(static_cast<std::uint32_t>(s.size()));
+            fb.bytes.append(s);
+            fb.put(static_cast<std::uint8_t>(0));
+        }
+
+        /* Writes a vector of 16-byte structs made of two int64s--which
+         * describes both FieldNode and Buffer. */
+        void writePairs(Flatbuffer &fb, const std::size_t ref,
+                        const std::vector<std::int64_t> &values) {
+            // The elements, not the length, need eight-byte alignment.
+            fb.pad(4);
+            if ((fb.size() + 4) % ALIGNMENT != 0) {
+                fb.put(static_cast<std::uint32_t>(0));
+            }
+            fb.patchOffset(ref, fb.size());
+            fb.put(static_cast<std::uint32_t>(values.size() / 2));
+            for (const std::int64_t value : values) {
+                fb.put(value);
+            }
+        }
+
+        void writeFields(Flatbuffer &, std::size_t ref, const Schema &);
+
+        void writeField(Flatbuffer &fb, const std::size_t ref,
+                        const Field &field) {
+            Table table;
+            const unsigned int name = table.offset(0);
+            table.scalar(1, static_cast<std::uint8_t>(false));  // nullable
+            table.scalar(2, field.listSize
+                         ? TYPE_FIXED_SIZE_LIST
+                         : field.type == Type::FLOAT32
+                             ? TYPE_FLOATING_POINT
+                             : TYPE_INT);
+            const unsigned int type = table.offset(3);
+            const unsigned int children = table.offset(5);
+            fb.patchOffset(ref, table.write(fb));
+            writeString(fb, table.at(name), field.name);
+            // The type table
+            Table typeTable;
+            if (field.listSize) {
+                typeTable.scalar(0, field.listSize);
+            } else if (field.type == Type::FLOAT32) {
+                typeTable.scalar(0, PRECISION_SINGLE);
+            } else {
+                typeTable.scalar(0, static_cast<std::int32_t>(16));
+                typeTable.scalar(1, static_cast<std::uint8_t>(false));
+            }
+            fb.patchOffset(table.at(type), typeTable.write(fb));
+            // Lists have one child describing their items.
+            Schema childFields;
+            if (field.listSize) {
+                childFields.push_back(Field("item", field.type));
+            }
+            writeFields(fb, table.at(children), childFields);
+        }
+
+        void writeFields(Flatbuffer &fb, const std::size_t ref,
+                         const Schema &schema) {
+            fb.pad(4);
+            fb.patchOffset(ref, fb.size());
+            fb.put(static_cast<std::uint32_t>(schema.size()));
+            const std::size_t offsets = fb.size();
+            for (std::size_t i = 0; i < schema.size(); i++) {
+                fb.put(static_cast<std::uint32_t>(0));
+            }
+            for (std::size_t i = 0; i < schema.size(); i++) {
+                writeField(fb, offsets + 4 * i, schema[i]);
+            }
+        }
+
+        /* Starts a Message flatbuffer and returns the builder, with the
+         * position of the header offset in 'header'. */
+        Flatbuffer startMessage(const std::uint8_t headerType,
+                                const std::int64_t bodyLength,
+                                std::size_t &header) {
+            Flatbuffer fb;
+            fb.put(static_cast<std::uint32_t>(0));  // root offset
+            Table message;
+            message.scalar(0, METADATA_V5);
+            message.scalar(1, headerType);
+            const unsigned int headerField = message.offset(2);
+            message.scalar(3, bodyLength);
+            fb.patchOffset(0, message.write(fb));
+            header = message.at(headerField);
+            return fb;
+        }
+
+        /* Frames a finished Message flatbuffer: continuation marker, length,
+         * and padding so that the body starts on an aligned boundary. */
+        std::string frame(Flatbuffer &fb) {
+            fb.pad(ALIGNMENT);
+            Flatbuffer prefix;
+            prefix.put(CONTINUATION);
+            prefix.put(static_cast<std::uint32_t>(fb.size()));
+            return prefix.bytes + fb.bytes;
+        }
+
+        inline bool isLittleEndian() {
+            const std::uint16_t one = 1;
+            char first;
+            std::memcpy(&first, &one, 1);
+            return first == 1;
+        }
+
+        inline std::size_t elementSize(const Type type) {
+            return type == Type::FLOAT32 ? sizeof(float)
+                                         : sizeof(std::uint16_t);
+        }
+
+        // A column's type, for error messages
+        std::string describe(const Type type, const bool isList,
+                             const std::int32_t listSize) {
+            const std::string name =
+                type == Type::FLOAT32 ? "float32" : "uint16";
+            return isList
+                ? std::to_string(listSize) + "-element " + name + " list"
+                : name;
+        }
+
+    }
+
+
+    // Schema and end-of-stream messages //
+
+    std::string schemaMessage(const Schema &schema) {
+        std::size_t header;
+        Flatbuffer fb = startMessage(HEADER_SCHEMA, 0, header);
+        Table table;
+        table.scalar(0, isLittleEndian() ? ENDIANNESS_LITTLE : ENDIANNESS_BIG);
+        const unsigned int fields = table.offset(1);
+        fb.patchOffset(header, table.write(fb));
+        writeFields(fb, table.at(fields), schema);
+        return frame(fb);
+    }
+
+    const std::string END_OF_STREAM("\xFF\xFF\xFF\xFF\0\0\0\0", 8);
+
+
+    // class BatchBuilder
+
+    BatchBuilder::BatchBuilder(const Schema &schema)
+        : schema(schema), columns(schema.size()), column(0), nRows(0),
+          nBytes(0) {
+    }
+
+    void BatchBuilder::put(const float *const values, const std::size_t n) {
+        putList(Type::FLOAT32, values, n);
+    }
+
+    void BatchBuilder::put(const std::uint16_t *const values,
+                           const std::size_t n) {
+        putList(Type::UINT16, values, n);
+    }
+
+    template<typename T>
+    void BatchBuilder::putList(const Type type, const T *const values,
+                               const std::size_t n) {
+        nextColumn(type, true, n);
+        std::vector<char> &data = columns[column - 1];
+        data.insert(data.end(), reinterpret_cast<const char *>(values),
+                    reinterpret_cast<const char *>(values + n));
+        nBytes += n * sizeof(T);
+    }
+
+    void BatchBuilder::nextColumn(const Type type, const bool isList,
+                                  const std::int32_t listSize) {
+        if (column >= schema.size()) {
+            mismatch("too many columns in row");
+        }
+        const Field &field = schema[column];
+        const bool fieldIsList = field.listSize != 0;
+        if (field.type != type || fieldIsList != isList
+            || field.listSize != listSize) {
+            mismatch("column `" + field.name + "' expected "
+                     + describe(field.type, fieldIsList, field.listSize)
+                     + ", got " + describe(type, isList, listSize));
+        }
+        column++;
+    }
+
+    void BatchBuilder::endRow() {
+        if (column != schema.size()) {
+            mismatch("too few columns in row");
+        }
+        column = 0;
+        nRows++;
+    }
+
+    void BatchBuilder::abandonRow() {
+        // Every row before this one supplied each column in full.
+        nBytes = 0;
+        for (std::size_t i = 0; i < schema.size(); i++) {
+            const std::size_t rowBytes = elementSize(schema[i].type)
+                * std::max<std::int32_t>(schema[i].listSize, 1);
+            columns[i].resize(nRows * rowBytes);
+            nBytes += columns[i].size();
+        }
+        column = 0;
+    }
+
+    void BatchBuilder::mismatch(const std::string &whatArg) {
+        abandonRow();
+        throw SchemaMismatchError(whatArg);
+    }
+
+    void BatchBuilder::flush(std::ostream &out) {
+        if (nRows == 0) {
+            return;
+        }
+        /* Lay out the body.  No column has nulls, so every validity bitmap
+         * is omitted (given zero length). */
+        std::vector<std::int64_t> nodes;
+        std::vector<std::int64_t> buffers;
+        std::int64_t bodyLength = 0;
+        for (std::size_t i = 0; i < schema.size(); i++) {
+            const std::int64_t length = columns[i].size();
+            nodes.push_back(nRows);
+            nodes.push_back(0);
+            buffers.push_back(bodyLength);  // validity
+            buffers.push_back(0);
+            if (schema[i].listSize) {
+                nodes.push_back(length / elementSize(schema[i].type));
+                nodes.push_back(0);
+                buffers.push_back(bodyLength);  // child validity
+                buffers.push_back(0);
+            }
+            buffers.push_back(bodyLength);
+            buffers.push_back(length);
+            bodyLength += (length + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        }
+        // Write the metadata.
+        std::size_t header;
+        Flatbuffer fb = startMessage(HEADER_RECORD_BATCH, bodyLength, header);
+        Table table;
+        table.scalar(0, static_cast<std::int64_t>(nRows));
+        const unsigned int nodesField = table.offset(1);
+        const unsigned int buffersField = table.offset(2);
+        fb.patchOffset(header, table.write(fb));
+        writePairs(fb, table.at(nodesField), nodes);
+        writePairs(fb, table.at(buffersField), buffers);
+        out << frame(fb);
+        // Write the body.
+        static const char zeros[ALIGNMENT] = {0};
+        for (std::vector<char> &data : columns) {
+            out.write(data.data(), data.size());
+            out.write(zeros, (ALIGNMENT - data.size() % ALIGNMENT) % ALIGNMENT);
+            data.clear();
+        }
+        nRows = 0;
+        nBytes = 0;
+    }
+
+
+    // class StreamWriter
+
+    namespace {
+
+        /* Rows are grouped into record batches of about this many bytes, so
+         * the per-batch metadata stays small next to the data. */
+        const std::size_t BATCH_BYTES = 1024 * 1024;
+
+    }
+
+    StreamWriter::StreamWriter(std::ostream &out, const Schema &schema,
+                               const bool resuming)
+        : out(out), batch(schema) {
+        if (! resuming) {
+            out << schemaMessage(schema);
+        }
+    }
+
+    void StreamWriter::write(const Datum &datum) {
+        try {
+            datum.appendTo(batch);
+            batch.endRow();
+        } catch (const std::exception &) {
+            batch.abandonRow();
+            throw;
+        }
+        if (batch.bytes() >= BATCH_BYTES) {
+            batch.flush(out);
+        }
+    }
+
+    void StreamWriter::finish() {
+        batch.flush(out);
+        out << END_OF_STREAM;
+    }
+
+
+    // Error handling //
+
+    SchemaMismatchError::SchemaMismatchError(const std::string &whatArg)
+        : std::logic_error("Arrow schema mismatch: " + whatArg) {
+    }
+
+}
@@ -0,0 +1,148 @@
+/* arrowIpc.h -- writing Apache Arrow IPC streams
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifndef PPAML_VREP_AUTOMOBILE_PLUGIN_ARROWIPC_H
+#define PPAML_VREP_AUTOMOBILE_PLUGIN_ARROWIPC_H
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cstddef>
+#include <cstdint>
+
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/* A small, self-contained writer for the Apache Arrow IPC streaming format
+ * <https://arrow.apache.org/docs/format/Columnar.html>.  It supports exactly
+ * what the plugin needs: non-nullable float32 and uint16 columns, and
+ * fixed-size lists of either.  The flatbuffer metadata is encoded by hand, so
+ * there is no dependency on the Arrow or flatbuffers libraries. */
+namespace arrowIpc {
+
+    enum class Type {
+        FLOAT32,
+        UINT16
+    };
+
+    // A column.  A nonzero 'listSize' makes it a fixed-size list of 'type'.
+    struct Field {
+        inline Field(const std::string &name, Type type,
+                     std::int32_t listSize = 0);
+        std::string name;
+        Type type;
+        std::int32_t listSize;
+    };
+
+    typedef std::vector<Field> Schema;
+
+    class BatchBuilder;
+
+    // Interface: Any datum which can be written as a row of an Arrow table.
+    struct Datum {
+        virtual Schema arrowSchema() const = 0;
+        virtual void appendTo(BatchBuilder &) const = 0;
+    };
+
+    /* Accumulates rows of a record batch, column by column.  Each row must
+     * supply every column, in schema order, and then call 'endRow'.  A row
+     * which doesn't fit the schema is dropped when the mismatch is found,
+     * leaving the rows before it and the builder ready for the next. */
+    class BatchBuilder {
+    public:
+        explicit BatchBuilder(const Schema &);
+
+        inline void put(float);
+        inline void put(std::uint16_t);
+        // Supplies a whole fixed-size list column.
+        void put(const float *values, std::size_t n);
+        void put(const std::uint16_t *values, std::size_t n);
+        void endRow();
+        // Drops the columns the current row has supplied so far.
+        void abandonRow();
+
+        inline std::size_t rows() const;
+        // Approximate size of the batch body, in bytes
+        inline std::size_t bytes() const;
+
+        // Writes the accumulated rows as one record batch and clears them.
+        void flush(std::ostream &);
+
+    private:
+        template<typename T>
+        inline void putScalar(Type, T);
+        template<typename T>
+        void putList(Type, const T *values, std::size_t n);
+        // Checks the next column is a list of listSize, or else a scalar.
+        void nextColumn(Type, bool isList, std::int32_t listSize);
+        // Drops the current row and throws a 'SchemaMismatchError'.
+        void mismatch(const std::string &whatArg);
+
+        const Schema schema;
+        std::vector<std::vector<char>> columns;
+        std::size_t column;
+        std::size_t nRows;
+        std::size_t nBytes;
+    };
+
+    /* Writes a stream: the schema message, a record batch each time enough
+     * rows accumulate, and the end-of-stream marker. */
+    class StreamWriter {
+    public:
+        /* Writes the schema message to the passed stream, unless
+         * 'resuming'--in which case the stream must already hold a schema
+         * message for the same schema and no end-of-stream marker. */
+        StreamWriter(std::ostream &, const Schema &, bool resuming = false);
+
+        /* Adds a datum's row.  If the datum doesn't fit the schema, throws
+         * and writes nothing of it. */
+        void write(const Datum &);
+
+        // Writes any buffered rows and the end-of-stream marker.
+        void finish();
+
+    private:
+        std::ostream &out;
+        BatchBuilder batch;
+    };
+
+    // The bytes of the schema message for the passed schema
+    std::string schemaMessage(const Schema &);
+
+    // The bytes of the end-of-stream marker
+    extern const std::string END_OF_STREAM;
+
+
+    // Error handling //
+
+    // An error signaling a datum that does not fit the stream's schema.
+    class SchemaMismatchError : public std::logic_error {
+    public:
+        explicit SchemaMismatchError(const std::string &whatArg);
+    };
+
+}
+
+#include "arrowIpc-inl.h"
+
+#endif
@@ -0,0 +1,176 @@
+/* arrowIpcTest.cpp -- unit tests for the Arrow stream writer
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cstddef>
+#include <cstdint>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "arrowIpc.h"
+#include "span.h"
+#include "unitTest.h"
+
+namespace {
+
+    // How a test row goes wrong, if it does
+    enum class Fault {
+        NONE,
+        UINT16_TIME,            // supplies the time as a uint16
+        MISSING_VALUES          // leaves out the list column
+    };
+
+    /* A row of a time and a list of values, as many as it is given, which
+     * the schema says are four */
+    class TestRow : public arrowIpc::Datum {
+    public:
+        TestRow(float time, std::size_t nValues, Fault = Fault::NONE);
+        virtual arrowIpc::Schema arrowSchema() const;
+        virtual void appendTo(arrowIpc::BatchBuilder &) const;
+
+    private:
+        float time;
+        std::vector<float> values;
+        Fault fault;
+    };
+
+    const std::size_t LIST_SIZE = 4;
+
+    /* Writes the rows to a stream, skipping those which throw, and returns
+     * the stream's bytes along with the messages of the errors. */
+    std::string writeStream(const std::vector<TestRow> &,
+                            std::vector<std::string> &errors);
+
+    /* Fails unless a stream of the passed rows, with a bad one among them,
+     * comes out the same as one of just the good rows, and the error says
+     * what was wrong. */
+    void expectBadRowDropped(const TestRow &bad, const std::string &error);
+
+
+    // Tests //
+
+    void dropsWrongListSize() {
+        expectBadRowDropped(TestRow(1, 3),
+                            "column `Values' expected 4-element float32 "
+                            "list, got 3-element float32 list");
+        expectBadRowDropped(TestRow(1, 0),
+                            "column `Values' expected 4-element float32 "
+                            "list, got 0-element float32 list");
+    }
+
+    void dropsWrongType() {
+        expectBadRowDropped(TestRow(1, LIST_SIZE, Fault::UINT16_TIME),
+                            "column `Time' expected float32, got uint16");
+    }
+
+    void dropsMissingColumn() {
+        expectBadRowDropped(TestRow(1, LIST_SIZE, Fault::MISSING_VALUES),
+                            "too few columns in row");
+    }
+
+    const unitTest::Test TESTS[] = {
+        {"arrowIpc/mismatch/listSize", dropsWrongListSize},
+        {"arrowIpc/mismatch/type", dropsWrongType},
+        {"arrowIpc/mismatch/columns", dropsMissingColumn},
+    };
+
+}
+
+namespace unitTest {
+
+    const Span<const Test> arrowIpcTests(TESTS,
+                                         sizeof TESTS / sizeof TESTS[0]);
+
+}
+
+
+namespace {
+
+    // class TestRow
+
+    TestRow::TestRow(const float time, const std::size_t nValues,
+                     const Fault fault)
+        : time(time), values(nValues, time * 2), fault(fault) {
+    }
+
+    arrowIpc::Schema TestRow::arrowSchema() const {
+        arrowIpc::Schema result;
+        result.push_back(arrowIpc::Field("Time", arrowIpc::Type::FLOAT32));
+        result.push_back(arrowIpc::Field("Values", arrowIpc::Type::FLOAT32,
+                                         LIST_SIZE));
+        return result;
+    }
+
+    void TestRow::appendTo(arrowIpc::BatchBuilder &batch) const {
+        if (fault == Fault::UINT16_TIME) {
+            batch.put(static_cast<std::uint16_t>(time));
+        } else {
+            batch.put(time);
+        }
+        if (fault != Fault::MISSING_VALUES) {
+            batch.put(values.data(), values.size());
+        }
+    }
+
+
+    // Checks //
+
+    std::string writeStream(const std::vector<TestRow> &rows,
+                            std::vector<std::string> &errors) {
+        std::ostringstream out;
+        arrowIpc::StreamWriter writer(out, rows.front().arrowSchema());
+        for (const TestRow &row : rows) {
+            try {
+                writer.write(row);
+            } catch (const arrowIpc::SchemaMismatchError &error) {
+                errors.push_back(error.what());
+            }
+        }
+        writer.finish();
+        return out.str();
+    }
+
+    void expectBadRowDropped(const TestRow &bad, const std::string &error) {
+        // A bad row in the middle of the first batch, as a stray scan is
+        std::vector<TestRow> good;
+        for (unsigned int i = 0; i < 4; i++) {
+            good.push_back(TestRow(static_cast<float>(i), LIST_SIZE));
+        }
+        std::vector<TestRow> withBad(good.begin(), good.begin() + 1);
+        withBad.push_back(bad);
+        withBad.insert(withBad.end(), good.begin() + 1, good.end());
+        std::vector<std::string> errors;
+        const std::string expected = writeStream(good, errors);
+        unitTest::expect(errors.empty(), "a good row was rejected");
+        const std::string actual = writeStream(withBad, errors);
+        unitTest::expect(errors.size() == 1,
+                         std::to_string(errors.size()) + " rows rejected");
+        unitTest::expect(errors[0] == "Arrow schema mismatch: " + error,
+                         "wrong error: " + errors[0]);
+        unitTest::expect(actual == expected,
+                         "the bad row left a trace in the stream");
+    }
+
+}
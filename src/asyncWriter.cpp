@@ -0,0 +1,157 @@
+/* asyncWriter.cpp -- doing output work on a background thread
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <utility>
+
+#include "asyncWriter.h"
+
+namespace output {
+
+    namespace {
+
+        /* Waits a little longer each time it is called, so that a thread
+         * polling for work (or for room) doesn't burn a whole core while still
+         * responding quickly once things start moving again. */
+        class Backoff {
+        public:
+            inline Backoff()
+                : spins(0) {
+            }
+
+            inline void pause() {
+                if (spins < 64) {
+                    std::this_thread::yield();
+                } else {
+                    std::this_thread::sleep_for(
+                        std::chrono::microseconds(spins < 128 ? 50 : 500));
+                }
+                if (spins < 128) {
+                    spins++;
+                }
+            }
+
+        private:
+            unsigned int spins;
+        };
+
+    }
+
+
+    // class Job
+
+    Job::~Job() {
+    }
+
+
+    // class AsyncWriter
+
+    AsyncWriter::AsyncWriter(const std::size_t queueDepth,
+                             const QueuePolicy policy)
+        : queue(queueDepth), policy(policy), submitted(0), completed(0),
+          nDropped(0), stopping(false), failed(false), error(), thread() {
+        thread = std::thread(&AsyncWriter::loop, this);
+    }
+
+    AsyncWriter::~AsyncWriter() noexcept {
+        try {
+            finish();
+        } catch (const std::exception &error) {
+            // Nowhere to report it.
+        }
+    }
+
+    bool AsyncWriter::submit(std::unique_ptr<Job> job) {
+        rethrowError();
+        Backoff backoff;
+        while (! queue.tryPush(job)) {
+            if (policy == QueuePolicy::DROP) {
+                nDropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            rethrowError();
+            backoff.pause();
+        }
+        submitted++;
+        return true;
+    }
+
+    void AsyncWriter::wait() {
+        Backoff backoff;
+        while (completed.load(std::memory_order_acquire) != submitted
+               && ! failed.load(std::memory_order_acquire)) {
+            backoff.pause();
+        }
+        rethrowError();
+    }
+
+    void AsyncWriter::finish() {
+        if (thread.joinable()) {
+            stopping.store(true, std::memory_order_release);
+            thread.join();
+        }
+        rethrowError();
+    }
+
+    void AsyncWriter::loop() {
+        std::unique_ptr<Job> job;
+        Backoff backoff;
+        while (true) {
+            /* The producer stops pushing before it sets 'stopping', so once we
+             * see the flag, one more pass empties the queue for good. */
+            const bool lastPass = stopping.load(std::memory_order_acquire);
+            bool idle = true;
+            while (queue.tryPop(job)) {
+                idle = false;
+                if (! failed.load(std::memory_order_relaxed)) {
+                    try {
+                        job->run();
+                    } catch (...) {
+                        error = std::current_exception();
+                        failed.store(true, std::memory_order_release);
+                    }
+                }
+                job.reset();
+                completed.fetch_add(1, std::memory_order_release);
+            }
+            if (lastPass) {
+                return;
+            } else if (idle) {
+                backoff.pause();
+            } else {
+                backoff = Backoff();
+            }
+        }
+    }
+
+    void AsyncWriter::rethrowError() {
+        if (failed.load(std::memory_order_acquire)) {
+            std::rethrow_exception(error);
+        }
+    }
+
+}
@@ -0,0 +1,101 @@
+/* asyncWriter.h -- doing output work on a background thread
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifndef PPAML_VREP_AUTOMOBILE_PLUGIN_ASYNCWRITER_H
+#define PPAML_VREP_AUTOMOBILE_PLUGIN_ASYNCWRITER_H
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cstddef>
+
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <thread>
+
+#include "ring.h"
+
+namespace output {
+
+    // A unit of output work--typically, formatting and writing one datum.
+    class Job {
+    public:
+        virtual ~Job();
+        virtual void run() = 0;
+    };
+
+    // What to do when a job is submitted to a full queue
+    enum class QueuePolicy {
+        BLOCK,                  // wait for the writer thread to make room
+        DROP                    // discard the job and count it
+    };
+
+    /* A thread which runs jobs in the order they were submitted.  Jobs travel
+     * through a bounded lock-free ring, so submitting a job costs the same
+     * amount no matter how slow the disk is (unless the ring fills and the
+     * policy is BLOCK).  Only one thread may submit jobs.
+     *
+     * If a job throws, the writer stops running jobs and the exception is
+     * rethrown from the next call to 'submit', 'wait', or 'finish'. */
+    class AsyncWriter {
+    public:
+        AsyncWriter(std::size_t queueDepth, QueuePolicy);
+        // Finishes outstanding jobs, discarding any exception they throw.
+        ~AsyncWriter() noexcept;
+        AsyncWriter(const AsyncWriter &) = delete;
+        AsyncWriter &operator=(const AsyncWriter &) = delete;
+
+        /* Queues a job.  Returns false if the queue was full and the job was
+         * dropped. */
+        bool submit(std::unique_ptr<Job>);
+
+        // Blocks until every job submitted so far has run.
+        void wait();
+
+        /* Runs every outstanding job and stops the thread.  No jobs may be
+         * submitted afterward. */
+        void finish();
+
+        // The number of jobs dropped because the queue was full
+        inline unsigned long long dropped() const;
+
+    private:
+        void loop();
+        void rethrowError();
+
+        SpscRing<std::unique_ptr<Job>> queue;
+        const QueuePolicy policy;
+        unsigned long long submitted;
+        std::atomic<unsigned long long> completed;
+        std::atomic<unsigned long long> nDropped;
+        std::atomic<bool> stopping;
+        std::atomic<bool> failed;
+        // Written by the writer thread before it sets 'failed'
+        std::exception_ptr error;
+        std::thread thread;
+    };
+
+}
+
+#include "asyncWriter-inl.h"
+
+#endif
@@ -18,10 +18,16 @@
  * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
  * Oregon, 97204-1622. */
 
-/* This module assumes only one car is recording data at once.  Thus, it follows
- * a singleton object pattern.  To keep everything a bit simpler, the state
- * variables live in an anonymous namespace, and the functions simply mutate
- * them as appropriate. */
+/* Any number of cars may record data at once.  Each is a Vehicle, which owns
+ * its output directory, files, threads, and noise sources; the Lua callbacks
+ * look up the vehicle a call is for and hand it to the functions below, which
+ * touch nothing else.  The vehicles live in an anonymous namespace, and are
+ * known to Lua only by their handles.
+ *
+ * Threaded child scripts may call in from several threads at once.  One
+ * thread at a time records for a vehicle; the others leave their data in the
+ * vehicle's intake (see intake.h), without waiting, for that thread to merge
+ * by time and record before it lets go.  See 'submit'. */
 
 #ifdef HAVE_CONFIG_H
 #   include <config.h>
@@ -29,53 +35,77 @@
 
 #include <cassert>
 #include <cstdarg>
+#include <cstdint>
 
+#include <algorithm>
 #include <array>
-#include <fstream>
+#include <atomic>
+#include <exception>
 #include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include <boost/filesystem.hpp>
 #include <boost/optional.hpp>
 #include <v_repLib.h>
 
+#include "arena.h"
+#include "arrowIpc.h"
+#include "asyncWriter.h"
 #include "automobile.h"
+#include "csv.h"
+#include "intake.h"
+#include "latency.h"
+#include "lidar.h"
+#include "measurement.h"
 #include "noise.h"
+#include "options.h"
+#include "output.h"
+#include "reorder.h"
+#include "span.h"
 #include "vrepFfi.h"
 
-#ifndef HAVE_CXX11_INITIALIZER_LISTS
-#   include <cassert>
-#   include <list>
-#endif
-
 
 namespace {
 
     // Paths to the output files
     namespace path {
 
-        std::string dataDir = "/tmp";
+        // Where cars record if no simExtAutomobileInit has said otherwise
+        const std::string defaultDataDir = "/tmp";
 
         const std::string groundDir = "/ground";
         const std::string noisyDir = "/noisy";
 
         const std::string properties = "/properties.csv";
-        const std::string sensor = "/slam_sensor.csv";
-        const std::string pose = "/slam_gps.csv";
-        const std::string control = "/slam_control.csv";
-        const std::string laser = "/slam_laser.csv";
+        const std::string stats = "/stats.csv";
+        // Goes in the noisy data set
+        const std::string noiseSeed = "/seed.csv";
+        // Goes in each data set whose table of contents is put in order
+        const std::string lateSamples = "/late_samples.csv";
+        // Goes in the output directory if the writer thread may drop saves
+        const std::string droppedSaves = "/dropped_saves.csv";
+
+        // The data files get an extension appropriate to the output format.
+        const std::string sensor = "/slam_sensor";
+        const std::string pose = "/slam_gps";
+        const std::string control = "/slam_control";
+        const std::string laser = "/slam_laser";
 
     }
 
     // Run specifications
-    struct Properties : public csv::Datum {
-        inline Properties(float L, float h, float a, float b, float theta0)
-            : L(L), h(h), a(a), b(b), theta0(theta0) {
+    struct Properties {
+        inline Properties(float L, float h, float a, float b, float theta0,
+                          float distanceScale, float intensityScale)
+            : L(L), h(h), a(a), b(b), theta0(theta0),
+              distanceScale(distanceScale), intensityScale(intensityScale) {
         }
-        inline virtual std::string csvHeader() const;
-        virtual std::string csv() const;
-        inline virtual unsigned int nCols() const;
         // Distance between front and rear axles
         float L;
         // Distance between center of rear axle and encoder on left rear wheel
@@ -86,45 +116,337 @@ namespace {
         float b;
         // Initial angle of the car
         float theta0;
+        /* What one step of the stored lidar distances and intensities stands
+         * for, or 0 if they are stored as floats */
+        float distanceScale;
+        float intensityScale;
+    };
+
+    // The seed the noise sources were keyed with
+    struct NoiseSeed {
+        inline explicit NoiseSeed(std::uint32_t seed)
+            : seed(seed) {
+        }
+        std::uint32_t seed;
+    };
+
+    // How many samples went in the table of contents out of time order
+    struct LateSamples {
+        inline LateSamples(float lateness, unsigned long long count)
+            : lateness(lateness), count(count) {
+        }
+        float lateness;
+        unsigned long long count;
+    };
+
+    // How many saves the writer thread threw away because its queue was full
+    struct DroppedSaves {
+        inline DroppedSaves(std::size_t queueDepth, unsigned long long count)
+            : queueDepth(queueDepth), count(count) {
+        }
+        std::size_t queueDepth;
+        unsigned long long count;
+    };
+
+    // How long one callback or output stage has taken, in microseconds
+    struct StageStats {
+        inline StageStats(const std::string &stage, unsigned long long count,
+                          float p50, float p99, float max)
+            : stage(stage), count(count), p50(p50), p99(p99), max(max) {
+        }
+        std::string stage;
+        unsigned long long count;
+        float p50;
+        float p99;
+        float max;
     };
 
     // Individual sample records
-    struct Sample : public csv::Datum {
+    struct Sample : public Record {
         inline explicit Sample(const Pose &);
         inline explicit Sample(const ControlSignals &);
         inline explicit Sample(const LidarDatum &);
-        inline virtual std::string csvHeader() const;
-        inline virtual std::string csv() const;
-        inline virtual unsigned int nCols() const;
+        inline virtual float timestamp() const;
+        virtual arrowIpc::Schema arrowSchema() const;
+        inline virtual void appendTo(arrowIpc::BatchBuilder &) const;
         float time;
         unsigned short sensorId;
     };
 
+    // Everything recorded in one simulation step
+    struct Tick {
+        inline Tick(Pose &&, ControlSignals &&, LidarDatum &&);
+        inline float timestamp() const;
+        Pose pose;
+        ControlSignals controls;
+        LidarDatum laser;
+    };
+
+}
+
+
+// CSV schemas //
+namespace csv {
+
+    /* The lidar scales are only written when the lidar values are stored as
+     * integers, so the other runs' properties keep their columns. */
+    template<>
+    struct Schema<Properties> {
+        static const char *const COLUMNS[7];
+        static inline unsigned int nCols(const Properties &);
+        static inline std::string header(const Properties &);
+        static inline void write(Row &, const Properties &);
+    };
+
+    template<>
+    struct Schema<NoiseSeed> : public FixedSchema<NoiseSeed, 1> {
+        static const char *const COLUMNS[N_COLS];
+        static inline void write(Row &, const NoiseSeed &);
+    };
+
+    template<>
+    struct Schema<LateSamples> : public FixedSchema<LateSamples, 2> {
+        static const char *const COLUMNS[N_COLS];
+        static inline void write(Row &, const LateSamples &);
+    };
+
+    template<>
+    struct Schema<DroppedSaves> : public FixedSchema<DroppedSaves, 2> {
+        static const char *const COLUMNS[N_COLS];
+        static inline void write(Row &, const DroppedSaves &);
+    };
+
+    template<>
+    struct Schema<StageStats> : public FixedSchema<StageStats, 5> {
+        static const char *const COLUMNS[N_COLS];
+        static inline void write(Row &, const StageStats &);
+    };
+
+    template<>
+    struct Schema<Sample> : public FixedSchema<Sample, 2> {
+        static const char *const COLUMNS[N_COLS];
+        static inline void write(Row &, const Sample &);
+    };
+
+}
+
+
+namespace {
+
+    // Output //
+
+    /* The number of sensors, whose sample streams are merged into the table
+     * of contents */
+    const std::size_t N_SENSORS = 3;
+
+    /* The most samples a data set holds back to put the table of contents in
+     * order.  Past this, the oldest go out even if they are not due. */
+    const std::size_t REORDER_CAPACITY = 65536;
+
+    /* The most saves each thread may leave waiting for the thread recording
+     * for a vehicle.  Past this, the thread waits its turn and records them
+     * itself. */
+    const std::size_t INTAKE_CAPACITY = 1024;
+
+    /* One data set: its files, kept open from one write to the next, and the
+     * samples waiting to go in its table of contents if the run puts it in
+     * order */
+    struct DataSet {
+        explicit DataSet(const std::string &dir);
+        DataSet(const DataSet &) = delete;
+        DataSet &operator=(const DataSet &) = delete;
+
+        // The directory, including the vehicle's output directory
+        const std::string dir;
+        output::Registry files;
+        std::unique_ptr<ReorderBuffer<Sample>> samples;
+        // Samples released from the buffer, reused from one write to the next
+        std::vector<Sample> released;
+        /* With laserStorage=uint16, the scan being written, reused from one
+         * write to the next */
+        QuantizedLidarDatum quantized;
+        /* The open files, so a write need not look its file up by path.
+         * Each is null until its file opens, and again once the files
+         * close. */
+        output::Registry::Entry *pose;
+        output::Registry::Entry *control;
+        output::Registry::Entry *laser;
+        output::Registry::Entry *sensor;
+    };
+
 
     // Lidar specifications //
     namespace laser {
 
-        float MAX_DISTANCE = 10.;
-        float MAX_INTENSITY = 32768.;
+        // For cars recording before any simExtAutomobileInit
+        const float DEFAULT_MAX_DISTANCE = 10.;
+        const float DEFAULT_MAX_INTENSITY = 32768.;
 
     }
 
 
     // Noise //
-    namespace noise {
 
-        bool requested = false;
+    /* One noisy data set.  Each realization has its own noise sources and
+     * output files, and is only ever touched by one thread at a time. */
+    struct Realization : public DataSet {
+        /* The sources draw from streams (index << 32) + i of the seed, where
+         * i is the source's position in 'params'. */
+        Realization(const std::string &dir, const Options &,
+                    const std::array<std::vector<float>, 6> &params,
+                    std::uint32_t seed, std::uint32_t index);
+        Realization(const Realization &) = delete;
+        Realization &operator=(const Realization &) = delete;
+
+        // Noise sources for the various measurements
+        GaussianNoiseSource position;
+        GaussianNoiseSource angle;
+        GaussianNoiseSource speed;
+        GaussianNoiseSource steeringAngle;
+        GaussianNoiseSource intensity;
+        GaussianNoiseSource distance;
+    };
+
+
+    // Recording in memory //
+    namespace memory {
+
+        // A datum kept in memory, flattened so it can live in an arena
+        struct Entry {
+            enum class Kind : unsigned char {
+                POSE,
+                CONTROLS,
+                LASER
+            };
+            Kind kind;
+            float time;
+            // The x, y, and theta of a pose, or the speed and steering angle
+            float values[3];
+            // A lidar datum's distances, followed by its intensities
+            const float *beams;
+            std::size_t nDistance;
+            std::size_t nIntensity;
+        };
+
+        // The data one vehicle keeps in memory
+        struct Store {
+            explicit Store(bool active);
+            Store(const Store &) = delete;
+            Store &operator=(const Store &) = delete;
+
+            /* Whether data are being kept in memory rather than written as
+             * they come.  This is cleared if they outgrow the memory
+             * limit. */
+            bool active;
+
+            // The data kept so far, in order, and the lidar beams they point to
+            Arena<Entry> entries;
+            Arena<float> beams;
+        };
 
-        // Dummy noise source that provides no noise
-        GaussianNoiseSource<float> none(0., 0.);
+    }
+
+
+    // Timing //
+    namespace stats {
+
+        // The callbacks and output stages which are timed
+        enum Stage {
+            INIT,
+            SET_NOISE_PARAMETERS,
+            SAVE_POSE,
+            SAVE_CONTROLS,
+            SAVE_LASER,
+            SAVE_POSE_BATCH,
+            SAVE_CONTROLS_BATCH,
+            SAVE_TICK,
+            ADD_NOISE,          // adding noise to a datum for one data set
+            WRITE,              // writing a datum to one data set's files
+            FINISH,             // writing out and closing every file
+            N_STAGES
+        };
 
-        // Noise sources for the various measurements (can be set via Lua)
-        boost::optional<GaussianNoiseSource<float>> position;
-        boost::optional<GaussianNoiseSource<float>> angle;
-        boost::optional<GaussianNoiseSource<float>> speed;
-        boost::optional<GaussianNoiseSource<float>> steeringAngle;
-        boost::optional<GaussianNoiseSource<float>> distance;
-        boost::optional<GaussianNoiseSource<float>> intensity;
+        // The name of each stage, as reported
+        const std::array<const char *, N_STAGES> NAMES =
+            {{"init", "setNoiseParameters", "savePose", "saveControls",
+              "saveLaser", "savePoseBatch", "saveControlsBatch", "saveTick",
+              "addNoise", "write", "finish"}};
+
+    }
+
+
+    // Vehicles //
+
+    /* Everything one car records: its output directory, options, and lidar
+     * specifications, the data sets it writes, the threads writing them, and
+     * how long it all takes.  Vehicles share nothing, so each costs the same
+     * however many there are. */
+    struct Vehicle {
+        Vehicle(const std::string &dataDir, const Options &,
+                float maxDistance, float maxIntensity);
+        Vehicle(const Vehicle &) = delete;
+        Vehicle &operator=(const Vehicle &) = delete;
+
+        // The base directory for the output data
+        const std::string dataDir;
+        // The options the run was started with
+        const Options options;
+
+        // Lidar specifications
+        const float maxDistance;
+        const float maxIntensity;
+        // How lidar values are stored with laserStorage=uint16
+        const lidar::Quantizer distanceQuantizer;
+        const lidar::Quantizer intensityQuantizer;
+
+        // The ground truth
+        DataSet ground;
+
+        // The thread doing the output work, if the run asked for one
+        std::unique_ptr<output::AsyncWriter> writerThread;
+        // The saves dropped by writer threads stopped so far
+        unsigned long long droppedSaves;
+
+        // The noisy data sets requested with simExtAutomobileRequestNoise
+        std::vector<std::unique_ptr<Realization>> realizations;
+
+        /* Threads which add noise and write the noisy data sets, if there is
+         * more than one.  Realization r belongs to worker r % workers.size().
+         * If there are no workers, the noisy data sets are written along with
+         * the ground truth. */
+        std::vector<std::unique_ptr<output::AsyncWriter>> noiseWorkers;
+
+        memory::Store memory;
+
+        // How long each stage has taken since simExtAutomobileInit
+        std::array<latency::Histogram, stats::N_STAGES> stats;
+
+        /* Held by the thread recording for the vehicle.  The data sets,
+         * threads, and memory above are only touched while holding it (or by
+         * the output threads); the stats take care of themselves. */
+        std::mutex recording;
+
+        /* Saves made while another thread was recording, each a job which
+         * records its data, and those taken out but not yet run */
+        Intake<std::unique_ptr<output::Job>> intake;
+        std::vector<std::unique_ptr<output::Job>> merged;
+    };
+
+    namespace vehicles {
+
+        /* The vehicles initialized so far; vehicle i has handle i + 1.
+         * Handles are never reused, and vehicles are only ever replaced (by
+         * initializing their directory again), so a handle stays valid for
+         * the life of the plugin.  A callback holds on to its vehicle, so one
+         * replaced meanwhile lives until the callback returns. */
+        std::vector<std::shared_ptr<Vehicle>> all;
+
+        // The handle of the vehicle calls without a handle record for
+        int current = 0;
+
+        /* Guards the two above, just long enough to look up or add a
+         * vehicle--never while recording. */
+        std::mutex lock;
 
     }
 
@@ -138,14 +460,285 @@ namespace {
     LuaFunc savePose;
     LuaFunc saveControls;
     LuaFunc saveLaser;
+    LuaFunc savePoseBatch;
+    LuaFunc saveControlsBatch;
+    LuaFunc saveTick;
+    LuaFunc getStats;
+
+    /* The vehicle with the handle passed as the callback's argument 'index'
+     * (counting from zero), or, if the caller left it out, the vehicle most
+     * recently initialized.  Throws a 'std::invalid_argument' if there is no
+     * such vehicle. */
+    std::shared_ptr<Vehicle> vehicleFor(const vrep::LuaCall &,
+                                        std::size_t index);
+
+    /* Reads the time (unless it is passed), depth buffers, and images of a
+     * lidar measurement and builds the datum. */
+    LidarDatum readLaser(const Vehicle &, vrep::LuaCall &);
+    LidarDatum readLaser(const Vehicle &, float time, vrep::LuaCall &);
+
+    inline void savePropertiesFile(const std::string &dataDir,
+                                   const Properties &, csv::FloatFormat);
+    inline void saveNoiseSeedFile(const std::string &dir, const NoiseSeed &);
+    // Saves the time each stage has taken so far in the output directory.
+    void saveStatsFile(const Vehicle &);
+    /* Saves the number of saves the writer thread has dropped in the output
+     * directory, if the run lets it drop them. */
+    void saveDroppedSavesFile(const Vehicle &);
+
+    /* Records a datum for a vehicle from any thread.  If no other thread is
+     * recording for the vehicle, this is just 'record'; otherwise, the datum
+     * goes in the vehicle's intake for the thread which is.  Either way, this
+     * thread then records whatever other threads left in the intake, if it
+     * can do so without waiting. */
+    template<typename D>
+    void submit(Vehicle &, D);
+    // Like 'submit', but for 'recordAll'
+    template<typename D>
+    void submitAll(Vehicle &, std::vector<D> &&);
+
+    /* Moves a job into a vehicle's intake, and runs the intake's jobs if this
+     * thread holds the lock.  If the intake is full, waits for the lock and
+     * makes room. */
+    void enqueue(Vehicle &, float time, std::unique_ptr<output::Job> &,
+                 std::unique_lock<std::mutex> &);
+
+    /* Runs the jobs in a vehicle's intake, as long as there are any and no
+     * other thread is recording for the vehicle. */
+    void pump(Vehicle &);
+
+    /* Runs the jobs in a vehicle's intake, in time order.  The caller must
+     * hold the vehicle's lock. */
+    void recordIntake(Vehicle &);
+
+    // A job which calls 'record' when its turn comes in the intake
+    template<typename D>
+    class PendingJob : public output::Job {
+    public:
+        inline PendingJob(Vehicle &, D &&);
+        virtual void run();
+
+    private:
+        Vehicle &vehicle;
+        D datum;
+    };
+
+    // A job which calls 'recordAll' when its turn comes in the intake
+    template<typename D>
+    class PendingAllJob : public output::Job {
+    public:
+        inline PendingAllJob(Vehicle &, std::vector<D> &&);
+        virtual void run();
+
+    private:
+        Vehicle &vehicle;
+        std::vector<D> data;
+    };
+
+    /* Records a datum in the vehicle's ground truth data set and, if noise
+     * was requested, in each noisy data set.  The work happens on the writer
+     * thread if there is one and immediately otherwise; the noisy data sets
+     * are handed on to the noise workers if there are any. */
+    template<typename D>
+    void record(Vehicle &, D);
+
+    /* Like 'record', but for a series of data, which are written exactly as
+     * if they had been recorded one at a time.  On the writer thread, the
+     * whole series is one job. */
+    template<typename D>
+    void recordAll(Vehicle &, std::vector<D> &&);
+
+    // Like 'record' and 'recordAll', but always do the work immediately.
+    template<typename D>
+    void recordNow(Vehicle &, const D &);
+    template<typename D>
+    void recordAllNow(Vehicle &, std::vector<D> &&);
+
+    // A job which calls 'recordNow' on the writer thread
+    template<typename D>
+    class RecordJob : public output::Job {
+    public:
+        inline RecordJob(Vehicle &, D &&);
+        virtual void run();
+
+    private:
+        Vehicle &vehicle;
+        const D datum;
+    };
+
+    // A job which calls 'recordAllNow' on the writer thread
+    template<typename D>
+    class RecordAllJob : public output::Job {
+    public:
+        inline RecordAllJob(Vehicle &, std::vector<D> &&);
+        virtual void run();
+
+    private:
+        Vehicle &vehicle;
+        std::vector<D> data;
+    };
+
+    // Adds noise to a datum and writes it to a vehicle's noisy data set.
+    template<typename D>
+    void recordNoisy(Vehicle &, Realization &, const D &);
+    // 'withNoise', timed as the addNoise stage
+    template<typename D>
+    D timedWithNoise(Vehicle &, Realization &, const D &);
+
+    /* Hands a series of data to a vehicle's noise workers.  The pointer keeps
+     * the data alive until every worker is done with them. */
+    template<typename D>
+    void recordNoisyLater(Vehicle &, const std::shared_ptr<const D> &first,
+                          std::size_t count);
+
+    /* A job which calls 'recordNoisy' on a series of data for each
+     * realization owned by one of 'nWorkers' noise workers */
+    template<typename D>
+    class NoiseJob : public output::Job {
+    public:
+        inline NoiseJob(Vehicle &, const std::shared_ptr<const D> &first,
+                        std::size_t count, std::size_t worker,
+                        std::size_t nWorkers);
+        virtual void run();
+
+    private:
+        Vehicle &vehicle;
+        const std::shared_ptr<const D> first;
+        const std::size_t count;
+        const std::size_t worker;
+        const std::size_t nWorkers;
+    };
+
+    /* The file in a data set which holds each kind of datum, opened if it
+     * is not open yet */
+    inline output::Registry::Entry &fileFor(DataSet &, const Pose &);
+    inline output::Registry::Entry &fileFor(DataSet &, const ControlSignals &);
+    inline output::Registry::Entry &fileFor(DataSet &, const LidarDatum &);
+    inline output::Registry::Entry &fileFor(DataSet &,
+                                            const QuantizedLidarDatum &);
+    inline output::Registry::Entry &fileFor(DataSet &, const Sample &);
+
+    /* 'fileFor' for the file at the passed path in a data set, whose entry
+     * is kept in 'entry' */
+    template<typename D>
+    inline output::Registry::Entry &openFile(DataSet &,
+                                             output::Registry::Entry *&entry,
+                                             const std::string &path,
+                                             const D &);
+
+    // Copies of data with a realization's noise added
+    inline Pose withNoise(Realization &, const Pose &);
+    inline ControlSignals withNoise(Realization &, const ControlSignals &);
+    inline LidarDatum withNoise(Realization &, const LidarDatum &);
+    inline Tick withNoise(Realization &, const Tick &);
 
-    inline void savePropertiesFile(const Properties &);
+    /* Keeps a datum in a vehicle's memory, unless that would take the data
+     * kept in memory past the limit.  Returns whether the datum was kept. */
+    bool keepInMemory(Vehicle &, const Pose &);
+    bool keepInMemory(Vehicle &, const ControlSignals &);
+    bool keepInMemory(Vehicle &, const LidarDatum &);
+    bool keepInMemory(Vehicle &, const Tick &);
 
-    template<typename CsvDatum>
-    inline void saveDatum(const std::string &subdir,
-                          const std::string &filename, const CsvDatum &);
+    /* Whether the passed number of entries and lidar beams would fit in a
+     * vehicle's memory along with what is already there */
+    inline bool fitsInMemory(const Vehicle &, std::size_t nEntries,
+                             std::size_t nBeams);
 
-    void outputDatum(const std::string &filePath, const csv::Datum &);
+    inline memory::Entry &newEntry(memory::Store &, memory::Entry::Kind,
+                                   float time);
+
+    /* Writes out the data a vehicle kept in memory, in the order they were
+     * recorded, and frees them. */
+    void flushMemory(Vehicle &);
+    void replay(Vehicle &, const memory::Entry &);
+
+    /* Writes out the data a vehicle kept in memory, and records everything
+     * from now on as it comes. */
+    void spillMemory(Vehicle &);
+
+    /* Writes out all of a vehicle's recorded data and stops its writer
+     * thread and noise workers, if any. */
+    void stopOutputThreads(Vehicle &);
+
+    /* Waits for a vehicle's writer thread and noise workers to run every
+     * queued job. */
+    void waitForOutputThreads(Vehicle &);
+
+    /* Writes out everything a vehicle recorded, flushes and closes its files,
+     * and saves its stats. */
+    void finishVehicle(Vehicle &);
+
+    /* Writes out everything a vehicle recorded so far, but leaves its files
+     * open. */
+    void drainVehicle(Vehicle &);
+
+    // Applies the run's options to a data set with no open files.
+    void configure(DataSet &, const Options &);
+
+    /* Opens the files in a data set whose layout is known before any data
+     * arrive, so the first save doesn't pay for creating them. */
+    void openDataSet(DataSet &);
+
+    /* Writes out the samples a data set is holding back, then flushes and
+     * closes its files. */
+    void closeDataSet(DataSet &, const Options &);
+    /* Writes out the samples a data set is holding back, if it puts its
+     * table of contents in order, and how many came late. */
+    void writeLastSamples(DataSet &, const Options &);
+
+    /* Writes a datum to its file in a data set, and its sample to the data
+     * set's table of contents. */
+    template<typename D>
+    inline void saveDatum(Vehicle &, DataSet &, const D &);
+    /* Writes each measurement in a tick to its file, then all three samples
+     * to the table of contents together. */
+    void saveDatum(Vehicle &, DataSet &, const Tick &);
+
+    // Writes a datum to its file in a data set.
+    template<typename D>
+    inline void writeDatum(const Vehicle &, DataSet &, const D &);
+    /* Writes a scan to the lidar file of a data set, first storing its values
+     * as integers if the run asked for that. */
+    void writeDatum(const Vehicle &, DataSet &, const LidarDatum &);
+
+    /* Writes samples to a data set's table of contents--right away, or, if
+     * the run puts it in order, as they come due. */
+    void saveSamples(DataSet &, Span<const Sample>);
+    // Writes the samples released from a data set's buffer.
+    void writeReleasedSamples(DataSet &);
+
+    // The noise stream for a source in a realization
+    inline std::uint64_t streamFor(std::uint32_t realization,
+                                   std::uint32_t source);
+
+    /* Starts a vehicle's writer thread if the run asked for one, and noise
+     * workers if there are several noisy data sets (or, when recording in
+     * memory, any). */
+    void startOutputThreads(Vehicle &);
+
+    /* Starts a vehicle's writer thread if the run asked for one and is not
+     * recording in memory. */
+    void startWriterThread(Vehicle &);
+
+    // Flushes and closes a vehicle's noisy data sets' files.
+    void closeNoisyFiles(Vehicle &);
+
+    // Removes the noisy data sets in an output directory.
+    void removeNoisyDirs(const std::string &dataDir);
+
+    /* Runs a step, keeping its failure in 'firstError' unless that already
+     * holds one.  Callers run every step, even if some fail, and report the
+     * first failure afterward. */
+    void runStep(const std::function<void()> &step,
+                 std::exception_ptr &firstError);
+    // Runs each of the steps in turn, as 'runStep' does.
+    template<std::size_t N>
+    void runAll(const std::array<std::function<void()>, N> &steps,
+                std::exception_ptr &firstError);
+
+    /* Runs the passed function on every vehicle, even if it fails on some,
+     * and reports the first failure afterward. */
+    void forEveryVehicle(void (&)(Vehicle &));
 
 }
 
@@ -161,9 +754,10 @@ void registerLuaFunctions() {
         float,
         float,
         float,
-        float>(
+        float,
+        std::string>(           // options (optional)
         "simExtAutomobileInit",
-        "simExtAutomobileInit(string directoryName, number L, number h, number a, number b, number theta0, number max_distance, number max_intensity)",
+        "number vehicle = simExtAutomobileInit(string directoryName, number L, number h, number a, number b, number theta0, number max_distance, number max_intensity, string options=\"\")",
         init);
     vrep::exposeFunction<
         std::vector<float>,     // x and y
@@ -171,57 +765,153 @@ void registerLuaFunctions() {
         std::vector<float>,     // speed
         std::vector<float>,     // steering angle
         std::vector<float>,     // intensity
-        std::vector<float>>(    // distance
+        std::vector<float>,     // distance
+        int,                    // seed (optional)
+        int,                    // number of realizations (optional)
+        int>(                   // vehicle (optional)
             "simExtAutomobileRequestNoise",
-            "simExtAutomobileRequestNoise(table2 xy, table2 angle, table2 speed, table2 steeringAngle, table2 intensity, table2 distance)",
+            "simExtAutomobileRequestNoise(table2 xy, table2 angle, table2 speed, table2 steeringAngle, table2 intensity, table2 distance, number seed=nil, number realizations=nil, number vehicle=nil)",
         setNoiseParameters);
-    vrep::exposeFunction<float, float, float, float>(
+    /* Every function from here on takes the handle simExtAutomobileInit
+     * returned as an optional last argument, and records for the vehicle
+     * most recently initialized without it. */
+    vrep::exposeFunction<float, float, float, float, int>(
         "simExtAutomobileSavePose",
-        "simExtAutomobileSavePose(number simulationTime, number x, number y, number theta)",
+        "simExtAutomobileSavePose(number simulationTime, number x, number y, number theta, number vehicle=nil)",
         savePose);
-    vrep::exposeFunction<float, float, float>(
+    vrep::exposeFunction<float, float, float, int>(
         "simExtAutomobileSaveControls",
-        "simExtAutomobileSaveControls(number simulationTime, number speed, number steeringAngle)",
+        "simExtAutomobileSaveControls(number simulationTime, number speed, number steeringAngle, number vehicle=nil)",
         saveControls);
+    /* Batch versions of the above, for scripts which sample odometry faster
+     * than they want to call into the plugin */
+    vrep::exposeFunction<
+        std::vector<float>,     // simulation times
+        std::vector<float>,     // x
+        std::vector<float>,     // y
+        std::vector<float>,     // theta
+        int>(                   // vehicle (optional)
+            "simExtAutomobileSavePoseBatch",
+            "simExtAutomobileSavePoseBatch(table simulationTimes, table xs, table ys, table thetas, number vehicle=nil)",
+            savePoseBatch);
+    vrep::exposeFunction<
+        std::vector<float>,     // simulation times
+        std::vector<float>,     // speeds
+        std::vector<float>,     // steering angles
+        int>(                   // vehicle (optional)
+            "simExtAutomobileSaveControlsBatch",
+            "simExtAutomobileSaveControlsBatch(table simulationTimes, table speeds, table steeringAngles, number vehicle=nil)",
+            saveControlsBatch);
     /* V-REP's depth sensor part has a maximum field of view narrower than 180
      * degrees.  To compensate, we instead use two 90-degree depth sensors and
      * combine the results here. */
     vrep::exposeFunction<
         float,
         std::vector<float>, std::vector<float>,  // depths
-        std::vector<float>, std::vector<float>>( // grayscale images
+        std::vector<float>, std::vector<float>,  // grayscale images
+        int>(                                    // vehicle (optional)
             "simExtAutomobileSaveLaserPair",
-            "simExtAutomobileSaveLaserPair(number simulationTime, table leftDepthBuffer, table rightDepthBuffer, table leftImage, table rightImage)",
+            "simExtAutomobileSaveLaserPair(number simulationTime, table leftDepthBuffer, table rightDepthBuffer, table leftImage, table rightImage, number vehicle=nil)",
             saveLaser);
+    /* Everything above in one call, for scripts which record every sensor
+     * on every simulation step */
+    vrep::exposeFunction<
+        float,                                   // simulation time
+        float, float, float,                     // pose
+        float, float,                            // controls
+        std::vector<float>, std::vector<float>,  // depths
+        std::vector<float>, std::vector<float>,  // grayscale images
+        int>(                                    // vehicle (optional)
+            "simExtAutomobileSaveTick",
+            "simExtAutomobileSaveTick(number simulationTime, number x, number y, number theta, number speed, number steeringAngle, table leftDepthBuffer, table rightDepthBuffer, table leftImage, table rightImage, number vehicle=nil)",
+            saveTick);
+    vrep::exposeFunction<int>(  // vehicle (optional)
+        "simExtAutomobileGetStats",
+        "table stages, table counts, table p50, table p99, table max = simExtAutomobileGetStats(number vehicle=nil)",
+        getStats);
 }
 
 
-// Callbacks //
-namespace {
+// CSV schemas //
+namespace csv {
+
+    const char *const Schema<Properties>::COLUMNS[] =
+        {"L", "h", "a", "b", "InitialAngle", "LaserScale", "IntensityScale"};
 
-    std::string Properties::csvHeader() const {
-#       ifdef HAVE_CXX11_INITIALIZER_LISTS
-            return csv::fromContainer(
-                std::vector<std::string> {"L", "h", "a", "b", "InitialAngle"});
-#       else
-            return csv::fromContainer(
-                makeList<const char *>(nCols(), "L", "h", "a", "b",
-                                       "InitialAngle"));
-#       endif
+    unsigned int Schema<Properties>::nCols(const Properties &properties) {
+        return properties.distanceScale != 0 ? 7 : 5;
     }
 
-    std::string Properties::csv() const {
-#       ifdef HAVE_CXX11_INITIALIZER_LISTS
-            return csv::fromContainer(
-                std::vector<float> {L, h, a, b, theta0});
-#       else
-            return csv::fromContainer(
-                makeList<float>(nCols(), L, h, a, b, theta0));
-#       endif
+    std::string Schema<Properties>::header(const Properties &properties) {
+        return joinColumns(COLUMNS, nCols(properties));
     }
 
-    unsigned int Properties::nCols() const {
-        return 5;
+    void Schema<Properties>::write(Row &row, const Properties &properties) {
+        row.put(properties.L);
+        row.put(properties.h);
+        row.put(properties.a);
+        row.put(properties.b);
+        row.put(properties.theta0);
+        if (properties.distanceScale != 0) {
+            // Readers multiply by these, so they must not be rounded.
+            row.put(properties.distanceScale, FloatFormat::shortest());
+            row.put(properties.intensityScale, FloatFormat::shortest());
+        }
+    }
+
+    const char *const Schema<NoiseSeed>::COLUMNS[] = {"Seed"};
+
+    void Schema<NoiseSeed>::write(Row &row, const NoiseSeed &seed) {
+        row.put(static_cast<unsigned int>(seed.seed));
+    }
+
+    const char *const Schema<LateSamples>::COLUMNS[] =
+        {"Lateness", "LateSamples"};
+
+    void Schema<LateSamples>::write(Row &row, const LateSamples &late) {
+        row.put(late.lateness);
+        row.put(late.count);
+    }
+
+    const char *const Schema<DroppedSaves>::COLUMNS[] =
+        {"QueueDepth", "DroppedSaves"};
+
+    void Schema<DroppedSaves>::write(Row &row, const DroppedSaves &dropped) {
+        row.put(static_cast<unsigned long long>(dropped.queueDepth));
+        row.put(dropped.count);
+    }
+
+    const char *const Schema<StageStats>::COLUMNS[] =
+        {"Stage", "Count", "P50Micros", "P99Micros", "MaxMicros"};
+
+    void Schema<StageStats>::write(Row &row, const StageStats &stats) {
+        row.put(stats.stage);
+        row.put(stats.count);
+        row.put(stats.p50);
+        row.put(stats.p99);
+        row.put(stats.max);
+    }
+
+    const char *const Schema<Sample>::COLUMNS[] = {"Time", "Sensor"};
+
+    void Schema<Sample>::write(Row &row, const Sample &sample) {
+        row.put(sample.time);
+        row.put(static_cast<unsigned int>(sample.sensorId));
+    }
+
+}
+
+
+// Callbacks //
+namespace {
+
+    Tick::Tick(Pose &&pose, ControlSignals &&controls, LidarDatum &&laser)
+        : pose(std::move(pose)), controls(std::move(controls)),
+          laser(std::move(laser)) {
+    }
+
+    float Tick::timestamp() const {
+        return pose.time;
     }
 
     Sample::Sample(const Pose &pose)
@@ -236,168 +926,1155 @@ namespace {
         : time(datum.time), sensorId(3) {
     }
 
-    std::string Sample::csvHeader() const {
-        return "Time,Sensor";
+    float Sample::timestamp() const {
+        return time;
     }
 
-    std::string Sample::csv() const {
-        return std::to_string(time) + "," + std::to_string(sensorId);
+    arrowIpc::Schema Sample::arrowSchema() const {
+        arrowIpc::Schema result;
+        result.push_back(arrowIpc::Field("Time", arrowIpc::Type::FLOAT32));
+        result.push_back(arrowIpc::Field("Sensor", arrowIpc::Type::UINT16));
+        return result;
     }
 
-    unsigned int Sample::nCols() const {
-        return 2;
+    void Sample::appendTo(arrowIpc::BatchBuilder &batch) const {
+        batch.put(time);
+        batch.put(static_cast<std::uint16_t>(sensorId));
     }
 
     simVoid init(SLuaCallBack *const simCall) {
-        // Clean data from previous runs.
-        boost::filesystem::remove_all(path::dataDir + path::groundDir);
-        boost::filesystem::remove_all(path::dataDir + path::noisyDir);
-        boost::filesystem::remove(path::dataDir + path::properties);
-        // Save the passed directory as the base directory for the output.
         vrep::LuaCall call(simCall);
-        path::dataDir = call.expectAtom<std::string>();
-        // Save the passed properties in the properties file.
+        // The passed directory is the base directory for the vehicle's output.
+        const std::string dataDir = call.expectAtom<std::string>();
+        // Read the run properties; they're saved once the options are known.
         const float L = call.expectAtom<float>();
         const float h = call.expectAtom<float>();
         const float a = call.expectAtom<float>();
         const float b = call.expectAtom<float>();
         const float theta0 = call.expectAtom<float>();
-        savePropertiesFile(Properties(L, h, a, b, theta0));
-        // Save the maximum distance and intensity settings.
-        laser::MAX_DISTANCE = call.expectAtom<float>();
-        laser::MAX_INTENSITY = call.expectAtom<float>();
-        // Reset the noise settings.
-        noise::requested = false;
-        const std::array<boost::optional<GaussianNoiseSource<float>> *const, 6> sources =
-            {{&noise::position, &noise::angle, &noise::speed,
-              &noise::steeringAngle, &noise::intensity, &noise::distance}};
-        for (boost::optional<GaussianNoiseSource<float>> *const source : sources) {
-            *source = boost::none;
+        // Read the maximum distance and intensity settings.
+        const float maxDistance = call.expectAtom<float>();
+        const float maxIntensity = call.expectAtom<float>();
+        const Options options =
+            parseOptions(call.optionalAtom<std::string>().get_value_or(""));
+        /* Lidar values stored as integers cover 0 to the maximum, and the
+         * properties say how. */
+        if (options.quantizeLaser
+            && ! (0 < maxDistance
+                  && maxDistance < std::numeric_limits<float>::infinity()
+                  && 0 < maxIntensity
+                  && maxIntensity < std::numeric_limits<float>::infinity())) {
+            throw std::invalid_argument(
+                "laserStorage=uint16 needs a positive, finite max_distance "
+                "and max_intensity");
         }
+        const Properties properties(
+            L, h, a, b, theta0,
+            options.quantizeLaser ? lidar::Quantizer(maxDistance).scale() : 0,
+            options.quantizeLaser ? lidar::Quantizer(maxIntensity).scale()
+                                  : 0);
+        /* A vehicle already recording in the directory is replaced, and
+         * keeps its handle; otherwise, this is a new vehicle. */
+        std::shared_ptr<Vehicle> previous;
+        std::size_t index = 0;
+        {
+            const std::lock_guard<std::mutex> lock(vehicles::lock);
+            while (index < vehicles::all.size()
+                   && vehicles::all[index]->dataDir != dataDir) {
+                index++;
+            }
+            if (index < vehicles::all.size()) {
+                previous = vehicles::all[index];
+            }
+        }
+        const std::shared_ptr<Vehicle> vehicle = std::make_shared<Vehicle>(
+            dataDir, options, maxDistance, maxIntensity);
+        const latency::Timer timer(vehicle->stats[stats::INIT]);
+        // Close the files from any previous run before touching them.
+        if (previous) {
+            finishVehicle(*previous);
+        }
+        // Clean data from previous runs.
+        boost::filesystem::remove_all(dataDir + path::groundDir);
+        removeNoisyDirs(dataDir);
+        boost::filesystem::remove(dataDir + path::properties);
+        boost::filesystem::remove(dataDir + path::stats);
+        boost::filesystem::remove(dataDir + path::droppedSaves);
+        /* Save the properties, and start the writer thread if the run asked
+         * for one. */
+        savePropertiesFile(dataDir, properties, options.floatFormat);
+        openDataSet(vehicle->ground);
+        startOutputThreads(*vehicle);
+        // Calls without a handle record for this vehicle from now on.
+        int handle;
+        {
+            const std::lock_guard<std::mutex> lock(vehicles::lock);
+            if (previous) {
+                vehicles::all[index] = vehicle;
+            } else {
+                vehicles::all.push_back(vehicle);
+                index = vehicles::all.size() - 1;
+            }
+            handle = static_cast<int>(index) + 1;
+            vehicles::current = handle;
+        }
+        vrep::LuaReturn result(simCall);
+        result.addAtom(handle);
+        result.commit();
     }
 
     simVoid setNoiseParameters(SLuaCallBack *const simCall) {
         vrep::LuaCall call(simCall);
-        const std::array<boost::optional<GaussianNoiseSource<float>> *const, 6> sources =
-            {{&noise::position, &noise::angle, &noise::speed,
-              &noise::steeringAngle, &noise::intensity, &noise::distance}};
-        for (boost::optional<GaussianNoiseSource<float>> *const source : sources) {
-            *source = gaussian(call.expectTable<float>());
+        const std::shared_ptr<Vehicle> vehicle = vehicleFor(call, 8);
+        const latency::Timer timer(
+            vehicle->stats[stats::SET_NOISE_PARAMETERS]);
+        std::array<std::vector<float>, 6> params;
+        for (std::vector<float> &param : params) {
+            param = call.expectTable<float>();
         }
-        noise::requested = true;
+        /* Use the caller's seed if there is one, and save it either way so
+         * the noisy data sets can be regenerated. */
+        const boost::optional<int> requestedSeed = call.optionalAtom<int>();
+        const std::uint32_t seed = requestedSeed
+            ? static_cast<std::uint32_t>(*requestedSeed)
+            : randomSeed();
+        /* A single data set goes in noisy; if the caller asked for a number
+         * of them, they go in noisy_0, noisy_1, .... */
+        const boost::optional<int> count = call.optionalAtom<int>();
+        if (count && *count < 1) {
+            throw std::invalid_argument(
+                "number of realizations must be positive");
+        }
+        /* Data recorded so far don't get the new noise, so write out any
+         * saved by other threads or kept in memory.  The output threads use
+         * the noise sources, so let them finish and close the noisy files
+         * first. */
+        std::unique_lock<std::mutex> lock(vehicle->recording);
+        recordIntake(*vehicle);
+        flushMemory(*vehicle);
+        stopOutputThreads(*vehicle);
+        closeNoisyFiles(*vehicle);
+        vehicle->realizations.clear();
+        for (int i = 0; i < count.get_value_or(1); i++) {
+            const std::string dir = vehicle->dataDir + path::noisyDir
+                + (count ? "_" + std::to_string(i) : "");
+            saveNoiseSeedFile(dir, NoiseSeed(seed));
+            vehicle->realizations.emplace_back(
+                new Realization(dir, vehicle->options, params, seed, i));
+            openDataSet(*vehicle->realizations.back());
+        }
+        startOutputThreads(*vehicle);
+        // Other threads may have left saves for this one meanwhile.
+        lock.unlock();
+        pump(*vehicle);
     }
 
     simVoid savePose(SLuaCallBack *const simCall) {
-        // Build the pose.
         vrep::LuaCall call(simCall);
+        const std::shared_ptr<Vehicle> vehicle = vehicleFor(call, 4);
+        const latency::Timer timer(vehicle->stats[stats::SAVE_POSE]);
+        // Build the pose.
         const float time = call.expectAtom<float>();
         const float x = call.expectAtom<float>();
         const float y = call.expectAtom<float>();
         const float theta = call.expectAtom<float>();
-        const Pose pose(time, x, y, theta);
         // Record it.
-        saveDatum(path::groundDir, path::pose, pose);
-        if (noise::requested) {
-            saveDatum(path::noisyDir, path::pose,
-                      addNoise(pose, noise::position.get_value_or(noise::none),
-                               noise::angle.get_value_or(noise::none)));
-        }
+        submit(*vehicle, Pose(time, x, y, theta));
     }
 
     simVoid saveControls(SLuaCallBack *const simCall) {
-        // Build the control systems object.
         vrep::LuaCall call(simCall);
+        const std::shared_ptr<Vehicle> vehicle = vehicleFor(call, 3);
+        const latency::Timer timer(vehicle->stats[stats::SAVE_CONTROLS]);
+        // Build the control systems object.
         const float time = call.expectAtom<float>();
         const float speed = call.expectAtom<float>();
         const float angle = call.expectAtom<float>();
-        const ControlSignals signals(time, speed, angle);
         // Record it.
-        saveDatum(path::groundDir, path::control, signals);
-        if (noise::requested) {
-            saveDatum(path::noisyDir, path::control,
-                      addNoise(signals, noise::speed.get_value_or(noise::none),
-                               noise::steeringAngle.get_value_or(noise::none)));
+        submit(*vehicle, ControlSignals(time, speed, angle));
+    }
+
+    simVoid savePoseBatch(SLuaCallBack *const simCall) {
+        vrep::LuaCall call(simCall);
+        const std::shared_ptr<Vehicle> vehicle = vehicleFor(call, 4);
+        const latency::Timer timer(vehicle->stats[stats::SAVE_POSE_BATCH]);
+        // View the columns in place and build all the poses in one pass.
+        const Span<const float> times = call.viewTable<float>();
+        const Span<const float> xs = call.viewTable<float>();
+        const Span<const float> ys = call.viewTable<float>();
+        const Span<const float> thetas = call.viewTable<float>();
+        if (xs.size() != times.size() || ys.size() != times.size()
+            || thetas.size() != times.size()) {
+            throw vrep::MarshalingError(
+                "simExtAutomobileSavePoseBatch: tables differ in length");
+        }
+        std::vector<Pose> poses;
+        poses.reserve(times.size());
+        for (std::size_t i = 0; i < times.size(); i++) {
+            poses.emplace_back(times[i], xs[i], ys[i], thetas[i]);
         }
+        // Record them.
+        submitAll(*vehicle, std::move(poses));
+    }
+
+    simVoid saveControlsBatch(SLuaCallBack *const simCall) {
+        vrep::LuaCall call(simCall);
+        const std::shared_ptr<Vehicle> vehicle = vehicleFor(call, 3);
+        const latency::Timer timer(vehicle->stats[stats::SAVE_CONTROLS_BATCH]);
+        // View the columns in place and build all the signals in one pass.
+        const Span<const float> times = call.viewTable<float>();
+        const Span<const float> speeds = call.viewTable<float>();
+        const Span<const float> angles = call.viewTable<float>();
+        if (speeds.size() != times.size() || angles.size() != times.size()) {
+            throw vrep::MarshalingError(
+                "simExtAutomobileSaveControlsBatch: tables differ in length");
+        }
+        std::vector<ControlSignals> signals;
+        signals.reserve(times.size());
+        for (std::size_t i = 0; i < times.size(); i++) {
+            signals.emplace_back(times[i], speeds[i], angles[i]);
+        }
+        // Record them.
+        submitAll(*vehicle, std::move(signals));
     }
 
     simVoid saveLaser(SLuaCallBack *const simCall) {
-        // Get the arguments and reconstruct the full lidar measurements.
         vrep::LuaCall call(simCall);
+        const std::shared_ptr<Vehicle> vehicle = vehicleFor(call, 5);
+        const latency::Timer timer(vehicle->stats[stats::SAVE_LASER]);
+        submit(*vehicle, readLaser(*vehicle, call));
+    }
+
+    simVoid saveTick(SLuaCallBack *const simCall) {
+        vrep::LuaCall call(simCall);
+        const std::shared_ptr<Vehicle> vehicle = vehicleFor(call, 10);
+        const latency::Timer timer(vehicle->stats[stats::SAVE_TICK]);
+        /* Read and check every argument before recording anything, so a bad
+         * call does not leave a partial step behind. */
         const float time = call.expectAtom<float>();
-        std::vector<float> distance = call.expectTable<float>();
-        const std::vector<float> distanceRight = call.expectTable<float>();
-        distance.insert(distance.end(),
-                        distanceRight.begin(), distanceRight.end());
-        std::vector<float> image = call.expectTable<float>();
-        const std::vector<float> imageRight = call.expectTable<float>();
-        image.insert(image.end(), imageRight.begin(), imageRight.end());
-        // Process the lidar measurements.
-#       ifdef HAVE_CXX11_CLOSURES
-            std::for_each(distance.begin(), distance.end(),
-                          [](float &d) { d *= laser::MAX_DISTANCE; });
-            std::for_each(image.begin(), image.end(),
-                          [](float &i) { i *= laser::MAX_INTENSITY; });
-#       else
-            for (float &d : distance) {
-                d *= laser::MAX_DISTANCE;
+        const float x = call.expectAtom<float>();
+        const float y = call.expectAtom<float>();
+        const float theta = call.expectAtom<float>();
+        const float speed = call.expectAtom<float>();
+        const float steeringAngle = call.expectAtom<float>();
+        Pose pose(time, x, y, theta);
+        ControlSignals controls(time, speed, steeringAngle);
+        LidarDatum laser = readLaser(*vehicle, time, call);
+        // Record the whole step at once.
+        submit(*vehicle,
+               Tick(std::move(pose), std::move(controls), std::move(laser)));
+    }
+
+    simVoid getStats(SLuaCallBack *const simCall) {
+        const vrep::LuaCall call(simCall);
+        const std::shared_ptr<Vehicle> vehicle = vehicleFor(call, 0);
+        std::vector<std::string> stages;
+        std::vector<int> counts;
+        std::vector<float> p50;
+        std::vector<float> p99;
+        std::vector<float> max;
+        for (std::size_t i = 0; i < stats::N_STAGES; i++) {
+            const latency::Histogram &histogram = vehicle->stats[i];
+            stages.push_back(stats::NAMES[i]);
+            counts.push_back(static_cast<int>(std::min<std::uint64_t>(
+                histogram.count(), std::numeric_limits<int>::max())));
+            p50.push_back(histogram.percentile(0.5) / 1000.f);
+            p99.push_back(histogram.percentile(0.99) / 1000.f);
+            max.push_back(histogram.max() / 1000.f);
+        }
+        vrep::LuaReturn result(simCall);
+        result.addTable(stages);
+        result.addTable(counts);
+        result.addTable(p50);
+        result.addTable(p99);
+        result.addTable(max);
+        result.commit();
+    }
+
+    std::shared_ptr<Vehicle> vehicleFor(const vrep::LuaCall &call,
+                                        const std::size_t index) {
+        const boost::optional<int> handle = call.optionalIntAt(index);
+        const std::lock_guard<std::mutex> lock(vehicles::lock);
+        if (! handle) {
+            /* Cars which record before any simExtAutomobileInit get the
+             * defaults, as they always have. */
+            if (vehicles::current == 0) {
+                vehicles::all.push_back(std::make_shared<Vehicle>(
+                    path::defaultDataDir, Options(),
+                    laser::DEFAULT_MAX_DISTANCE,
+                    laser::DEFAULT_MAX_INTENSITY));
+                vehicles::current = static_cast<int>(vehicles::all.size());
             }
-            for (float &i : image) {
-                i *= laser::MAX_INTENSITY;
+            return vehicles::all[vehicles::current - 1];
+        }
+        if (*handle < 1
+            || static_cast<std::size_t>(*handle) > vehicles::all.size()) {
+            throw std::invalid_argument("no vehicle with handle "
+                                        + std::to_string(*handle));
+        }
+        return vehicles::all[*handle - 1];
+    }
+
+    LidarDatum readLaser(const Vehicle &vehicle, vrep::LuaCall &call) {
+        const float time = call.expectAtom<float>();
+        return readLaser(vehicle, time, call);
+    }
+
+    LidarDatum readLaser(const Vehicle &vehicle, const float time,
+                         vrep::LuaCall &call) {
+        /* The tables are large, so view them in place rather than copying
+         * them out. */
+        const Span<const float> distanceLeft = call.viewTable<float>();
+        const Span<const float> distanceRight = call.viewTable<float>();
+        const Span<const float> imageLeft = call.viewTable<float>();
+        const Span<const float> imageRight = call.viewTable<float>();
+        /* Reconstruct and scale the lidar measurements in one pass, keeping
+         * only the beams the run selected, so the rest cost nothing more. */
+        const lidar::BeamSelection &beams = vehicle.options.beams;
+        std::vector<float> distance(
+            beams.count(distanceLeft.size() + distanceRight.size()));
+        beams.selectScaled(distanceLeft, distanceRight, vehicle.maxDistance,
+                           distance.data());
+        std::vector<float> image(
+            beams.count(imageLeft.size() + imageRight.size()));
+        beams.selectScaled(imageLeft, imageRight, vehicle.maxIntensity,
+                           image.data());
+        return LidarDatum(time, std::move(distance), std::move(image));
+    }
+
+    void savePropertiesFile(const std::string &dataDir,
+                            const Properties &properties,
+                            const csv::FloatFormat floatFormat) {
+        // This is written once per run, so don't keep it open.
+        output::CsvFile file(dataDir + path::properties, properties,
+                             floatFormat, output::Backend::BUFFERED);
+        file.writeRow(properties);
+        file.close();
+    }
+
+    void saveNoiseSeedFile(const std::string &dir, const NoiseSeed &seed) {
+        output::CsvFile file(dir + path::noiseSeed, seed,
+                             csv::FloatFormat::shortest(),
+                             output::Backend::BUFFERED);
+        file.writeRow(seed);
+        file.close();
+    }
+
+    void saveStatsFile(const Vehicle &vehicle) {
+        // Replace the file from any earlier save; the stats cover the run.
+        const std::string path = vehicle.dataDir + path::stats;
+        boost::filesystem::remove(path);
+        const StageStats header("", 0, 0, 0, 0);
+        output::CsvFile file(path, header, csv::FloatFormat::shortest(),
+                             output::Backend::BUFFERED);
+        for (std::size_t i = 0; i < stats::N_STAGES; i++) {
+            const latency::Histogram &histogram = vehicle.stats[i];
+            file.writeRow(StageStats(stats::NAMES[i], histogram.count(),
+                                     histogram.percentile(0.5) / 1000.f,
+                                     histogram.percentile(0.99) / 1000.f,
+                                     histogram.max() / 1000.f));
+        }
+        file.close();
+    }
+
+    void saveDroppedSavesFile(const Vehicle &vehicle) {
+        const Options &options = vehicle.options;
+        if (! options.asyncWriter
+            || options.queuePolicy != output::QueuePolicy::DROP) {
+            return;
+        }
+        // Replace the count from any earlier save; the count covers the run.
+        const std::string path = vehicle.dataDir + path::droppedSaves;
+        boost::filesystem::remove(path);
+        const DroppedSaves dropped(options.queueDepth, vehicle.droppedSaves);
+        output::CsvFile file(path, dropped, csv::FloatFormat::shortest(),
+                             output::Backend::BUFFERED);
+        file.writeRow(dropped);
+        file.close();
+    }
+
+    template<typename D>
+    void submit(Vehicle &vehicle, D datum) {
+        {
+            std::unique_lock<std::mutex> lock(vehicle.recording,
+                                              std::try_to_lock);
+            if (lock && vehicle.intake.empty()) {
+                // Nobody else is recording for the vehicle; skip the intake.
+                record(vehicle, std::move(datum));
+            } else {
+                const float time = datum.timestamp();
+                std::unique_ptr<output::Job> job(
+                    new PendingJob<D>(vehicle, std::move(datum)));
+                enqueue(vehicle, time, job, lock);
+            }
+        }
+        pump(vehicle);
+    }
+
+    template<typename D>
+    void submitAll(Vehicle &vehicle, std::vector<D> &&data) {
+        if (data.empty()) {
+            return;
+        }
+        {
+            std::unique_lock<std::mutex> lock(vehicle.recording,
+                                              std::try_to_lock);
+            if (lock && vehicle.intake.empty()) {
+                recordAll(vehicle, std::move(data));
+            } else {
+                // The series goes in the merge at the time of its first datum.
+                const float time = data.front().timestamp();
+                std::unique_ptr<output::Job> job(
+                    new PendingAllJob<D>(vehicle, std::move(data)));
+                enqueue(vehicle, time, job, lock);
+            }
+        }
+        pump(vehicle);
+    }
+
+    void enqueue(Vehicle &vehicle, const float time,
+                 std::unique_ptr<output::Job> &job,
+                 std::unique_lock<std::mutex> &lock) {
+        while (! vehicle.intake.tryPush(time, job)) {
+            if (! lock) {
+                lock.lock();
+            }
+            recordIntake(vehicle);
+        }
+        if (lock) {
+            recordIntake(vehicle);
+        }
+    }
+
+    void pump(Vehicle &vehicle) {
+        for (;;) {
+            /* A thread which finds the lock taken leaves its data for the
+             * thread holding it, which looks again after letting go.  The
+             * fence makes sure one of the two sees the other: either the
+             * holder sees the data, or the other thread sees the lock free. */
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (vehicle.intake.empty()) {
+                return;
+            }
+            const std::unique_lock<std::mutex> lock(vehicle.recording,
+                                                    std::try_to_lock);
+            if (! lock) {
+                return;
+            }
+            recordIntake(vehicle);
+        }
+    }
+
+    void recordIntake(Vehicle &vehicle) {
+        std::vector<std::unique_ptr<output::Job>> &merged = vehicle.merged;
+        vehicle.intake.drain(merged);
+        /* If a job fails, drop it, as a save which failed on its own thread
+         * would be, but keep the rest for next time. */
+        std::size_t nRun = 0;
+        try {
+            while (nRun < merged.size()) {
+                merged[nRun++]->run();
+            }
+        } catch (const std::exception &) {
+            merged.erase(merged.begin(), merged.begin() + nRun);
+            throw;
+        }
+        merged.clear();
+    }
+
+    template<typename D>
+    PendingJob<D>::PendingJob(Vehicle &vehicle, D &&datum)
+        : vehicle(vehicle), datum(std::move(datum)) {
+    }
+
+    template<typename D>
+    void PendingJob<D>::run() {
+        record(vehicle, std::move(datum));
+    }
+
+    template<typename D>
+    PendingAllJob<D>::PendingAllJob(Vehicle &vehicle, std::vector<D> &&data)
+        : vehicle(vehicle), data(std::move(data)) {
+    }
+
+    template<typename D>
+    void PendingAllJob<D>::run() {
+        recordAll(vehicle, std::move(data));
+    }
+
+    template<typename D>
+    void record(Vehicle &vehicle, D datum) {
+        if (vehicle.memory.active) {
+            if (keepInMemory(vehicle, datum)) {
+                return;
+            }
+            spillMemory(vehicle);
+        }
+        if (vehicle.writerThread) {
+            vehicle.writerThread->submit(
+                std::unique_ptr<output::Job>(
+                    new RecordJob<D>(vehicle, std::move(datum))));
+        } else {
+            recordNow(vehicle, datum);
+        }
+    }
+
+    template<typename D>
+    void recordNow(Vehicle &vehicle, const D &datum) {
+        saveDatum(vehicle, vehicle.ground, datum);
+        if (vehicle.noiseWorkers.empty()) {
+            for (const std::unique_ptr<Realization> &realization
+                     : vehicle.realizations) {
+                recordNoisy(vehicle, *realization, datum);
+            }
+        } else {
+            // Share one copy of the datum among the workers.
+            recordNoisyLater(vehicle, std::make_shared<const D>(datum), 1);
+        }
+    }
+
+    template<typename D>
+    void recordAll(Vehicle &vehicle, std::vector<D> &&data) {
+        if (vehicle.memory.active) {
+            // Keep as many as fit, and write the rest as they come.
+            typename std::vector<D>::iterator kept = data.begin();
+            while (kept != data.end() && keepInMemory(vehicle, *kept)) {
+                ++kept;
+            }
+            data.erase(data.begin(), kept);
+            if (! data.empty()) {
+                spillMemory(vehicle);
+            }
+        }
+        if (data.empty()) {
+            return;
+        }
+        if (vehicle.writerThread) {
+            vehicle.writerThread->submit(
+                std::unique_ptr<output::Job>(
+                    new RecordAllJob<D>(vehicle, std::move(data))));
+        } else {
+            recordAllNow(vehicle, std::move(data));
+        }
+    }
+
+    template<typename D>
+    void recordAllNow(Vehicle &vehicle, std::vector<D> &&data) {
+        for (const D &datum : data) {
+            saveDatum(vehicle, vehicle.ground, datum);
+        }
+        if (vehicle.noiseWorkers.empty()) {
+            for (const std::unique_ptr<Realization> &realization
+                     : vehicle.realizations) {
+                for (const D &datum : data) {
+                    recordNoisy(vehicle, *realization, datum);
+                }
+            }
+        } else if (! data.empty()) {
+            /* Share the series among the workers, pointing into the vector
+             * but keeping the whole thing alive. */
+            const std::shared_ptr<const std::vector<D>> shared =
+                std::make_shared<const std::vector<D>>(std::move(data));
+            recordNoisyLater(
+                vehicle, std::shared_ptr<const D>(shared, shared->data()),
+                shared->size());
+        }
+    }
+
+    template<typename D>
+    RecordJob<D>::RecordJob(Vehicle &vehicle, D &&datum)
+        : vehicle(vehicle), datum(std::move(datum)) {
+    }
+
+    template<typename D>
+    void RecordJob<D>::run() {
+        recordNow(vehicle, datum);
+    }
+
+    template<typename D>
+    RecordAllJob<D>::RecordAllJob(Vehicle &vehicle, std::vector<D> &&data)
+        : vehicle(vehicle), data(std::move(data)) {
+    }
+
+    template<typename D>
+    void RecordAllJob<D>::run() {
+        recordAllNow(vehicle, std::move(data));
+    }
+
+    template<typename D>
+    void recordNoisy(Vehicle &vehicle, Realization &realization,
+                     const D &datum) {
+        saveDatum(vehicle, realization,
+                  timedWithNoise(vehicle, realization, datum));
+    }
+
+    template<typename D>
+    D timedWithNoise(Vehicle &vehicle, Realization &realization,
+                     const D &datum) {
+        const latency::Timer timer(vehicle.stats[stats::ADD_NOISE]);
+        return withNoise(realization, datum);
+    }
+
+    template<typename D>
+    void recordNoisyLater(Vehicle &vehicle,
+                          const std::shared_ptr<const D> &first,
+                          const std::size_t count) {
+        const std::size_t nWorkers = vehicle.noiseWorkers.size();
+        for (std::size_t i = 0; i < nWorkers; i++) {
+            vehicle.noiseWorkers[i]->submit(std::unique_ptr<output::Job>(
+                new NoiseJob<D>(vehicle, first, count, i, nWorkers)));
+        }
+    }
+
+    template<typename D>
+    NoiseJob<D>::NoiseJob(Vehicle &vehicle,
+                          const std::shared_ptr<const D> &first,
+                          const std::size_t count, const std::size_t worker,
+                          const std::size_t nWorkers)
+        : vehicle(vehicle), first(first), count(count), worker(worker),
+          nWorkers(nWorkers) {
+    }
+
+    template<typename D>
+    void NoiseJob<D>::run() {
+        for (std::size_t i = worker; i < vehicle.realizations.size();
+             i += nWorkers) {
+            for (std::size_t j = 0; j < count; j++) {
+                recordNoisy(vehicle, *vehicle.realizations[i],
+                            first.get()[j]);
+            }
+        }
+    }
+
+    output::Registry::Entry &fileFor(DataSet &data, const Pose &pose) {
+        return openFile(data, data.pose, path::pose, pose);
+    }
+
+    output::Registry::Entry &fileFor(DataSet &data,
+                                     const ControlSignals &controls) {
+        return openFile(data, data.control, path::control, controls);
+    }
+
+    output::Registry::Entry &fileFor(DataSet &data, const LidarDatum &scan) {
+        return openFile(data, data.laser, path::laser, scan);
+    }
+
+    output::Registry::Entry &fileFor(DataSet &data,
+                                     const QuantizedLidarDatum &scan) {
+        return openFile(data, data.laser, path::laser, scan);
+    }
+
+    output::Registry::Entry &fileFor(DataSet &data, const Sample &sample) {
+        return openFile(data, data.sensor, path::sensor, sample);
+    }
+
+    template<typename D>
+    output::Registry::Entry &openFile(DataSet &data,
+                                      output::Registry::Entry *&entry,
+                                      const std::string &path,
+                                      const D &datum) {
+        if (! entry) {
+            entry = &data.files.open(data.dir + path, datum);
+        }
+        return *entry;
+    }
+
+    Pose withNoise(Realization &realization, const Pose &pose) {
+        return addNoise(pose, realization.position, realization.angle);
+    }
+
+    ControlSignals withNoise(Realization &realization,
+                             const ControlSignals &signals) {
+        return addNoise(signals, realization.speed,
+                        realization.steeringAngle);
+    }
+
+    LidarDatum withNoise(Realization &realization, const LidarDatum &datum) {
+        return addNoise(datum, realization.distance, realization.intensity);
+    }
+
+    Tick withNoise(Realization &realization, const Tick &tick) {
+        return Tick(withNoise(realization, tick.pose),
+                    withNoise(realization, tick.controls),
+                    withNoise(realization, tick.laser));
+    }
+
+    Realization::Realization(const std::string &dir, const Options &options,
+                             const std::array<std::vector<float>, 6> &params,
+                             const std::uint32_t seed,
+                             const std::uint32_t index)
+        : DataSet(dir),
+          position(gaussian(params[0], seed, streamFor(index, 0))),
+          angle(gaussian(params[1], seed, streamFor(index, 1))),
+          speed(gaussian(params[2], seed, streamFor(index, 2))),
+          steeringAngle(gaussian(params[3], seed, streamFor(index, 3))),
+          intensity(gaussian(params[4], seed, streamFor(index, 4))),
+          distance(gaussian(params[5], seed, streamFor(index, 5))) {
+        configure(*this, options);
+    }
+
+    DataSet::DataSet(const std::string &dir)
+        : dir(dir), files(), samples(), released(), quantized(),
+          pose(nullptr), control(nullptr), laser(nullptr), sensor(nullptr) {
+    }
+
+    memory::Store::Store(const bool active)
+        : active(active), entries(8192), beams(std::size_t(1) << 18) {
+    }
+
+    Vehicle::Vehicle(const std::string &dataDir, const Options &options,
+                     const float maxDistance, const float maxIntensity)
+        : dataDir(dataDir), options(options), maxDistance(maxDistance),
+          maxIntensity(maxIntensity), distanceQuantizer(maxDistance),
+          intensityQuantizer(maxIntensity), ground(dataDir + path::groundDir),
+          writerThread(), droppedSaves(0), realizations(), noiseWorkers(),
+          memory(options.inMemory), stats(), recording(),
+          intake(INTAKE_CAPACITY), merged() {
+        configure(ground, options);
+    }
+
+    void configure(DataSet &data, const Options &options) {
+        data.files.setFormat(options.format);
+        data.files.setFloatFormat(options.floatFormat);
+        data.files.setCompression(options.compression);
+        data.files.setBackend(options.backend);
+        data.files.setIndexing(options.timeIndex);
+        data.samples.reset(options.reorderSamples
+                           ? new ReorderBuffer<Sample>(N_SENSORS,
+                                                       options.lateness,
+                                                       REORDER_CAPACITY)
+                           : nullptr);
+    }
+
+    std::uint64_t streamFor(const std::uint32_t realization,
+                            const std::uint32_t source) {
+        return static_cast<std::uint64_t>(realization) << 32 | source;
+    }
+
+    void startOutputThreads(Vehicle &vehicle) {
+        startWriterThread(vehicle);
+        /* Data kept in memory are written all at once at the end, so it pays
+         * to write even a single noisy data set alongside the ground truth
+         * then. */
+        const Options &options = vehicle.options;
+        if (vehicle.realizations.size() > 1
+            || (options.inMemory && ! vehicle.realizations.empty())) {
+            std::size_t nWorkers = options.noiseThreads;
+            if (nWorkers == 0) {
+                nWorkers = std::max(std::thread::hardware_concurrency(), 1u);
+            }
+            nWorkers = std::min(nWorkers, vehicle.realizations.size());
+            /* The workers never drop data; if they fall behind, whoever
+             * feeds them waits. */
+            for (std::size_t i = 0; i < nWorkers; i++) {
+                vehicle.noiseWorkers.emplace_back(
+                    new output::AsyncWriter(options.queueDepth,
+                                            output::QueuePolicy::BLOCK));
+            }
+        }
+    }
+
+    void startWriterThread(Vehicle &vehicle) {
+        if (vehicle.options.asyncWriter && ! vehicle.memory.active) {
+            vehicle.writerThread.reset(
+                new output::AsyncWriter(vehicle.options.queueDepth,
+                                        vehicle.options.queuePolicy));
+        }
+    }
+
+    bool keepInMemory(Vehicle &vehicle, const Pose &pose) {
+        if (! fitsInMemory(vehicle, 1, 0)) {
+            return false;
+        }
+        memory::Entry &entry = newEntry(vehicle.memory,
+                                        memory::Entry::Kind::POSE, pose.time);
+        entry.values[0] = pose.x;
+        entry.values[1] = pose.y;
+        entry.values[2] = pose.theta;
+        return true;
+    }
+
+    bool keepInMemory(Vehicle &vehicle, const ControlSignals &signals) {
+        if (! fitsInMemory(vehicle, 1, 0)) {
+            return false;
+        }
+        memory::Entry &entry = newEntry(vehicle.memory,
+                                        memory::Entry::Kind::CONTROLS,
+                                        signals.time);
+        entry.values[0] = signals.speed;
+        entry.values[1] = signals.steeringAngle;
+        return true;
+    }
+
+    bool keepInMemory(Vehicle &vehicle, const LidarDatum &datum) {
+        const std::size_t nDistance = datum.distance.size();
+        const std::size_t nIntensity = datum.intensity.size();
+        if (! fitsInMemory(vehicle, 1, nDistance + nIntensity)) {
+            return false;
+        }
+        float *const beams =
+            vehicle.memory.beams.allocate(nDistance + nIntensity);
+        std::copy(datum.distance.begin(), datum.distance.end(), beams);
+        std::copy(datum.intensity.begin(), datum.intensity.end(),
+                  beams + nDistance);
+        memory::Entry &entry = newEntry(vehicle.memory,
+                                        memory::Entry::Kind::LASER,
+                                        datum.time);
+        entry.beams = beams;
+        entry.nDistance = nDistance;
+        entry.nIntensity = nIntensity;
+        return true;
+    }
+
+    bool keepInMemory(Vehicle &vehicle, const Tick &tick) {
+        // Keep all of the step or none of it.
+        if (! fitsInMemory(vehicle, 3, tick.laser.distance.size()
+                                           + tick.laser.intensity.size())) {
+            return false;
+        }
+        return keepInMemory(vehicle, tick.pose)
+            && keepInMemory(vehicle, tick.controls)
+            && keepInMemory(vehicle, tick.laser);
+    }
+
+    bool fitsInMemory(const Vehicle &vehicle, const std::size_t nEntries,
+                      const std::size_t nBeams) {
+        const memory::Store &store = vehicle.memory;
+        return store.entries.bytes() + store.entries.growth(nEntries)
+            + store.beams.bytes() + store.beams.growth(nBeams)
+            <= vehicle.options.memoryLimit;
+    }
+
+    memory::Entry &newEntry(memory::Store &store,
+                            const memory::Entry::Kind kind, const float time) {
+        memory::Entry &entry = *store.entries.allocate(1);
+        entry.kind = kind;
+        entry.time = time;
+        std::fill_n(entry.values, 3, 0.f);
+        entry.beams = nullptr;
+        entry.nDistance = 0;
+        entry.nIntensity = 0;
+        return entry;
+    }
+
+    void flushMemory(Vehicle &vehicle) {
+        /* Free the data even if writing them fails, so they are not written
+         * a second time later. */
+        memory::Store &store = vehicle.memory;
+        try {
+            for (std::size_t i = 0; i < store.entries.nChunks(); i++) {
+                for (const memory::Entry &entry : store.entries.chunk(i)) {
+                    replay(vehicle, entry);
+                }
             }
-#       endif
-        // Build the lidar datum and record it.
-        const LidarDatum datum(time, distance, image);
-        saveDatum(path::groundDir, path::laser, datum);
-        if (noise::requested) {
-            saveDatum(path::noisyDir, path::laser,
-                      addNoise(datum, noise::distance.get_value_or(noise::none),
-                               noise::intensity.get_value_or(noise::none)));
-        }
-    }
-
-    void savePropertiesFile(const Properties &properties) {
-        boost::filesystem::create_directories(path::dataDir);
-        outputDatum(path::dataDir + path::properties, properties);
-    }
-
-    template<typename CsvDatum>
-    void saveDatum(const std::string &subdir, const std::string &filename,
-                   const CsvDatum &datum) {
-        const std::string logDir = path::dataDir + subdir;
-        boost::filesystem::create_directories(logDir);
-        outputDatum(logDir + filename, datum);
-        outputDatum(logDir + path::sensor, Sample(datum));
-    }
-
-    void outputDatum(const std::string &filePath, const csv::Datum &datum) {
-        const std::string header = datum.csvHeader();
-        std::fstream file(filePath,
-                          std::ios::in | std::ios::out | std::ios::app);
-        // Ensure we're writing correctly-formatted data.
-        std::string firstLine;
-        std::getline(file, firstLine);
-        if (file.eof() && firstLine.empty()) {
-            // The file was empty, so write in the header.
-            file.clear();
-            file << header << std::endl;
-        } else if (firstLine != header) {
-            /* The file was nonempty, but the first line did not match the
-             * expected header.  This might occur if an external program
-             * modifies the file in between our writes, but more likely, we've
-             * got a bug somewhere that is causing us to write different data
-             * sets to the same file. */
-            throw std::logic_error(
-                std::string("CSV header mismatch: expected `")
-                + header
-                + "', but got `"
-                + firstLine
-                + "'");
+        } catch (const std::exception &) {
+            store.entries.clear();
+            store.beams.clear();
+            throw;
+        }
+        store.entries.clear();
+        store.beams.clear();
+    }
+
+    void replay(Vehicle &vehicle, const memory::Entry &entry) {
+        switch (entry.kind) {
+        case memory::Entry::Kind::POSE:
+            recordNow(vehicle, Pose(entry.time, entry.values[0],
+                                    entry.values[1], entry.values[2]));
+            break;
+        case memory::Entry::Kind::CONTROLS:
+            recordNow(vehicle, ControlSignals(entry.time, entry.values[0],
+                                              entry.values[1]));
+            break;
+        default:
+            {
+                const float *const intensity = entry.beams + entry.nDistance;
+                recordNow(vehicle, LidarDatum(
+                    entry.time,
+                    std::vector<float>(entry.beams, intensity),
+                    std::vector<float>(intensity,
+                                       intensity + entry.nIntensity)));
+            }
+            break;
+        }
+    }
+
+    void spillMemory(Vehicle &vehicle) {
+        // Leave memory mode first, so a failed write doesn't repeat.
+        vehicle.memory.active = false;
+        flushMemory(vehicle);
+        startWriterThread(vehicle);
+    }
+
+    void closeNoisyFiles(Vehicle &vehicle) {
+        std::exception_ptr firstError;
+        for (const std::unique_ptr<Realization> &realization
+                 : vehicle.realizations) {
+            runStep(std::bind(closeDataSet, std::ref(*realization),
+                              std::cref(vehicle.options)),
+                    firstError);
+        }
+        if (firstError) {
+            std::rethrow_exception(firstError);
+        }
+    }
+
+    void removeNoisyDirs(const std::string &dataDirName) {
+        const boost::filesystem::path dataDir(dataDirName);
+        if (! boost::filesystem::is_directory(dataDir)) {
+            return;
+        }
+        const std::string prefix = path::noisyDir.substr(1) + "_";
+        std::vector<boost::filesystem::path> doomed;
+        for (boost::filesystem::directory_iterator entry(dataDir), end;
+             entry != end; ++entry) {
+            const std::string name = entry->path().filename().string();
+            if (name == path::noisyDir.substr(1)
+                || name.compare(0, prefix.size(), prefix) == 0) {
+                doomed.push_back(entry->path());
+            }
+        }
+        for (const boost::filesystem::path &dir : doomed) {
+            boost::filesystem::remove_all(dir);
+        }
+    }
+
+    void stopOutputThreads(Vehicle &vehicle) {
+        /* Drop the threads even if they failed; errors are reported once,
+         * here, rather than on every later call.  The writer thread feeds
+         * the workers, so it goes first. */
+        std::exception_ptr firstError;
+        if (vehicle.writerThread) {
+            const std::unique_ptr<output::AsyncWriter> thread =
+                std::move(vehicle.writerThread);
+            runStep(std::bind(&output::AsyncWriter::finish, thread.get()),
+                    firstError);
+            vehicle.droppedSaves += thread->dropped();
+        }
+        std::vector<std::unique_ptr<output::AsyncWriter>> workers;
+        workers.swap(vehicle.noiseWorkers);
+        for (const std::unique_ptr<output::AsyncWriter> &worker : workers) {
+            runStep(std::bind(&output::AsyncWriter::finish, worker.get()),
+                    firstError);
+        }
+        if (firstError) {
+            std::rethrow_exception(firstError);
+        }
+    }
+
+    void waitForOutputThreads(Vehicle &vehicle) {
+        // The writer thread feeds the workers, so it goes first.
+        std::exception_ptr firstError;
+        if (vehicle.writerThread) {
+            runStep(std::bind(&output::AsyncWriter::wait,
+                              vehicle.writerThread.get()),
+                    firstError);
+        }
+        for (const std::unique_ptr<output::AsyncWriter> &worker
+                 : vehicle.noiseWorkers) {
+            runStep(std::bind(&output::AsyncWriter::wait, worker.get()),
+                    firstError);
+        }
+        if (firstError) {
+            std::rethrow_exception(firstError);
+        }
+    }
+
+    void openDataSet(DataSet &data) {
+        /* The lidar file's columns depend on the number of beams, so it
+         * waits for the first scan. */
+        const Pose pose(0, 0, 0, 0);
+        fileFor(data, pose);
+        fileFor(data, ControlSignals(0, 0, 0));
+        fileFor(data, Sample(pose));
+    }
+
+    void closeDataSet(DataSet &data, const Options &options) {
+        // Close the files even if the last samples can't be written.
+        std::exception_ptr firstError;
+        const std::array<std::function<void()>, 2> steps =
+            {{std::bind(writeLastSamples, std::ref(data), std::cref(options)),
+              std::bind(&output::Registry::closeAll, &data.files)}};
+        runAll(steps, firstError);
+        // The registry drops its files even if closing them fails.
+        data.pose = data.control = data.laser = data.sensor = nullptr;
+        if (firstError) {
+            std::rethrow_exception(firstError);
+        }
+    }
+
+    void writeLastSamples(DataSet &data, const Options &options) {
+        if (! data.samples) {
+            return;
+        }
+        data.samples->releaseAll(data.released);
+        writeReleasedSamples(data);
+        /* Replace any count from an earlier close; the count covers the
+         * whole run. */
+        const std::string path = data.dir + path::lateSamples;
+        boost::filesystem::remove(path);
+        const LateSamples late(data.samples->lateness(),
+                               data.samples->late());
+        output::CsvFile file(path, late, options.floatFormat,
+                             output::Backend::BUFFERED);
+        file.writeRow(late);
+        file.close();
+    }
+
+    template<typename D>
+    void saveDatum(Vehicle &vehicle, DataSet &data, const D &datum) {
+        const latency::Timer timer(vehicle.stats[stats::WRITE]);
+        writeDatum(vehicle, data, datum);
+        const Sample sample(datum);
+        saveSamples(data, Span<const Sample>(&sample, 1));
+    }
+
+    void saveDatum(Vehicle &vehicle, DataSet &data, const Tick &tick) {
+        const latency::Timer timer(vehicle.stats[stats::WRITE]);
+        writeDatum(vehicle, data, tick.pose);
+        writeDatum(vehicle, data, tick.controls);
+        writeDatum(vehicle, data, tick.laser);
+        const std::array<Sample, 3> samples =
+            {{Sample(tick.pose), Sample(tick.controls), Sample(tick.laser)}};
+        saveSamples(data, Span<const Sample>(samples.data(), samples.size()));
+    }
+
+    template<typename D>
+    void writeDatum(const Vehicle &, DataSet &data, const D &datum) {
+        output::Registry::write(fileFor(data, datum), datum);
+    }
+
+    void writeDatum(const Vehicle &vehicle, DataSet &data,
+                    const LidarDatum &scan) {
+        if (vehicle.options.quantizeLaser) {
+            data.quantized.assign(scan, vehicle.distanceQuantizer,
+                                  vehicle.intensityQuantizer);
+            output::Registry::write(fileFor(data, data.quantized),
+                                    data.quantized);
         } else {
-            /* The file was nonempty, and the headers matched what we expected.
-             * We're good to go. */
+            output::Registry::write(fileFor(data, scan), scan);
+        }
+    }
+
+    void saveSamples(DataSet &data, const Span<const Sample> samples) {
+        if (data.samples) {
+            /* Every sample goes in, so the table of contents matches the
+             * data files row for row; those too late to go in order are
+             * counted. */
+            for (const Sample &sample : samples) {
+                data.samples->push(sample.sensorId - 1, sample.time, sample);
+            }
+            data.samples->release(data.released);
+            writeReleasedSamples(data);
+        } else if (! samples.empty()) {
+            output::Registry::writeAll(fileFor(data, samples[0]), samples);
+        }
+    }
+
+    void writeReleasedSamples(DataSet &data) {
+        if (data.released.empty()) {
+            return;
+        }
+        output::Registry::writeAll(fileFor(data, data.released[0]),
+                                   Span<const Sample>(data.released));
+        data.released.clear();
+    }
+
+
+}
+
+
+// Finishing //
+
+void finishRecording() {
+    forEveryVehicle(finishVehicle);
+}
+
+void drainRecording() {
+    forEveryVehicle(drainVehicle);
+}
+
+namespace {
+
+    void finishVehicle(Vehicle &vehicle) {
+        /* Write out anything other threads left or kept in memory, then
+         * close every file, even if a thread or another file failed, and
+         * report the first failure afterward.  Saves other threads make
+         * meanwhile wait for the next call, which reopens the files. */
+        const std::lock_guard<std::mutex> lock(vehicle.recording);
+        std::exception_ptr firstError;
+        {
+            const latency::Timer timer(vehicle.stats[stats::FINISH]);
+            const std::array<std::function<void()>, 5> steps =
+                {{std::bind(recordIntake, std::ref(vehicle)),
+                  std::bind(flushMemory, std::ref(vehicle)),
+                  std::bind(stopOutputThreads, std::ref(vehicle)),
+                  std::bind(closeDataSet, std::ref(vehicle.ground),
+                            std::cref(vehicle.options)),
+                  std::bind(closeNoisyFiles, std::ref(vehicle))}};
+            runAll(steps, firstError);
+        }
+        // Save the stats last, so they count this finish.
+        const std::array<std::function<void()>, 2> saveStats =
+            {{std::bind(saveStatsFile, std::cref(vehicle)),
+              std::bind(saveDroppedSavesFile, std::cref(vehicle))}};
+        runAll(saveStats, firstError);
+        if (firstError) {
+            std::rethrow_exception(firstError);
+        }
+    }
+
+    void drainVehicle(Vehicle &vehicle) {
+        /* Write out what other threads left or is kept in memory even if the
+         * threads failed, and report the first failure afterward. */
+        std::unique_lock<std::mutex> lock(vehicle.recording);
+        std::exception_ptr firstError;
+        const std::array<std::function<void()>, 3> steps =
+            {{std::bind(recordIntake, std::ref(vehicle)),
+              std::bind(flushMemory, std::ref(vehicle)),
+              std::bind(waitForOutputThreads, std::ref(vehicle))}};
+        runAll(steps, firstError);
+        lock.unlock();
+        if (firstError) {
+            std::rethrow_exception(firstError);
+        }
+        // Other threads may have left saves for this one meanwhile.
+        pump(vehicle);
+    }
+
+    void runStep(const std::function<void()> &step,
+                 std::exception_ptr &firstError) {
+        try {
+            step();
+        } catch (const std::exception &) {
+            if (! firstError) {
+                firstError = std::current_exception();
+            }
+        }
+    }
+
+    template<std::size_t N>
+    void runAll(const std::array<std::function<void()>, N> &steps,
+                std::exception_ptr &firstError) {
+        for (const std::function<void()> &step : steps) {
+            runStep(step, firstError);
+        }
+    }
+
+    void forEveryVehicle(void (&run)(Vehicle &)) {
+        // Vehicles initialized meanwhile wait for the next call.
+        std::vector<std::shared_ptr<Vehicle>> all;
+        {
+            const std::lock_guard<std::mutex> lock(vehicles::lock);
+            all = vehicles::all;
+        }
+        std::exception_ptr firstError;
+        for (const std::shared_ptr<Vehicle> &vehicle : all) {
+            runStep(std::bind(run, std::ref(*vehicle)), firstError);
+        }
+        if (firstError) {
+            std::rethrow_exception(firstError);
         }
-        // Write the datum.
-        file << datum.csv() << std::endl;
     }
 
 }
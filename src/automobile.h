@@ -27,4 +27,13 @@
 
 void registerLuaFunctions();
 
+/* Flushes and closes all output files.  The next save reopens them, so this is
+ * safe to call at any point in a run. */
+void finishRecording();
+
+/* Writes out everything recorded so far--data kept in memory or queued for
+ * background threads--but leaves the files open.  Safe to call at any point
+ * in a run. */
+void drainRecording();
+
 #endif
@@ -0,0 +1,838 @@
+/* automobileTest.cpp -- unit tests for recording through the plugin
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "automobile.h"
+#include "lidar.h"
+#include "main.h"
+#include "span.h"
+#include "unitTest.h"
+#include "vrepStub.h"
+
+namespace {
+
+    /* These tests drive the plugin through the V-REP stand-in, just as a
+     * simulation would, and read back the files it writes. */
+
+    typedef std::vector<std::vector<std::string>> Table;
+
+    // The data files, in the order of their sensor IDs in the table of contents
+    const char *const DATA_FILES[] = {
+        "slam_gps.csv",
+        "slam_control.csv",
+        "slam_laser.csv",
+    };
+
+    /* One vehicle recording into a fresh temporary directory, which is
+     * deleted afterward.  Every call passes the vehicle's handle, so
+     * recordings may overlap. */
+    class Recording {
+    public:
+        /* The directory's name is the passed model, with each '%' replaced
+         * by a random hex digit. */
+        explicit Recording(const std::string &options,
+                           const std::string &model
+                               = "automobile-test-%%%%-%%%%");
+        ~Recording();
+        Recording(const Recording &) = delete;
+        Recording &operator=(const Recording &) = delete;
+
+        /* Initializes the vehicle again, in the same directory, which starts
+         * the recording over. */
+        void init(const std::string &options);
+
+        // The vehicle's handle
+        int vehicle() const;
+
+        // Asks for a realization of noise, with the passed seed.
+        void requestNoise(int seed);
+
+        void savePose(float time, float x, float y, float theta);
+        void saveControls(float time, float speed, float steeringAngle);
+        // Saves a scan of four beams on each side.
+        void saveLaser(float time);
+        // These save made-up values.
+        void savePose(float time);
+        void saveControls(float time);
+
+        void savePoseBatch(const std::vector<float> &times,
+                           const std::vector<float> &xs,
+                           const std::vector<float> &ys,
+                           const std::vector<float> &thetas);
+        void saveControlsBatch(const std::vector<float> &times,
+                               const std::vector<float> &speeds,
+                               const std::vector<float> &steeringAngles);
+
+        /* Saves a pose, controls, and the scan 'saveLaser' saves, all at
+         * once.  The call leaves out any of the scan's four tables past
+         * 'nTables'. */
+        void saveTick(float time, float x, float y, float theta,
+                      float speed, float steeringAngle,
+                      unsigned int nTables = 4);
+
+        // Writes out and closes every file.
+        void finish();
+
+        // The path to a file of the recording
+        std::string operator/(const std::string &) const;
+
+        const boost::filesystem::path &directory() const;
+
+    private:
+        /* The directories of every recording so far.  Finishing a recording
+         * finishes every vehicle, which writes its stats again, so the
+         * directories of recordings already gone come back. */
+        static std::vector<boost::filesystem::path> directories;
+
+        const boost::filesystem::path dir;
+        vrepStub::LuaCallBuilder builder;
+        const std::vector<float> beams;
+        int handle;
+    };
+
+    // Starts the plugin, the first time it is called.
+    void startPlugin();
+
+    // Reads a CSV file's rows, after the header, split into fields.
+    Table readCsv(const std::string &path);
+
+    // The whole of a file
+    std::string readFile(const boost::filesystem::path &);
+
+    /* Walks the table of contents of a data set alongside its data files:
+     * each entry must be the time of the next row of its sensor's file, and
+     * the entries must use up every file.  Returns the times in the table of
+     * contents. */
+    std::vector<float> walkInLockstep(const Recording &,
+                                      const std::string &dataSet);
+
+    /* Fails unless the two recordings wrote the same files, byte for byte,
+     * apart from their timings. */
+    void expectSameFiles(const Recording &, const Recording &);
+
+    /* The number of a few functions taking a vehicle's handle--SavePose,
+     * SaveControls, and GetStats--which reject the passed one */
+    unsigned int nRejecting(int handle);
+    const unsigned int N_HANDLE_CALLS = 3;
+
+    // The number of samples late_samples.csv reports for a data set
+    unsigned long long lateSamples(const Recording &,
+                                   const std::string &dataSet);
+
+
+    // Tests //
+
+    /* Samples too late to go in order still go in the table of contents,
+     * each alongside its row of data. */
+    void lateSamplesKeepTheirRows() {
+        Recording recording("lateness=1");
+        recording.requestNoise(7);
+        recording.savePose(1.0f);
+        recording.saveLaser(0.5f);
+        recording.saveControls(0.2f);
+        recording.savePose(3.0f);
+        recording.saveControls(0.1f);
+        recording.saveLaser(5.0f);
+        recording.saveControls(0.0f);
+        recording.finish();
+        const float expected[] = {0.2f, 0.5f, 1.0f, 0.1f, 3.0f, 0.0f, 5.0f};
+        const char *const dataSets[] = {"ground", "noisy"};
+        for (const char *const dataSet : dataSets) {
+            const std::vector<float> times =
+                walkInLockstep(recording, dataSet);
+            unitTest::expect(
+                times == std::vector<float>(
+                             expected,
+                             expected + sizeof expected / sizeof expected[0]),
+                std::string(dataSet) + "'s table of contents is out of "
+                "place");
+            const unsigned long long late = lateSamples(recording, dataSet);
+            unitTest::expect(late == 2,
+                             std::string(dataSet) + " has "
+                             + std::to_string(late) + " late samples, not 2");
+        }
+    }
+
+    /* Sensors which lag each other by less than the lateness are merged
+     * into time order, and every row keeps its entry. */
+    void laggingSensorsMerge() {
+        Recording recording("lateness=0.5");
+        std::mt19937 random(16);
+        std::uniform_int_distribution<int> sensor(0, 2);
+        // Each sensor saves every 10 ms, up to 0.4 s behind the others.
+        const float lag[] = {0, 0.4f, 0.2f};
+        unsigned int next[] = {0, 0, 0};
+        for (unsigned int i = 0; i < 3000; i++) {
+            const int s = sensor(random);
+            const float time = next[s]++ * 0.01f + lag[s];
+            if (s == 0) {
+                recording.savePose(time);
+            } else if (s == 1) {
+                recording.saveControls(time);
+            } else {
+                recording.saveLaser(time);
+            }
+        }
+        recording.finish();
+        const std::vector<float> times = walkInLockstep(recording, "ground");
+        unitTest::expect(times.size() == 3000,
+                         std::to_string(times.size()) + " samples");
+        unitTest::expect(std::is_sorted(times.begin(), times.end()),
+                         "the table of contents is out of order");
+        unitTest::expect(lateSamples(recording, "ground") == 0,
+                         "samples were counted late");
+    }
+
+    /* The options follow the directory whole, whatever characters the
+     * directory's name holds. */
+    void optionsFollowDirectory() {
+        Recording recording("index=time", "automobile-test-@-%%%%-%%%%");
+        recording.savePose(1.0f);
+        recording.finish();
+        const std::string gps = recording / "ground/slam_gps.csv";
+        unitTest::expect(readCsv(gps).size() == 1,
+                         "no pose in " + gps);
+        unitTest::expect(
+            boost::filesystem::exists(gps + ".idx"),
+            "the options were not read: no time index next to " + gps);
+    }
+
+    /* With laserStorage=uint16, properties.csv gives the scales the lidar
+     * values were stored with, exactly, whatever the precision; and the
+     * values stored come back within half a step of those saved as floats. */
+    void laserScalesInProperties() {
+        Recording plain("");
+        Recording quantized("laserStorage=uint16,precision=2");
+        for (unsigned int i = 0; i < 10; i++) {
+            plain.saveLaser(i * 0.1f);
+            quantized.saveLaser(i * 0.1f);
+        }
+        plain.finish();
+        quantized.finish();
+        const std::string plainProperties = readFile(plain / "properties.csv");
+        const std::string quantizedProperties =
+            readFile(quantized / "properties.csv");
+        unitTest::expect(
+            plainProperties.substr(0, plainProperties.find('\n'))
+            == "L,h,a,b,InitialAngle",
+            "properties.csv has scales without laserStorage=uint16");
+        unitTest::expect(
+            quantizedProperties.substr(0, quantizedProperties.find('\n'))
+            == "L,h,a,b,InitialAngle,LaserScale,IntensityScale",
+            "properties.csv has no scales with laserStorage=uint16");
+        // The recordings are initialized with maxima of 10 and 32768.
+        const Table properties = readCsv(quantized / "properties.csv");
+        unitTest::expect(properties.size() == 1
+                         && properties[0].size() == 7,
+                         "properties.csv is malformed");
+        const float distanceScale = std::stof(properties[0][5]);
+        const float intensityScale = std::stof(properties[0][6]);
+        unitTest::expect(distanceScale == lidar::Quantizer(10).scale()
+                         && intensityScale
+                            == lidar::Quantizer(32768).scale(),
+                         "the scales are " + properties[0][5] + " and "
+                         + properties[0][6]);
+        const Table floats = readCsv(plain / "ground/slam_laser.csv");
+        const Table stored = readCsv(quantized / "ground/slam_laser.csv");
+        unitTest::expect(floats.size() == stored.size(),
+                         "the recordings have different numbers of scans");
+        for (std::size_t row = 0; row < floats.size(); row++) {
+            const std::size_t nCols = floats[row].size();
+            unitTest::expect(stored[row].size() == nCols,
+                             "scan " + std::to_string(row)
+                             + " has a different number of columns");
+            // The time, then the distances, then as many intensities
+            for (std::size_t col = 1; col < nCols; col++) {
+                const float scale =
+                    col <= nCols / 2 ? distanceScale : intensityScale;
+                const float restored = lidar::dequantize(
+                    static_cast<std::uint16_t>(std::stoul(stored[row][col])),
+                    scale);
+                unitTest::expect(
+                    std::fabs(restored - std::stof(floats[row][col]))
+                    <= scale * 0.5f * (1 + 1e-6f),
+                    "column " + std::to_string(col) + " of scan "
+                    + std::to_string(row) + " came back as "
+                    + std::to_string(restored) + ", not "
+                    + floats[row][col]);
+            }
+        }
+    }
+
+    /* Every save a full queue throws away is counted, so the saves in the
+     * files and the count add up to all of them. */
+    void droppedSavesAreCounted() {
+        Recording recording("writer=async,queueDepth=1,queueFull=drop");
+        const unsigned long long nSaves = 2000;
+        for (unsigned long long i = 0; i < nSaves; i++) {
+            recording.saveLaser(i * 0.01f);
+        }
+        recording.finish();
+        const Table dropped = readCsv(recording / "dropped_saves.csv");
+        unitTest::expect(dropped.size() == 1 && dropped[0].size() == 2
+                         && dropped[0][0] == "1",
+                         "dropped_saves.csv is malformed");
+        const unsigned long long nDropped = std::stoull(dropped[0][1]);
+        const std::size_t nKept =
+            readCsv(recording / "ground/slam_laser.csv").size();
+        unitTest::expect(nKept + nDropped == nSaves,
+                         std::to_string(nKept) + " saves kept and "
+                         + std::to_string(nDropped) + " dropped, of "
+                         + std::to_string(nSaves));
+    }
+
+    // Options which change how data reach the files
+    const char *const WRITING_OPTIONS[] = {
+        "",
+        "writer=async",
+        "lateness=0.5",
+        "format=arrow",
+        "precision=3,index=time",
+    };
+
+    /* Batches of poses and controls are written exactly as the same data
+     * saved one at a time. */
+    void batchesMatchSingleSaves() {
+        std::vector<float> times, xs, ys, thetas, speeds, angles;
+        for (unsigned int i = 0; i < 500; i++) {
+            const float time = i * 0.05f;
+            times.push_back(time);
+            xs.push_back(std::cos(time) * 10);
+            ys.push_back(std::sin(time) * 10);
+            thetas.push_back(time + 1.5707964f);
+            speeds.push_back(1 + time / 10);
+            angles.push_back(-0.125f * time);
+        }
+        for (const char *const options : WRITING_OPTIONS) {
+            Recording single(options);
+            Recording batched(options);
+            single.requestNoise(10);
+            batched.requestNoise(10);
+            for (std::size_t i = 0; i < times.size(); i++) {
+                single.savePose(times[i], xs[i], ys[i], thetas[i]);
+            }
+            for (std::size_t i = 0; i < times.size(); i++) {
+                single.saveControls(times[i], speeds[i], angles[i]);
+            }
+            // Split the batches, so one ends where the next begins.
+            batched.savePoseBatch(
+                std::vector<float>(times.begin(), times.begin() + 200),
+                std::vector<float>(xs.begin(), xs.begin() + 200),
+                std::vector<float>(ys.begin(), ys.begin() + 200),
+                std::vector<float>(thetas.begin(), thetas.begin() + 200));
+            batched.savePoseBatch(
+                std::vector<float>(times.begin() + 200, times.end()),
+                std::vector<float>(xs.begin() + 200, xs.end()),
+                std::vector<float>(ys.begin() + 200, ys.end()),
+                std::vector<float>(thetas.begin() + 200, thetas.end()));
+            batched.saveControlsBatch(times, speeds, angles);
+            single.finish();
+            batched.finish();
+            expectSameFiles(single, batched);
+        }
+    }
+
+    /* A tick is written exactly as its pose, controls, and scan saved one
+     * after another at its time. */
+    void ticksMatchSingleSaves() {
+        for (const char *const options : WRITING_OPTIONS) {
+            Recording single(options);
+            Recording ticked(options);
+            single.requestNoise(11);
+            ticked.requestNoise(11);
+            for (unsigned int i = 0; i < 200; i++) {
+                const float time = i * 0.05f;
+                const float x = time * 2;
+                const float y = -time;
+                const float theta = time / 4;
+                const float speed = 1 + time;
+                const float angle = 0.5f - time / 8;
+                single.savePose(time, x, y, theta);
+                single.saveControls(time, speed, angle);
+                single.saveLaser(time);
+                ticked.saveTick(time, x, y, theta, speed, angle);
+            }
+            single.finish();
+            ticked.finish();
+            expectSameFiles(single, ticked);
+        }
+    }
+
+    /* Saves after a finish reopen the files and carry on, as though the
+     * recording had never stopped. */
+    void finishedRecordingsResume() {
+        for (const char *const options : WRITING_OPTIONS) {
+            /* A finish ends an Arrow file's record batch early, so its bytes
+             * differ though its rows do not. */
+            if (std::string(options) == "format=arrow") {
+                continue;
+            }
+            Recording resumed(options);
+            resumed.requestNoise(12);
+            for (unsigned int i = 0; i < 200; i++) {
+                const float time = i * 0.05f;
+                resumed.savePose(time, time, 2 * time, -time);
+                resumed.saveControls(time, 1 + time, time / 8);
+                resumed.saveLaser(time);
+                if (i % 80 == 79) {
+                    resumed.finish();
+                }
+            }
+            resumed.finish();
+            Recording whole(options);
+            whole.requestNoise(12);
+            for (unsigned int i = 0; i < 200; i++) {
+                const float time = i * 0.05f;
+                whole.savePose(time, time, 2 * time, -time);
+                whole.saveControls(time, 1 + time, time / 8);
+                whole.saveLaser(time);
+            }
+            whole.finish();
+            expectSameFiles(resumed, whole);
+        }
+    }
+
+    // A malformed tick records none of its step.
+    void badTickLeavesNothing() {
+        Recording recording("");
+        recording.saveTick(1, 2, 3, 4, 5, 6);
+        for (unsigned int nTables = 0; nTables < 4; nTables++) {
+            bool threw = false;
+            try {
+                recording.saveTick(2, 2, 3, 4, 5, 6, nTables);
+            } catch (const std::exception &) {
+                threw = true;
+            }
+            unitTest::expect(threw, "a tick with " + std::to_string(nTables)
+                             + " tables was taken");
+        }
+        recording.finish();
+        for (const char *const name : DATA_FILES) {
+            const std::size_t nRows =
+                readCsv(recording / (std::string("ground/") + name)).size();
+            unitTest::expect(nRows == 1,
+                             std::string(name) + " has "
+                             + std::to_string(nRows) + " rows, not 1");
+        }
+        const std::vector<float> times = walkInLockstep(recording, "ground");
+        unitTest::expect(times == std::vector<float>(3, 1.0f),
+                         "the table of contents holds more than the good "
+                         "tick");
+    }
+
+    // Vehicles recording at once keep to their own directories.
+    void vehiclesRecordApart() {
+        Recording first("");
+        Recording second("");
+        unitTest::expect(first.vehicle() != second.vehicle(),
+                         "two vehicles share handle "
+                         + std::to_string(first.vehicle()));
+        first.saveLaser(0);
+        second.saveLaser(0);
+        for (unsigned int i = 0; i < 5; i++) {
+            first.savePose(i, 1, 2, 0.5f);
+            second.saveControls(i, 3, 0.25f);
+            if (i < 2) {
+                second.savePose(i, 7, 8, 0);
+            }
+        }
+        first.finish();
+        second.finish();
+        const Table firstPoses = readCsv(first / "ground/slam_gps.csv");
+        const Table secondPoses = readCsv(second / "ground/slam_gps.csv");
+        unitTest::expect(firstPoses.size() == 5 && secondPoses.size() == 2,
+                         "the vehicles have "
+                         + std::to_string(firstPoses.size()) + " and "
+                         + std::to_string(secondPoses.size())
+                         + " poses, not 5 and 2");
+        // The columns are the time, y, x, and theta.
+        for (const std::vector<std::string> &row : firstPoses) {
+            unitTest::expect(row.size() == 4 && row[2] == "1",
+                             "the first vehicle has the second's pose");
+        }
+        for (const std::vector<std::string> &row : secondPoses) {
+            unitTest::expect(row.size() == 4 && row[2] == "7",
+                             "the second vehicle has the first's pose");
+        }
+        unitTest::expect(
+            readCsv(first / "ground/slam_control.csv").empty()
+            && readCsv(second / "ground/slam_control.csv").size() == 5,
+            "the controls went to the wrong vehicle");
+        unitTest::expect(walkInLockstep(first, "ground").size() == 6
+                         && walkInLockstep(second, "ground").size() == 8,
+                         "the tables of contents mix the vehicles");
+    }
+
+    /* Initializing a vehicle again in its directory starts its recording
+     * over under the same handle, and leaves the others alone. */
+    void initKeepsHandle() {
+        Recording first("");
+        Recording second("");
+        const int handle = first.vehicle();
+        first.savePose(1);
+        second.savePose(2);
+        first.init("precision=3");
+        unitTest::expect(first.vehicle() == handle,
+                         "the handle went from " + std::to_string(handle)
+                         + " to " + std::to_string(first.vehicle()));
+        first.savePose(3);
+        second.savePose(4);
+        const Recording third("");
+        unitTest::expect(third.vehicle() != first.vehicle()
+                         && third.vehicle() != second.vehicle(),
+                         "a new vehicle reuses a handle");
+        first.finish();
+        const Table firstPoses = readCsv(first / "ground/slam_gps.csv");
+        const Table secondPoses = readCsv(second / "ground/slam_gps.csv");
+        unitTest::expect(firstPoses.size() == 1
+                         && std::stof(firstPoses[0][0]) == 3,
+                         "the first vehicle didn't start over");
+        unitTest::expect(secondPoses.size() == 2 && secondPoses[0][0] == "2"
+                         && secondPoses[1][0] == "4",
+                         "the second vehicle lost its recording");
+    }
+
+    // Handles no vehicle has are errors.
+    void rejectsBadHandles() {
+        const Recording recording("");
+        const int bad[] = {0, -1, recording.vehicle() + 1, 1 << 30};
+        for (const int handle : bad) {
+            unitTest::expect(nRejecting(handle) == N_HANDLE_CALLS,
+                             "handle " + std::to_string(handle)
+                             + " accepted");
+        }
+        unitTest::expect(nRejecting(recording.vehicle()) == 0,
+                         "a good handle rejected");
+    }
+
+    const unitTest::Test TESTS[] = {
+        {"init/options", optionsFollowDirectory},
+        {"init/laserStorage", laserScalesInProperties},
+        {"recording/queueFull/drop", droppedSavesAreCounted},
+        {"recording/batch", batchesMatchSingleSaves},
+        {"recording/tick", ticksMatchSingleSaves},
+        {"recording/tick/bad", badTickLeavesNothing},
+        {"recording/resume", finishedRecordingsResume},
+        {"recording/lateness/late", lateSamplesKeepTheirRows},
+        {"recording/lateness/merge", laggingSensorsMerge},
+        {"vehicles/apart", vehiclesRecordApart},
+        {"vehicles/init", initKeepsHandle},
+        {"vehicles/badHandle", rejectsBadHandles},
+    };
+
+}
+
+namespace unitTest {
+
+    const Span<const Test> automobileTests(TESTS,
+                                           sizeof TESTS / sizeof TESTS[0]);
+
+}
+
+
+namespace {
+
+    void startPlugin() {
+        static bool started = false;
+        if (! started) {
+            if (v_repStart(nullptr, 0) == 0) {
+                throw std::runtime_error("could not start the plugin");
+            }
+            started = true;
+        }
+    }
+
+    Table readCsv(const std::string &path) {
+        std::ifstream file(path);
+        if (! file) {
+            throw std::runtime_error("could not open " + path);
+        }
+        Table result;
+        std::string line;
+        std::getline(file, line);
+        while (std::getline(file, line)) {
+            std::vector<std::string> fields;
+            std::string::size_type start = 0;
+            while (true) {
+                const std::string::size_type comma = line.find(',', start);
+                fields.push_back(line.substr(start, comma - start));
+                if (comma == std::string::npos) {
+                    break;
+                }
+                start = comma + 1;
+            }
+            result.push_back(fields);
+        }
+        return result;
+    }
+
+    std::vector<float> walkInLockstep(const Recording &recording,
+                                      const std::string &dataSet) {
+        const std::size_t nFiles = sizeof DATA_FILES / sizeof DATA_FILES[0];
+        std::vector<Table> files;
+        for (const char *const name : DATA_FILES) {
+            files.push_back(readCsv(recording / (dataSet + "/" + name)));
+        }
+        std::vector<std::size_t> nextRow(nFiles, 0);
+        std::vector<float> result;
+        const Table contents = readCsv(recording / (dataSet
+                                                    + "/slam_sensor.csv"));
+        for (const std::vector<std::string> &entry : contents) {
+            const std::string where =
+                dataSet + "'s entry " + std::to_string(result.size() + 1)
+                + " (" + entry[0] + "," + entry[1] + ")";
+            const std::size_t sensor = std::stoul(entry[1]);
+            unitTest::expect(1 <= sensor && sensor <= nFiles,
+                             where + " names no sensor");
+            std::size_t &row = nextRow[sensor - 1];
+            const Table &file = files[sensor - 1];
+            unitTest::expect(row < file.size(),
+                             where + " is past the end of "
+                             + DATA_FILES[sensor - 1]);
+            unitTest::expect(file[row][0] == entry[0],
+                             where + " is at " + file[row][0] + " in "
+                             + DATA_FILES[sensor - 1]);
+            row++;
+            result.push_back(std::stof(entry[0]));
+        }
+        for (std::size_t i = 0; i < nFiles; i++) {
+            unitTest::expect(nextRow[i] == files[i].size(),
+                             dataSet + "'s table of contents leaves out "
+                             + std::to_string(files[i].size() - nextRow[i])
+                             + " rows of " + DATA_FILES[i]);
+        }
+        return result;
+    }
+
+    std::string readFile(const boost::filesystem::path &path) {
+        std::ifstream file(path.string(), std::ios::in | std::ios::binary);
+        if (! file) {
+            throw std::runtime_error("could not open " + path.string());
+        }
+        return std::string(std::istreambuf_iterator<char>(file),
+                           std::istreambuf_iterator<char>());
+    }
+
+    // The files under a directory, relative to it, apart from the timings
+    std::vector<std::string> filesUnder(const boost::filesystem::path &dir) {
+        std::vector<std::string> result;
+        for (boost::filesystem::recursive_directory_iterator entry(dir), end;
+             entry != end; ++entry) {
+            const std::string name = entry->path().string();
+            if (boost::filesystem::is_regular_file(entry->path())
+                && entry->path().filename() != "stats.csv") {
+                result.push_back(name.substr(dir.string().size()));
+            }
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    void expectSameFiles(const Recording &a, const Recording &b) {
+        const std::vector<std::string> files = filesUnder(a.directory());
+        unitTest::expect(files == filesUnder(b.directory()),
+                         "the recordings wrote different files");
+        unitTest::expect(! files.empty(), "the recordings wrote nothing");
+        for (const std::string &file : files) {
+            unitTest::expect(
+                readFile(a.directory().string() + file)
+                    == readFile(b.directory().string() + file),
+                file + " differs");
+        }
+    }
+
+    unsigned int nRejecting(const int handle) {
+        vrepStub::LuaCallBuilder builder;
+        unsigned int result = 0;
+        for (unsigned int i = 0; i < N_HANDLE_CALLS; i++) {
+            builder.clear();
+            try {
+                if (i == 0) {
+                    builder.number(0).number(1).number(2).number(0.5f)
+                        .integer(handle);
+                    builder.call("simExtAutomobileSavePose");
+                } else if (i == 1) {
+                    builder.number(0).number(3).number(0.25f).integer(handle);
+                    builder.call("simExtAutomobileSaveControls");
+                } else {
+                    builder.integer(handle);
+                    builder.call("simExtAutomobileGetStats");
+                }
+            } catch (const std::invalid_argument &) {
+                result++;
+            }
+        }
+        return result;
+    }
+
+    unsigned long long lateSamples(const Recording &recording,
+                                   const std::string &dataSet) {
+        const Table late =
+            readCsv(recording / (dataSet + "/late_samples.csv"));
+        unitTest::expect(late.size() == 1 && late[0].size() == 2,
+                         dataSet + "'s late_samples.csv is malformed");
+        return std::stoull(late[0][1]);
+    }
+
+
+    // class Recording
+
+    std::vector<boost::filesystem::path> Recording::directories;
+
+    Recording::Recording(const std::string &options,
+                         const std::string &model)
+        : dir(boost::filesystem::temp_directory_path()
+              / boost::filesystem::unique_path(model)),
+          builder(), beams(4, 0.5f), handle(0) {
+        startPlugin();
+        directories.push_back(dir);
+        init(options);
+    }
+
+    Recording::~Recording() {
+        try {
+            finishRecording();
+        } catch (const std::exception &) {
+            // The test has failed already, or will.
+        }
+        for (const boost::filesystem::path &directory : directories) {
+            boost::filesystem::remove_all(directory);
+        }
+    }
+
+    void Recording::init(const std::string &options) {
+        builder.clear();
+        builder.string(dir.string()).number(1).number(0).number(0.5f)
+            .number(0).number(0).number(10).number(32768).string(options);
+        builder.call("simExtAutomobileInit");
+        handle = builder.get()->outputInt[0];
+    }
+
+    int Recording::vehicle() const {
+        return handle;
+    }
+
+    void Recording::requestNoise(const int seed) {
+        const std::vector<float> params(2, 0.1f);
+        builder.clear();
+        for (int i = 0; i < 6; i++) {
+            builder.numberTable(params);
+        }
+        builder.integer(seed).nil().integer(handle);
+        builder.call("simExtAutomobileRequestNoise");
+    }
+
+    void Recording::savePose(const float time, const float x, const float y,
+                             const float theta) {
+        builder.clear();
+        builder.number(time).number(x).number(y).number(theta);
+        builder.integer(handle);
+        builder.call("simExtAutomobileSavePose");
+    }
+
+    void Recording::saveControls(const float time, const float speed,
+                                 const float steeringAngle) {
+        builder.clear();
+        builder.number(time).number(speed).number(steeringAngle);
+        builder.integer(handle);
+        builder.call("simExtAutomobileSaveControls");
+    }
+
+    void Recording::savePose(const float time) {
+        savePose(time, 1, 2, 0.5f);
+    }
+
+    void Recording::saveControls(const float time) {
+        saveControls(time, 3, 0.25f);
+    }
+
+    void Recording::savePoseBatch(const std::vector<float> &times,
+                                  const std::vector<float> &xs,
+                                  const std::vector<float> &ys,
+                                  const std::vector<float> &thetas) {
+        builder.clear();
+        builder.numberTable(times).numberTable(xs).numberTable(ys)
+            .numberTable(thetas);
+        builder.integer(handle);
+        builder.call("simExtAutomobileSavePoseBatch");
+    }
+
+    void Recording::saveControlsBatch(
+        const std::vector<float> &times, const std::vector<float> &speeds,
+        const std::vector<float> &steeringAngles) {
+        builder.clear();
+        builder.numberTable(times).numberTable(speeds)
+            .numberTable(steeringAngles);
+        builder.integer(handle);
+        builder.call("simExtAutomobileSaveControlsBatch");
+    }
+
+    void Recording::saveTick(const float time, const float x, const float y,
+                             const float theta, const float speed,
+                             const float steeringAngle,
+                             const unsigned int nTables) {
+        builder.clear();
+        builder.number(time).number(x).number(y).number(theta).number(speed)
+            .number(steeringAngle);
+        for (unsigned int i = 0; i < nTables; i++) {
+            builder.numberTable(beams);
+        }
+        builder.integer(handle);
+        builder.call("simExtAutomobileSaveTick");
+    }
+
+    void Recording::saveLaser(const float time) {
+        builder.clear();
+        builder.number(time).numberTable(beams).numberTable(beams)
+            .numberTable(beams).numberTable(beams);
+        builder.integer(handle);
+        builder.call("simExtAutomobileSaveLaserPair");
+    }
+
+    void Recording::finish() {
+        finishRecording();
+    }
+
+    std::string Recording::operator/(const std::string &name) const {
+        return (dir / name).string();
+    }
+
+    const boost::filesystem::path &Recording::directory() const {
+        return dir;
+    }
+
+}
@@ -0,0 +1,516 @@
+/* benchmark.cpp -- microbenchmarks for the plugin's hot path
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+/* Each case times one stage of recording a datum, from unpacking the Lua call
+ * to writing the file, and is run in batches of growing size until a batch
+ * takes at least half a second.  The results go to standard output as CSV,
+ * one row per case:
+ *
+ *   - Benchmark: the name of the case;
+ *   - Version: the version of the plugin;
+ *   - Iterations: the size of the last batch;
+ *   - NsPerOp: the wall-clock time of one iteration, in nanoseconds;
+ *   - BytesPerSecond: the rate at which the case goes through data--the text
+ *     it formats, or the floats it draws, adds noise to or unpacks;
+ *   - AllocsPerOp: calls to operator new per iteration, counting any by
+ *     background threads while the case runs;
+ *   - P99Ns: for cases which time each iteration separately, the 99th
+ *     percentile of those times, in nanoseconds (see latency.h); empty for
+ *     the rest.
+ *
+ * Pass names of cases (or prefixes of them) to run only those cases.  The
+ * program is linked against the V-REP stand-in (see vrepStub.h), so the
+ * end-to-end cases call the registered Lua functions just as V-REP would.
+ *
+ * The "saveLaser/.../io=" cases compare the output backends (see sink.h).
+ * Their batches include closing the files, so every byte has been handed to
+ * the kernel by the time the clock stops, and they count the bytes that
+ * reach the files: BytesPerSecond is the rate the backend sustains, and
+ * P99Ns is what a simulation step would wait on it. */
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <v_repLib.h>
+
+#include "allocationCount.h"
+#include "automobile.h"
+#include "csv.h"
+#include "main.h"
+#include "measurement.h"
+#include "latency.h"
+#include "noise.h"
+#include "sampler.h"
+#include "sink.h"
+#include "span.h"
+#include "vrepFfi.h"
+#include "vrepStub.h"
+
+
+namespace {
+
+    // The least time a case's last batch may take
+    const double MIN_SECONDS = 0.5;
+
+    // The largest batch run, however fast the case
+    const unsigned long long MAX_ITERATIONS = 1000000000;
+
+    // Results are stored here so the compiler cannot optimize the work away.
+    volatile std::size_t blackHole;
+
+
+    // Batches //
+
+    /* One run of a case.  The case does its setup, calls 'start', runs 'size'
+     * iterations, and calls 'stop' before it tears down, so only the
+     * iterations are timed. */
+    class Batch {
+    public:
+        explicit Batch(unsigned long long size);
+
+        unsigned long long size() const;
+
+        void start();
+        void stop();
+
+        // Counts data gone through by the iterations.
+        void addBytes(unsigned long long);
+
+        double seconds() const;
+        unsigned long long bytes() const;
+        unsigned long long allocations() const;
+
+        // The times of single iterations, for cases which record them
+        latency::Histogram &iterationTimes();
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        const unsigned long long size_;
+        Clock::time_point startTime;
+        Clock::duration elapsed;
+        unsigned long long startAllocations;
+        unsigned long long allocations_;
+        unsigned long long bytes_;
+        latency::Histogram iterationTimes_;
+    };
+
+    struct Case {
+        const char *name;
+        void (*run)(Batch &);
+    };
+
+
+    // Prototypes //
+
+    // Data which look like what V-REP passes for an n-beam scan
+    std::vector<float> distances(std::size_t n);
+    std::vector<float> intensities(std::size_t n);
+
+    // Runs batches of a case until one is long enough, and prints the result.
+    void measure(const Case &);
+
+    // Whether the case was asked for on the command line
+    bool isSelected(const Case &, int argc, char *argv[]);
+
+    /* Creates an output directory for the end-to-end cases, recording with
+     * the passed options (see options.h). */
+    boost::filesystem::path startRecording(const std::string &options = "");
+    // Closes the output files and deletes the directory.
+    void stopRecording(const boost::filesystem::path &);
+    // The total size of the files under a directory
+    unsigned long long directorySize(const boost::filesystem::path &);
+
+
+    // Cases //
+
+    template<std::size_t N>
+    void fromContainer(Batch &batch) {
+        const std::vector<float> row = distances(N);
+        batch.start();
+        for (unsigned long long i = 0; i < batch.size(); i++) {
+            const std::string line = csv::fromContainer(row);
+            batch.addBytes(line.size());
+            blackHole = line.size();
+        }
+        batch.stop();
+    }
+
+    template<std::size_t N>
+    void lidarCsv(Batch &batch) {
+        const LidarDatum datum(1.5f, distances(N), intensities(N));
+        std::string line;
+        batch.start();
+        for (unsigned long long i = 0; i < batch.size(); i++) {
+            line.clear();
+            csv::Row row(line, csv::FloatFormat::shortest());
+            csv::Schema<LidarDatum>::write(row, datum);
+            batch.addBytes(line.size());
+        }
+        batch.stop();
+        blackHole = line.size();
+    }
+
+    void addPoseNoise(Batch &batch) {
+        GaussianNoiseSource position(0, 0.1f, 1, 0);
+        GaussianNoiseSource angle(0, 0.01f, 1, 1);
+        const Pose pose(1.5f, 3, 4, 0.5f);
+        batch.start();
+        for (unsigned long long i = 0; i < batch.size(); i++) {
+            const Pose noisy = addNoise(pose, position, angle);
+            batch.addBytes(3 * sizeof(float));
+            blackHole = noisy.x != 0;
+        }
+        batch.stop();
+    }
+
+    void addControlNoise(Batch &batch) {
+        GaussianNoiseSource speed(0, 0.1f, 1, 2);
+        GaussianNoiseSource steeringAngle(0, 0.01f, 1, 3);
+        const ControlSignals signals(1.5f, 2, 0.25f);
+        batch.start();
+        for (unsigned long long i = 0; i < batch.size(); i++) {
+            const ControlSignals noisy = addNoise(signals, speed,
+                                                  steeringAngle);
+            batch.addBytes(2 * sizeof(float));
+            blackHole = noisy.speed != 0;
+        }
+        batch.stop();
+    }
+
+    template<std::size_t N>
+    void addLidarNoise(Batch &batch) {
+        GaussianNoiseSource distance(0, 0.1f, 1, 4);
+        GaussianNoiseSource intensity(0, 100, 1, 5);
+        const LidarDatum datum(1.5f, distances(N), intensities(N));
+        batch.start();
+        for (unsigned long long i = 0; i < batch.size(); i++) {
+            const LidarDatum noisy = addNoise(datum, distance, intensity);
+            batch.addBytes(2 * N * sizeof(float));
+            blackHole = noisy.distance.size();
+        }
+        batch.stop();
+    }
+
+    template<std::size_t N>
+    void normalSampler(Batch &batch) {
+        NormalSampler sampler(1, 6);
+        std::vector<float> samples(N);
+        batch.start();
+        for (unsigned long long i = 0; i < batch.size(); i++) {
+            sampler.fill(samples);
+            batch.addBytes(N * sizeof(float));
+        }
+        batch.stop();
+        blackHole = samples[N - 1] != 0;
+    }
+
+    // The generator the noise sources used before NormalSampler, for scale
+    template<std::size_t N>
+    void normalDistribution(Batch &batch) {
+        std::mt19937 generator(1);
+        std::normal_distribution<float> distribution(0, 1);
+        std::vector<float> samples(N);
+        batch.start();
+        for (unsigned long long i = 0; i < batch.size(); i++) {
+            for (float &x : samples) {
+                x = distribution(generator);
+            }
+            batch.addBytes(N * sizeof(float));
+        }
+        batch.stop();
+        blackHole = samples[N - 1] != 0;
+    }
+
+    template<std::size_t N>
+    void expectTable(Batch &batch) {
+        vrepStub::LuaCallBuilder builder;
+        builder.numberTable(distances(N));
+        SLuaCallBack *const simCall = builder.get();
+        batch.start();
+        for (unsigned long long i = 0; i < batch.size(); i++) {
+            vrep::LuaCall call(simCall);
+            const std::vector<float> table = call.expectTable<float>();
+            batch.addBytes(N * sizeof(float));
+            blackHole = table.size();
+        }
+        batch.stop();
+    }
+
+    template<std::size_t N>
+    void viewTable(Batch &batch) {
+        vrepStub::LuaCallBuilder builder;
+        builder.numberTable(distances(N));
+        SLuaCallBack *const simCall = builder.get();
+        batch.start();
+        for (unsigned long long i = 0; i < batch.size(); i++) {
+            vrep::LuaCall call(simCall);
+            const Span<const float> table = call.viewTable<float>();
+            batch.addBytes(N * sizeof(float));
+            blackHole = table.size();
+        }
+        batch.stop();
+    }
+
+    // N beams in all, half from each sensor
+    template<std::size_t N>
+    void saveLaser(Batch &batch) {
+        const boost::filesystem::path dataDir = startRecording();
+        const std::vector<float> depth = distances(N / 2);
+        const std::vector<float> image = intensities(N / 2);
+        vrepStub::LuaCallBuilder builder;
+        builder.number(1.5f).numberTable(depth).numberTable(depth)
+            .numberTable(image).numberTable(image);
+        SLuaCallBack *const simCall = builder.get();
+        batch.start();
+        for (unsigned long long i = 0; i < batch.size(); i++) {
+            vrepStub::call("simExtAutomobileSaveLaserPair", simCall);
+            batch.addBytes(2 * N * sizeof(float));
+        }
+        batch.stop();
+        stopRecording(dataDir);
+    }
+
+    // N beams in all, half from each sensor, written through a backend
+    template<std::size_t N, output::Backend B>
+    void saveLaserThrough(Batch &batch) {
+        const boost::filesystem::path dataDir =
+            startRecording(std::string("io=") + output::name(B));
+        const std::vector<float> depth = distances(N / 2);
+        const std::vector<float> image = intensities(N / 2);
+        vrepStub::LuaCallBuilder builder;
+        builder.number(1.5f).numberTable(depth).numberTable(depth)
+            .numberTable(image).numberTable(image);
+        SLuaCallBack *const simCall = builder.get();
+        latency::Histogram &iterationTimes = batch.iterationTimes();
+        batch.start();
+        for (unsigned long long i = 0; i < batch.size(); i++) {
+            latency::Timer timer(iterationTimes);
+            vrepStub::call("simExtAutomobileSaveLaserPair", simCall);
+        }
+        finishRecording();
+        batch.stop();
+        batch.addBytes(directorySize(dataDir));
+        boost::filesystem::remove_all(dataDir);
+    }
+
+    const Case CASES[] = {
+        {"csv::fromContainer/1024", fromContainer<1024>},
+        {"csv::Schema<LidarDatum>/1024", lidarCsv<1024>},
+        {"csv::Schema<LidarDatum>/8192", lidarCsv<8192>},
+        {"addNoise/Pose", addPoseNoise},
+        {"addNoise/ControlSignals", addControlNoise},
+        {"addNoise/LidarDatum/1024", addLidarNoise<1024>},
+        {"NormalSampler::fill/1024", normalSampler<1024>},
+        {"std::normal_distribution/1024", normalDistribution<1024>},
+        {"LuaCall::expectTable/1024", expectTable<1024>},
+        {"LuaCall::expectTable/10240", expectTable<10240>},
+        {"LuaCall::viewTable/10240", viewTable<10240>},
+        {"saveLaser/1024", saveLaser<1024>},
+        {"saveLaser/8192", saveLaser<8192>},
+        {"saveLaser/1024/io=buffered",
+         saveLaserThrough<1024, output::Backend::BUFFERED>},
+        {"saveLaser/1024/io=mmap",
+         saveLaserThrough<1024, output::Backend::MMAP>},
+        {"saveLaser/1024/io=uring",
+         saveLaserThrough<1024, output::Backend::URING>},
+    };
+
+}
+
+
+int main(int argc, char *argv[]) {
+    try {
+        std::vector<const Case *> selected;
+        for (const Case &benchmark : CASES) {
+            if (isSelected(benchmark, argc, argv)) {
+                selected.push_back(&benchmark);
+            }
+        }
+        if (selected.empty()) {
+            throw std::invalid_argument("no benchmark matches the arguments");
+        }
+        if (v_repStart(nullptr, 0) == 0) {
+            throw std::runtime_error("could not start the plugin");
+        }
+        std::printf("Benchmark,Version,Iterations,NsPerOp,BytesPerSecond,"
+                    "AllocsPerOp,P99Ns\n");
+        for (const Case *const benchmark : selected) {
+            measure(*benchmark);
+        }
+        v_repEnd();
+        return EXIT_SUCCESS;
+    } catch (const std::exception &error) {
+        std::fprintf(stderr, "%s: %s\n", argv[0], error.what());
+        return EXIT_FAILURE;
+    }
+}
+
+
+namespace {
+
+    std::vector<float> distances(const std::size_t n) {
+        /* V-REP passes depths as fractions of the sensor's range, which
+         * rarely print short. */
+        std::vector<float> result(n);
+        for (std::size_t i = 0; i < n; i++) {
+            result[i] = 0.1f + 0.8f * (i % 97) / 97;
+        }
+        return result;
+    }
+
+    std::vector<float> intensities(const std::size_t n) {
+        std::vector<float> result(n);
+        for (std::size_t i = 0; i < n; i++) {
+            result[i] = (i % 89) / 89.0f;
+        }
+        return result;
+    }
+
+    void measure(const Case &benchmark) {
+        unsigned long long size = 1;
+        while (true) {
+            Batch batch(size);
+            benchmark.run(batch);
+            const double seconds = batch.seconds();
+            if (seconds >= MIN_SECONDS || size >= MAX_ITERATIONS) {
+                std::printf("%s,%s,%llu,%.1f,%.0f,%.2f,", benchmark.name,
+                            PACKAGE_VERSION, size, 1e9 * seconds / size,
+                            seconds > 0 ? batch.bytes() / seconds : 0.0,
+                            static_cast<double>(batch.allocations()) / size);
+                const latency::Histogram &times = batch.iterationTimes();
+                if (times.count() > 0) {
+                    std::printf("%llu", static_cast<unsigned long long>(
+                                            times.percentile(0.99)));
+                }
+                std::printf("\n");
+                std::fflush(stdout);
+                return;
+            }
+            /* Aim a fifth past the minimum, but grow at most a hundredfold,
+             * in case this batch was too short to time well. */
+            unsigned long long next = size * 100;
+            if (seconds > 0) {
+                next = std::min(next, static_cast<unsigned long long>(
+                                          1.2 * MIN_SECONDS * size / seconds));
+            }
+            size = std::min(std::max(next, size + 1), MAX_ITERATIONS);
+        }
+    }
+
+    bool isSelected(const Case &benchmark, const int argc, char *argv[]) {
+        if (argc <= 1) {
+            return true;
+        }
+        const std::string name = benchmark.name;
+        for (int i = 1; i < argc; i++) {
+            if (name.compare(0, std::strlen(argv[i]), argv[i]) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    boost::filesystem::path startRecording(const std::string &options) {
+        const boost::filesystem::path dataDir =
+            boost::filesystem::temp_directory_path()
+            / boost::filesystem::unique_path("automobile-bench-%%%%-%%%%");
+        vrepStub::LuaCallBuilder builder;
+        builder.string(dataDir.string()).number(1).number(0).number(0.5f)
+            .number(0).number(0).number(10).number(32768).string(options);
+        builder.call("simExtAutomobileInit");
+        return dataDir;
+    }
+
+    void stopRecording(const boost::filesystem::path &dataDir) {
+        finishRecording();
+        boost::filesystem::remove_all(dataDir);
+    }
+
+    unsigned long long directorySize(const boost::filesystem::path &dir) {
+        unsigned long long result = 0;
+        for (boost::filesystem::recursive_directory_iterator entry(dir), end;
+             entry != end; ++entry) {
+            if (boost::filesystem::is_regular_file(entry->status())) {
+                result += boost::filesystem::file_size(entry->path());
+            }
+        }
+        return result;
+    }
+
+
+    // class Batch
+
+    Batch::Batch(const unsigned long long size)
+        : size_(size), startTime(), elapsed(Clock::duration::zero()),
+          startAllocations(0), allocations_(0), bytes_(0),
+          iterationTimes_() {
+    }
+
+    unsigned long long Batch::size() const {
+        return size_;
+    }
+
+    void Batch::start() {
+        startAllocations = allocationCount();
+        startTime = Clock::now();
+    }
+
+    void Batch::stop() {
+        elapsed = Clock::now() - startTime;
+        allocations_ = allocationCount() - startAllocations;
+    }
+
+    void Batch::addBytes(const unsigned long long n) {
+        bytes_ += n;
+    }
+
+    double Batch::seconds() const {
+        return std::chrono::duration<double>(elapsed).count();
+    }
+
+    unsigned long long Batch::bytes() const {
+        return bytes_;
+    }
+
+    unsigned long long Batch::allocations() const {
+        return allocations_;
+    }
+
+    latency::Histogram &Batch::iterationTimes() {
+        return iterationTimes_;
+    }
+
+}
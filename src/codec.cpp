@@ -0,0 +1,188 @@
+/* codec.cpp -- block compression for output files
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cstddef>
+
+#include <string>
+
+#if defined(HAVE_ZSTD)
+#   include <zstd.h>
+#elif defined(HAVE_ZLIB)
+#   include <zlib.h>
+#endif
+
+#include "codec.h"
+#include "span.h"
+
+namespace codec {
+
+    namespace {
+
+#       if defined(HAVE_ZSTD)
+            /* zstd's default.  Higher levels barely shrink lidar data and
+             * cost several times as much. */
+            const int LEVEL = 3;
+#       elif defined(HAVE_ZLIB)
+            const int LEVEL = Z_DEFAULT_COMPRESSION;
+            // Window size, plus 16 to ask for a gzip wrapper
+            const int GZIP_WINDOW_BITS = 15 + 16;
+            const int MEMORY_LEVEL = 8;
+#       endif
+
+    }
+
+    bool available() {
+#       if defined(HAVE_ZSTD) || defined(HAVE_ZLIB)
+            return true;
+#       else
+            return false;
+#       endif
+    }
+
+    const std::string &codecName() {
+#       if defined(HAVE_ZSTD)
+            static const std::string result = "zstd";
+#       elif defined(HAVE_ZLIB)
+            static const std::string result = "zlib";
+#       else
+            static const std::string result = "none";
+#       endif
+        return result;
+    }
+
+    const std::string &extension() {
+#       if defined(HAVE_ZSTD)
+            static const std::string result = ".zst";
+#       elif defined(HAVE_ZLIB)
+            static const std::string result = ".gz";
+#       else
+            static const std::string result = "";
+#       endif
+        return result;
+    }
+
+#   if defined(HAVE_ZSTD)
+
+        void compressBlock(const Span<const char> block, std::string &out) {
+            out.resize(ZSTD_compressBound(block.size()));
+            const std::size_t size = ZSTD_compress(&out[0], out.size(),
+                                                   block.data(), block.size(),
+                                                   LEVEL);
+            if (ZSTD_isError(size)) {
+                throw CompressionError(std::string("zstd: ")
+                                       + ZSTD_getErrorName(size));
+            }
+            out.resize(size);
+        }
+
+        void decompressBlock(const Span<const char> block,
+                             const std::size_t size, std::string &out) {
+            out.resize(size);
+            const std::size_t actual = ZSTD_decompress(&out[0], out.size(),
+                                                       block.data(),
+                                                       block.size());
+            if (ZSTD_isError(actual)) {
+                throw CompressionError(std::string("zstd: ")
+                                       + ZSTD_getErrorName(actual));
+            }
+            if (actual != size) {
+                throw CompressionError("zstd: block has the wrong size");
+            }
+        }
+
+#   elif defined(HAVE_ZLIB)
+
+        namespace {
+
+            // Throws unless a zlib call succeeded.
+            void check(const z_stream &stream, const int status) {
+                if (status != Z_OK && status != Z_STREAM_END) {
+                    throw CompressionError(
+                        std::string("zlib: ")
+                        + (stream.msg ? stream.msg : zError(status)));
+                }
+            }
+
+        }
+
+        void compressBlock(const Span<const char> block, std::string &out) {
+            z_stream stream = z_stream();
+            check(stream, deflateInit2(&stream, LEVEL, Z_DEFLATED,
+                                       GZIP_WINDOW_BITS, MEMORY_LEVEL,
+                                       Z_DEFAULT_STRATEGY));
+            out.resize(deflateBound(&stream, block.size()));
+            // zlib's interface predates const.
+            stream.next_in = reinterpret_cast<Bytef *>(
+                const_cast<char *>(block.data()));
+            stream.avail_in = block.size();
+            stream.next_out = reinterpret_cast<Bytef *>(&out[0]);
+            stream.avail_out = out.size();
+            const int status = deflate(&stream, Z_FINISH);
+            deflateEnd(&stream);
+            if (status != Z_STREAM_END) {
+                check(stream, status == Z_OK ? Z_BUF_ERROR : status);
+            }
+            out.resize(stream.total_out);
+        }
+
+        void decompressBlock(const Span<const char> block,
+                             const std::size_t size, std::string &out) {
+            out.resize(size);
+            z_stream stream = z_stream();
+            check(stream, inflateInit2(&stream, GZIP_WINDOW_BITS));
+            stream.next_in = reinterpret_cast<Bytef *>(
+                const_cast<char *>(block.data()));
+            stream.avail_in = block.size();
+            stream.next_out = reinterpret_cast<Bytef *>(&out[0]);
+            stream.avail_out = out.size();
+            const int status = inflate(&stream, Z_FINISH);
+            inflateEnd(&stream);
+            if (status != Z_STREAM_END) {
+                check(stream, status == Z_OK ? Z_BUF_ERROR : status);
+            }
+            if (stream.total_out != size) {
+                throw CompressionError("zlib: block has the wrong size");
+            }
+        }
+
+#   else
+
+        void compressBlock(Span<const char>, std::string &) {
+            throw CompressionError("the plugin was built without compression");
+        }
+
+        void decompressBlock(Span<const char>, std::size_t, std::string &) {
+            throw CompressionError("the plugin was built without compression");
+        }
+
+#   endif
+
+
+    // Error handling //
+
+    CompressionError::CompressionError(const std::string &whatArg)
+        : std::runtime_error(whatArg) {
+    }
+
+}
@@ -0,0 +1,69 @@
+/* codec.h -- block compression for output files
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifndef PPAML_VREP_AUTOMOBILE_PLUGIN_CODEC_H
+#define PPAML_VREP_AUTOMOBILE_PLUGIN_CODEC_H
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cstddef>
+
+#include <stdexcept>
+#include <string>
+
+#include "span.h"
+
+/* The codec is picked when the plugin is configured: zstd if HAVE_ZSTD, zlib
+ * if HAVE_ZLIB, and none at all otherwise.  Every block is compressed into a
+ * self-contained frame (a zstd frame or a gzip member), so a file made of
+ * blocks is a valid .zst or .gz file that the usual tools can decompress, and
+ * each block can also be decompressed on its own. */
+namespace codec {
+
+    // Whether the plugin was built with a codec
+    bool available();
+
+    // The name of the codec ("zstd", "zlib", or "none")
+    const std::string &codecName();
+
+    // The file name extension for compressed files, including the dot
+    const std::string &extension();
+
+    // Compresses a block, replacing the contents of 'out'.
+    void compressBlock(Span<const char>, std::string &out);
+
+    /* Decompresses a block which is known to hold 'size' bytes, replacing the
+     * contents of 'out'. */
+    void decompressBlock(Span<const char>, std::size_t size, std::string &out);
+
+
+    // Error handling //
+
+    // An error signaling that the codec failed or is not available.
+    class CompressionError : public std::runtime_error {
+    public:
+        explicit CompressionError(const std::string &whatArg);
+    };
+
+}
+
+#endif
@@ -0,0 +1,52 @@
+/* cpu.cpp -- instruction sets available at run time
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include "cpu.h"
+
+namespace cpu {
+
+    Isa bestIsa() {
+#       ifdef HAVE_X86_SIMD_DISPATCH
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2")) {
+                return Isa::AVX2;
+            } else if (__builtin_cpu_supports("sse2")) {
+                return Isa::SSE2;
+            }
+#       endif
+        return Isa::SCALAR;
+    }
+
+    const char *name(const Isa isa) {
+        switch (isa) {
+        case Isa::AVX2:
+            return "avx2";
+        case Isa::SSE2:
+            return "sse2";
+        default:
+            return "scalar";
+        }
+    }
+
+}
@@ -0,0 +1,46 @@
+/* cpu.h -- instruction sets available at run time
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifndef PPAML_VREP_AUTOMOBILE_PLUGIN_CPU_H
+#define PPAML_VREP_AUTOMOBILE_PLUGIN_CPU_H
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+namespace cpu {
+
+    /* The instruction sets kernels can be built for.  Only the scalar
+     * versions are built unless configure found HAVE_X86_SIMD_DISPATCH. */
+    enum class Isa {
+        SCALAR,
+        SSE2,
+        AVX2
+    };
+
+    // The best instruction set the running processor supports
+    Isa bestIsa();
+
+    // A name for an instruction set ("scalar", "sse2", or "avx2")
+    const char *name(Isa);
+
+}
+
+#endif
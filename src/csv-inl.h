@@ -23,6 +23,91 @@
 
 namespace csv {
 
+    // class FloatFormat
+
+    FloatFormat FloatFormat::shortest() {
+        return FloatFormat(-1);
+    }
+
+    FloatFormat FloatFormat::fixed(const unsigned int decimals) {
+        return FloatFormat(decimals < MAX_DECIMALS ? decimals : MAX_DECIMALS);
+    }
+
+    FloatFormat::FloatFormat(const int decimals)
+        : decimals_(decimals) {
+    }
+
+    bool FloatFormat::isShortest() const {
+        return decimals_ < 0;
+    }
+
+    unsigned int FloatFormat::decimals() const {
+        return decimals_ < 0 ? 0 : decimals_;
+    }
+
+
+    // class Row
+
+    Row::Row(std::string &line, const FloatFormat format)
+        : line(line), format(format), first(true) {
+    }
+
+    void Row::put(const float value) {
+        put(value, format);
+    }
+
+    void Row::put(const float value, const FloatFormat valueFormat) {
+        separate();
+        char buffer[MAX_FLOAT_CHARS];
+        line.append(buffer, formatFloat(value, valueFormat, buffer));
+    }
+
+    void Row::put(const unsigned int value) {
+        put(static_cast<unsigned long long>(value));
+    }
+
+    void Row::put(unsigned long long value) {
+        separate();
+        char buffer[24];
+        char *start = buffer + sizeof buffer;
+        do {
+            *--start = '0' + value % 10;
+            value /= 10;
+        } while (value);
+        line.append(start, buffer + sizeof buffer);
+    }
+
+    void Row::put(const std::string &value) {
+        separate();
+        line.append(value);
+    }
+
+    void Row::separate() {
+        if (first) {
+            first = false;
+        } else {
+            line.push_back(',');
+        }
+    }
+
+
+    // struct FixedSchema
+
+    template<typename T, unsigned int N>
+    const unsigned int FixedSchema<T, N>::N_COLS;
+
+    template<typename T, unsigned int N>
+    unsigned int FixedSchema<T, N>::nCols(const T &) {
+        return N;
+    }
+
+    template<typename T, unsigned int N>
+    const std::string &FixedSchema<T, N>::header(const T &) {
+        static const std::string result = joinColumns(Schema<T>::COLUMNS, N);
+        return result;
+    }
+
+
     template<typename SequenceContainer>
     std::string fromContainer(const SequenceContainer &columns) {
         std::ostringstream line;
@@ -22,6 +22,12 @@
 #   include <config.h>
 #endif
 
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <string>
+
 #ifndef HAVE_CXX11_INITIALIZER_LISTS
 #   include <cstdarg>
 #   include <list>
@@ -30,6 +36,444 @@
 
 #include "csv.h"
 
+namespace csv {
+
+    namespace {
+
+        /* Printing floats exactly
+         *
+         * Floats are converted to decimal with the free-format algorithm of
+         * Burger and Dybvig ("Printing Floating-Point Numbers Quickly and
+         * Accurately," PLDI 1996), which works on exact integers.  Every
+         * float that shows up in practice fits in 64-bit arithmetic; the rest
+         * (below about 1e-10 or above about 1e9) go through 'BigInt'. */
+
+        // Just enough arbitrary-precision arithmetic for the extreme floats
+        class BigInt {
+        public:
+            explicit BigInt(const std::uint64_t value)
+                : nWords(0) {
+                while (nWords < 2 && value >> (32 * nWords)) {
+                    words[nWords] = static_cast<std::uint32_t>(
+                        value >> (32 * nWords));
+                    nWords++;
+                }
+            }
+
+            BigInt &operator*=(const std::uint32_t factor) {
+                std::uint64_t carry = 0;
+                for (unsigned int i = 0; i < nWords; i++) {
+                    carry += static_cast<std::uint64_t>(words[i]) * factor;
+                    words[i] = static_cast<std::uint32_t>(carry);
+                    carry >>= 32;
+                }
+                if (carry) {
+                    words[nWords++] = static_cast<std::uint32_t>(carry);
+                }
+                return *this;
+            }
+
+            BigInt &operator<<=(unsigned int bits) {
+                for (; bits >= 16; bits -= 16) {
+                    *this *= 1 << 16;
+                }
+                return *this *= 1 << bits;
+            }
+
+            BigInt &operator+=(const BigInt &other) {
+                std::uint64_t carry = 0;
+                for (unsigned int i = 0; i < other.nWords || carry; i++) {
+                    if (i == nWords) {
+                        words[nWords++] = 0;
+                    }
+                    carry += words[i];
+                    if (i < other.nWords) {
+                        carry += other.words[i];
+                    }
+                    words[i] = static_cast<std::uint32_t>(carry);
+                    carry >>= 32;
+                }
+                return *this;
+            }
+
+            // Requires *this >= other.
+            BigInt &operator-=(const BigInt &other) {
+                std::int64_t borrow = 0;
+                for (unsigned int i = 0; i < nWords; i++) {
+                    borrow += words[i];
+                    if (i < other.nWords) {
+                        borrow -= other.words[i];
+                    }
+                    words[i] = static_cast<std::uint32_t>(borrow);
+                    borrow = borrow < 0 ? -1 : 0;
+                }
+                while (nWords && ! words[nWords - 1]) {
+                    nWords--;
+                }
+                return *this;
+            }
+
+            friend int compare(const BigInt &a, const BigInt &b) {
+                if (a.nWords != b.nWords) {
+                    return a.nWords < b.nWords ? -1 : 1;
+                }
+                for (unsigned int i = a.nWords; i-- > 0;) {
+                    if (a.words[i] != b.words[i]) {
+                        return a.words[i] < b.words[i] ? -1 : 1;
+                    }
+                }
+                return 0;
+            }
+
+        private:
+            // Every quantity that comes up is below 2^160.
+            std::uint32_t words[6];
+            unsigned int nWords;
+        };
+
+        inline int compare(const std::uint64_t a, const std::uint64_t b) {
+            return a < b ? -1 : a > b ? 1 : 0;
+        }
+
+        inline BigInt operator+(BigInt a, const BigInt &b) {
+            return a += b;
+        }
+
+        /* Sets 'remainder' to 'remainder' mod 'divisor' and returns the
+         * quotient, which must be less than ten. */
+        inline unsigned int divide(std::uint64_t &remainder,
+                                   const std::uint64_t divisor) {
+            const unsigned int quotient = remainder / divisor;
+            remainder %= divisor;
+            return quotient;
+        }
+
+        inline unsigned int divide(BigInt &remainder, const BigInt &divisor) {
+            unsigned int quotient = 0;
+            while (compare(remainder, divisor) >= 0) {
+                remainder -= divisor;
+                quotient++;
+            }
+            return quotient;
+        }
+
+        template<typename Int>
+        inline void scaleByPowerOfTen(Int &n, int exponent) {
+            for (; exponent >= 9; exponent -= 9) {
+                n *= 1000000000;
+            }
+            for (; exponent > 0; exponent--) {
+                n *= 10;
+            }
+        }
+
+        // A decimal 0.d1 d2 ... dn * 10^exponent
+        struct Decimal {
+            char digits[64];
+            unsigned int nDigits;
+            int exponent;
+        };
+
+        // Decomposes a finite, positive float into f * 2^e.
+        struct Binary {
+            explicit Binary(const float value) {
+                std::uint32_t bits;
+                std::memcpy(&bits, &value, sizeof bits);
+                const unsigned int biasedExponent = (bits >> 23) & 0xFF;
+                mantissa = bits & 0x7FFFFF;
+                if (biasedExponent == 0) {
+                    exponent = -149;
+                } else {
+                    mantissa |= 1 << 23;
+                    exponent = static_cast<int>(biasedExponent) - 150;
+                }
+                /* The gap below the value is half the gap above when the
+                 * value is a power of two (other than the smallest). */
+                asymmetric = mantissa == 1 << 23 && biasedExponent > 1;
+            }
+
+            // A lower bound on ceil(log10(value)), off by at most one
+            int estimateDecimalExponent() const {
+                int bitLength = 0;
+                while (mantissa >> bitLength) {
+                    bitLength++;
+                }
+                // 78913 / 2^18 is just below log10(2).
+                const int log2 = exponent + bitLength - 1;
+                return log2 >= 0 ? log2 * 78913 >> 18
+                                 : -((-log2 * 78913 + (1 << 18) - 1) >> 18);
+            }
+
+            std::uint32_t mantissa;
+            int exponent;
+            bool asymmetric;
+        };
+
+        // Produces the shortest digits that read back as the passed float.
+        template<typename Int>
+        void shortest(const Binary &b, Decimal &result) {
+            const bool even = b.mantissa % 2 == 0;
+            // value = r / s; the rounding interval is (r - mm, r + mp) / s.
+            Int r(b.mantissa);
+            Int s(1);
+            Int mp(1);
+            Int mm(1);
+            r <<= b.asymmetric ? 2 : 1;
+            s <<= b.asymmetric ? 2 : 1;
+            mp <<= b.asymmetric ? 1 : 0;
+            if (b.exponent >= 0) {
+                r <<= b.exponent;
+                mp <<= b.exponent;
+                mm <<= b.exponent;
+            } else {
+                s <<= -b.exponent;
+            }
+            int k = b.estimateDecimalExponent();
+            if (k >= 0) {
+                scaleByPowerOfTen(s, k);
+            } else {
+                scaleByPowerOfTen(r, -k);
+                scaleByPowerOfTen(mp, -k);
+                scaleByPowerOfTen(mm, -k);
+            }
+            // Fix up the estimate.
+            while (compare(r + mp, s) >= (even ? 0 : 1)) {
+                s *= 10;
+                k++;
+            }
+            result.exponent = k;
+            // Generate digits.
+            result.nDigits = 0;
+            while (true) {
+                r *= 10;
+                mp *= 10;
+                mm *= 10;
+                unsigned int digit = divide(r, s);
+                const bool low = compare(r, mm) < (even ? 1 : 0);
+                const bool high = compare(r + mp, s) >= (even ? 0 : 1);
+                if (low || high) {
+                    if (high && (! low || compare(r + r, s) >= 0)) {
+                        digit++;
+                    }
+                    result.digits[result.nDigits++] = '0' + digit;
+                    return;
+                }
+                result.digits[result.nDigits++] = '0' + digit;
+            }
+        }
+
+        /* Produces the digits of the passed float rounded to 'decimals'
+         * places after the decimal point, breaking ties toward even. */
+        template<typename Int>
+        void fixed(const Binary &b, const unsigned int decimals,
+                   Decimal &result) {
+            Int r(b.mantissa);
+            Int s(1);
+            if (b.exponent >= 0) {
+                r <<= b.exponent;
+            } else {
+                s <<= -b.exponent;
+            }
+            int k = b.estimateDecimalExponent();
+            if (k >= 0) {
+                scaleByPowerOfTen(s, k);
+            } else {
+                scaleByPowerOfTen(r, -k);
+            }
+            while (compare(r, s) >= 0) {
+                s *= 10;
+                k++;
+            }
+            // Generate digits up to the last decimal place.
+            result.nDigits = 0;
+            const int nDigits = k + static_cast<int>(decimals);
+            if (nDigits < 0) {
+                // The value rounds to zero.
+                result.exponent = -static_cast<int>(decimals);
+                return;
+            }
+            if (nDigits == 0) {
+                // Everything is below the last place; pretend there's a 0.
+                result.digits[result.nDigits++] = '0';
+                k++;
+            }
+            for (int i = 0; i < nDigits; i++) {
+                r *= 10;
+                result.digits[result.nDigits++] = '0' + divide(r, s);
+            }
+            // Round the last digit.
+            const int half = compare(r + r, s);
+            const bool odd = (result.digits[result.nDigits - 1] - '0') % 2;
+            if (half > 0 || (half == 0 && odd)) {
+                unsigned int i = result.nDigits;
+                while (i > 0 && result.digits[i - 1] == '9') {
+                    result.digits[--i] = '0';
+                }
+                if (i == 0) {
+                    // All nines; carry into a new leading digit.
+                    std::memmove(result.digits + 1, result.digits,
+                                 result.nDigits);
+                    result.digits[0] = '1';
+                    result.nDigits++;
+                    k++;
+                } else {
+                    result.digits[i - 1]++;
+                }
+            }
+            result.exponent = k;
+        }
+
+        // Whether 64-bit arithmetic is enough for the passed float
+        inline bool fitsInWord(const Binary &b) {
+            return -50 <= b.exponent && b.exponent <= 6;
+        }
+
+        char *appendZeros(char *out, int n) {
+            for (; n > 0; n--) {
+                *out++ = '0';
+            }
+            return out;
+        }
+
+        char *appendDigits(char *out, const char *digits, const int n) {
+            if (n > 0) {
+                std::memcpy(out, digits, n);
+                out += n;
+            }
+            return out;
+        }
+
+        // Writes 0.d1 d2 ... dn * 10^exponent positionally.
+        char *writePositional(const Decimal &d, const unsigned int decimals,
+                              char *out) {
+            const int n = d.nDigits;
+            const int point = d.exponent;  // digits before the decimal point
+            if (point <= 0) {
+                *out++ = '0';
+            } else {
+                out = appendDigits(out, d.digits, point < n ? point : n);
+                out = appendZeros(out, point - n);
+            }
+            // Digits after the point, padded to 'decimals'
+            int after = n - (point > 0 ? point : 0);
+            if (after < 0) {
+                after = 0;
+            }
+            const int leadingZeros = point < 0 ? -point : 0;
+            int nDecimals = leadingZeros + after;
+            if (nDecimals < static_cast<int>(decimals)) {
+                nDecimals = decimals;
+            }
+            if (nDecimals > 0) {
+                *out++ = '.';
+                const int zeros = leadingZeros < nDecimals ? leadingZeros
+                                                           : nDecimals;
+                out = appendZeros(out, zeros);
+                out = appendDigits(out, d.digits + (n - after), after);
+                out = appendZeros(out, nDecimals - zeros - after);
+            }
+            return out;
+        }
+
+        // Writes d1.d2 ... dn e(exponent - 1).
+        char *writeScientific(const Decimal &d, char *out) {
+            *out++ = d.digits[0];
+            if (d.nDigits > 1) {
+                *out++ = '.';
+                out = appendDigits(out, d.digits + 1, d.nDigits - 1);
+            }
+            *out++ = 'e';
+            int exponent = d.exponent - 1;
+            if (exponent < 0) {
+                *out++ = '-';
+                exponent = -exponent;
+            } else {
+                *out++ = '+';
+            }
+            if (exponent >= 10) {
+                *out++ = '0' + exponent / 10;
+            } else {
+                *out++ = '0';
+            }
+            *out++ = '0' + exponent % 10;
+            return out;
+        }
+
+    }
+
+    char *formatFloat(const float value, const FloatFormat format,
+                      char *out) {
+        std::uint32_t bits;
+        std::memcpy(&bits, &value, sizeof bits);
+        if (bits >> 31) {
+            *out++ = '-';
+        }
+        if (value != value) {
+            std::memcpy(out, "nan", 3);
+            return out + 3;
+        } else if (value - value != 0) {
+            std::memcpy(out, "inf", 3);
+            return out + 3;
+        } else if (value == 0) {
+            Decimal zero;
+            zero.nDigits = 0;
+            zero.exponent = 0;
+            return writePositional(zero, format.decimals(), out);
+        }
+        const Binary b(value);
+        Decimal d;
+        if (format.isShortest()) {
+            if (fitsInWord(b)) {
+                shortest<std::uint64_t>(b, d);
+            } else {
+                shortest<BigInt>(b, d);
+            }
+            // Same thresholds as Python's repr
+            if (-4 <= d.exponent - 1 && d.exponent - 1 < 16) {
+                return writePositional(d, 0, out);
+            } else {
+                return writeScientific(d, out);
+            }
+        } else {
+            if (fitsInWord(b)) {
+                fixed<std::uint64_t>(b, format.decimals(), d);
+            } else {
+                fixed<BigInt>(b, format.decimals(), d);
+            }
+            return writePositional(d, format.decimals(), out);
+        }
+    }
+
+
+    // class Row
+
+    void Row::put(const float *const values, const std::size_t n) {
+        for (std::size_t i = 0; i < n; i++) {
+            put(values[i]);
+        }
+    }
+
+    void Row::put(const std::uint16_t *const values, const std::size_t n) {
+        for (std::size_t i = 0; i < n; i++) {
+            put(static_cast<unsigned int>(values[i]));
+        }
+    }
+
+
+    std::string joinColumns(const char *const *const names,
+                            const std::size_t nNames) {
+        std::string result;
+        for (std::size_t i = 0; i < nNames; i++) {
+            if (i) {
+                result.push_back(',');
+            }
+            result.append(names[i]);
+        }
+        return result;
+    }
+
+}
+
 #ifndef HAVE_CXX11_INITIALIZER_LISTS
 
     std::list<float> makeList(typename std::list<float>::size_type size, ...) {
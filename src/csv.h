@@ -25,6 +25,9 @@
 #   include <config.h>
 #endif
 
+#include <cstddef>
+#include <cstdint>
+
 #include <string>
 #include <sstream>
 
@@ -35,16 +38,102 @@
 
 namespace csv {
 
-    // Interface: Any datum which can be converted to a CSV string.
-    struct Datum {
-        virtual std::string csvHeader() const = 0;
-        virtual std::string csv() const = 0;
-        virtual unsigned int nCols() const = 0;
+    // How to print floating-point columns
+    class FloatFormat {
+    public:
+        /* The shortest decimal string which reads back as exactly the same
+         * float.  Moderate magnitudes are printed positionally ("0.25",
+         * "32768"); very large and very small ones in scientific notation
+         * ("1e-05"). */
+        static inline FloatFormat shortest();
+
+        /* Positional notation with the passed number of digits after the
+         * decimal point, rounded correctly--like printf's "%.*f". */
+        static inline FloatFormat fixed(unsigned int decimals);
+
+        inline bool isShortest() const;
+        inline unsigned int decimals() const;
+
+        // The largest number of decimals 'fixed' accepts
+        static const unsigned int MAX_DECIMALS = 12;
+
+    private:
+        explicit inline FloatFormat(int decimals);
+        int decimals_;          // negative for 'shortest'
+    };
+
+    // Enough space for any float formatted in any FloatFormat
+    const std::size_t MAX_FLOAT_CHARS = 64;
+
+    /* Writes the passed float into the passed buffer, which must have room
+     * for at least MAX_FLOAT_CHARS characters, and returns a pointer just past
+     * the last character written.  No terminating NUL is written.  The result
+     * does not depend on the C or C++ locale. */
+    char *formatFloat(float, FloatFormat, char *out);
+
+    /* Appends the columns of one CSV row to a caller-owned string, putting
+     * commas between them.  Numbers are formatted in place, without streams
+     * or temporary strings, so reusing one string for every row (clearing it
+     * in between) avoids allocating at all once it has grown large enough. */
+    class Row {
+    public:
+        inline Row(std::string &line, FloatFormat);
+        inline void put(float);
+        // Puts a float in the passed format rather than the row's.
+        inline void put(float, FloatFormat);
+        inline void put(unsigned int);
+        inline void put(unsigned long long);
+        /* Puts a string as is, without quoting, so it must not hold commas,
+         * quotes, or line breaks. */
+        inline void put(const std::string &);
+        // Puts each of the passed numbers in its own column.
+        void put(const float *, std::size_t);
+        void put(const std::uint16_t *, std::size_t);
+
+    private:
+        inline void separate();
+
+        std::string &line;
+        const FloatFormat format;
+        bool first;
+    };
+
+    /* The columns of a record type, declared once for the type.  Each type
+     * written to a CSV file specializes this with
+     *
+     *     static unsigned int nCols(const T &);
+     *     static std::string header(const T &);  // or a const reference
+     *     static void write(Row &, const T &);
+     *
+     * Files call these directly, so writing a row costs no virtual calls.
+     * Types whose columns never change get the first two from FixedSchema;
+     * the rest, like lidar scans with one column per beam, work them out
+     * from the record. */
+    template<typename T>
+    struct Schema;
+
+    /* The column count and header of a record type with a fixed set of
+     * columns.  The specialization of Schema deriving from this names them in
+     * a static array
+     *
+     *     static const char *const COLUMNS[N_COLS];
+     *
+     * and the header is joined from that array the first time it is needed,
+     * then shared for the rest of the run. */
+    template<typename T, unsigned int N>
+    struct FixedSchema {
+        static const unsigned int N_COLS = N;
+        static inline unsigned int nCols(const T &);
+        static inline const std::string &header(const T &);
     };
 
+    // Joins the passed column names into a header, putting commas between.
+    std::string joinColumns(const char *const *names, std::size_t nNames);
+
     /* Converts a sequence of objects to a CSV string.  It uses stringstreams
      * internally, so all data in the sequence will get converted to strings
-     * using operator<<; however, no escaping will occur. */
+     * using operator<<; however, no escaping will occur.  This is meant for
+     * headers; use 'Row' for data. */
     template<typename SequenceContainer>
     std::string fromContainer(const SequenceContainer &);
 
@@ -0,0 +1,312 @@
+/* csvTest.cpp -- unit tests for formatting CSV numbers
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "csv.h"
+#include "span.h"
+#include "unitTest.h"
+
+namespace {
+
+    /* 'formatFloat' must print the shortest string which reads back as the
+     * same float, and, with a fixed number of decimals, exactly what printf
+     * prints, for every finite float.  Most floats are converted in 64-bit
+     * arithmetic; the largest and smallest, subnormals included, go through
+     * a bignum, so both paths are checked. */
+
+    // Formats a float, failing if it takes more than MAX_FLOAT_CHARS.
+    std::string format(float, csv::FloatFormat);
+
+    // The bits of a float, for messages
+    std::string bits(float);
+
+    // Finite floats with uniformly random bit patterns
+    std::vector<float> randomFinite(std::size_t n);
+
+    /* Floats too large or too small for 64-bit arithmetic: subnormals,
+     * the smallest normals, and the largest floats */
+    std::vector<float> extremes();
+
+    /* Floats exactly halfway between two numbers with the passed number of
+     * decimals, and just below powers of ten, whose rounding carries
+     * through a run of nines */
+    std::vector<float> tiesAndCarries(unsigned int decimals);
+
+    /* Fails unless each float's shortest form reads back as the float, and
+     * no string with fewer significant digits does. */
+    void expectShortest(const std::vector<float> &);
+
+    /* Fails unless each float printed with the passed number of decimals
+     * matches printf's "%.*f". */
+    void expectFixed(const std::vector<float> &, unsigned int decimals);
+    // Likewise for every number of decimals
+    void expectFixed(const std::vector<float> &);
+
+
+    // Tests //
+
+    void shortestRandom() {
+        expectShortest(randomFinite(200000));
+    }
+
+    void fixedRandom() {
+        expectFixed(randomFinite(20000));
+    }
+
+    void fixedTiesAndCarries() {
+        for (unsigned int decimals = 0;
+             decimals <= csv::FloatFormat::MAX_DECIMALS; decimals++) {
+            expectFixed(tiesAndCarries(decimals), decimals);
+        }
+    }
+
+    void bigIntExtremes() {
+        const std::vector<float> values = extremes();
+        expectShortest(values);
+        expectFixed(values);
+    }
+
+    void specialValues() {
+        const float inf = std::numeric_limits<float>::infinity();
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        const csv::FloatFormat formats[] = {
+            csv::FloatFormat::shortest(),
+            csv::FloatFormat::fixed(0),
+            csv::FloatFormat::fixed(3),
+        };
+        const char *const expected[][3] = {
+            {"0", "0", "0.000"},
+            {"-0", "-0", "-0.000"},
+            {"inf", "inf", "inf"},
+            {"-inf", "-inf", "-inf"},
+            {"nan", "nan", "nan"},
+        };
+        const float values[] = {0.0f, -0.0f, inf, -inf, nan};
+        for (std::size_t i = 0; i < sizeof values / sizeof values[0]; i++) {
+            for (std::size_t j = 0; j < 3; j++) {
+                const std::string actual = format(values[i], formats[j]);
+                unitTest::expect(actual == expected[i][j],
+                                 bits(values[i]) + " is " + actual
+                                 + ", not " + expected[i][j]);
+            }
+        }
+    }
+
+    const unitTest::Test TESTS[] = {
+        {"csv::formatFloat/shortest", shortestRandom},
+        {"csv::formatFloat/fixed", fixedRandom},
+        {"csv::formatFloat/fixed/ties", fixedTiesAndCarries},
+        {"csv::formatFloat/bigInt", bigIntExtremes},
+        {"csv::formatFloat/special", specialValues},
+    };
+
+}
+
+namespace unitTest {
+
+    const Span<const Test> csvTests(TESTS, sizeof TESTS / sizeof TESTS[0]);
+
+}
+
+
+namespace {
+
+    std::string format(const float value, const csv::FloatFormat format) {
+        // Room past the limit, so an overlong result shows up
+        char out[csv::MAX_FLOAT_CHARS * 2];
+        const char *const end = csv::formatFloat(value, format, out);
+        unitTest::expect(end - out <= static_cast<std::ptrdiff_t>(
+                                          csv::MAX_FLOAT_CHARS),
+                         bits(value) + " takes more than MAX_FLOAT_CHARS");
+        return std::string(out, end - out);
+    }
+
+    std::string bits(const float value) {
+        std::uint32_t result;
+        std::memcpy(&result, &value, sizeof result);
+        char hex[16];
+        std::snprintf(hex, sizeof hex, "0x%08x", result);
+        return hex;
+    }
+
+    // The float with the passed bits
+    float fromBits(const std::uint32_t bits) {
+        float result;
+        std::memcpy(&result, &bits, sizeof result);
+        return result;
+    }
+
+    std::vector<float> randomFinite(const std::size_t n) {
+        std::mt19937 random(20140604);
+        std::vector<float> result;
+        while (result.size() < n) {
+            const float value = fromBits(random());
+            if (std::isfinite(value)) {
+                result.push_back(value);
+            }
+        }
+        return result;
+    }
+
+    std::vector<float> extremes() {
+        std::vector<float> result;
+        // Subnormals, spread across their range, and the smallest normals
+        for (std::uint32_t b = 1; b <= 0x00800000; b += 997) {
+            result.push_back(fromBits(b));
+        }
+        for (std::uint32_t b = 0x00800000; b < 0x00810000; b += 7) {
+            result.push_back(fromBits(b));
+        }
+        result.push_back(std::numeric_limits<float>::denorm_min());
+        result.push_back(std::numeric_limits<float>::min());
+        // The largest floats, and powers of ten on either side of 64 bits
+        for (std::uint32_t b = 0x7f7fffff; b > 0x7f7f0000; b -= 13) {
+            result.push_back(fromBits(b));
+        }
+        result.push_back(std::numeric_limits<float>::max());
+        const float inf = std::numeric_limits<float>::infinity();
+        for (int exponent = -45; exponent <= 38; exponent++) {
+            const float power = std::pow(10.0f, static_cast<float>(exponent));
+            if (power > 0 && std::isfinite(power)) {
+                result.push_back(power);
+                result.push_back(std::nextafter(power, 0.0f));
+                result.push_back(std::nextafter(power, inf));
+            }
+        }
+        const std::size_t n = result.size();
+        for (std::size_t i = 0; i < n; i++) {
+            result.push_back(-result[i]);
+        }
+        return result;
+    }
+
+    std::vector<float> tiesAndCarries(const unsigned int decimals) {
+        std::mt19937 random(decimals);
+        std::uniform_int_distribution<std::uint32_t> odd(0, 1 << 19);
+        std::vector<float> result;
+        /* An odd number over 2^(decimals + 1) has exactly decimals + 1
+         * digits after the point, the last a 5. */
+        const float scale =
+            std::ldexp(1.0f, -static_cast<int>(decimals) - 1);
+        for (unsigned int i = 0; i < 200; i++) {
+            result.push_back((2 * odd(random) + 1) * scale);
+        }
+        // Just below powers of ten, and just below where they round up
+        for (int exponent = -12; exponent <= 12; exponent++) {
+            const float power = std::pow(10.0f, static_cast<float>(exponent));
+            result.push_back(std::nextafter(power, 0.0f));
+            const float roundsUp =
+                power - 0.5f * std::pow(10.0f, -static_cast<float>(decimals));
+            if (roundsUp > 0) {
+                result.push_back(roundsUp);
+                result.push_back(std::nextafter(roundsUp, 0.0f));
+                result.push_back(std::nextafter(roundsUp, power));
+            }
+        }
+        const float nines[] = {
+            0.9996f, 9.9996f, 99.9996f, 999.9996f, 9999.9996f, 0.995f,
+            9.5f, 99.5f, 999.5f, 0.0995f, 0.00999f, 999999.94f,
+        };
+        result.insert(result.end(), nines,
+                      nines + sizeof nines / sizeof nines[0]);
+        const std::size_t n = result.size();
+        for (std::size_t i = 0; i < n; i++) {
+            result.push_back(-result[i]);
+        }
+        return result;
+    }
+
+    // The number of significant digits in a formatted float
+    std::size_t significantDigits(const std::string &formatted) {
+        std::string digits;
+        for (const char c : formatted.substr(0, formatted.find('e'))) {
+            if ('0' <= c && c <= '9') {
+                digits += c;
+            }
+        }
+        const std::string::size_type first = digits.find_first_not_of('0');
+        const std::string::size_type last = digits.find_last_not_of('0');
+        return first == std::string::npos ? 0 : last - first + 1;
+    }
+
+    void expectShortest(const std::vector<float> &values) {
+        for (const float value : values) {
+            const std::string actual =
+                format(value, csv::FloatFormat::shortest());
+            const float back = std::strtof(actual.c_str(), nullptr);
+            unitTest::expect(std::memcmp(&back, &value, sizeof value) == 0,
+                             bits(value) + " is " + actual
+                             + ", which reads back as " + bits(back));
+            // The fewest digits which read back, rounding correctly
+            std::size_t shortest = 1;
+            for (; shortest < 9; shortest++) {
+                char candidate[csv::MAX_FLOAT_CHARS];
+                std::snprintf(candidate, sizeof candidate, "%.*e",
+                              static_cast<int>(shortest - 1),
+                              static_cast<double>(value));
+                if (std::strtof(candidate, nullptr) == value) {
+                    break;
+                }
+            }
+            unitTest::expect(value == 0
+                             || significantDigits(actual) == shortest,
+                             bits(value) + " is " + actual + ", not "
+                             + std::to_string(shortest) + " digits long");
+        }
+    }
+
+    void expectFixed(const std::vector<float> &values,
+                     const unsigned int decimals) {
+        for (const float value : values) {
+            char expected[csv::MAX_FLOAT_CHARS * 2];
+            std::snprintf(expected, sizeof expected, "%.*f", decimals,
+                          static_cast<double>(value));
+            const std::string actual =
+                format(value, csv::FloatFormat::fixed(decimals));
+            unitTest::expect(actual == expected,
+                             bits(value) + " to " + std::to_string(decimals)
+                             + " decimals is " + actual + ", not "
+                             + expected);
+        }
+    }
+
+    void expectFixed(const std::vector<float> &values) {
+        for (unsigned int decimals = 0;
+             decimals <= csv::FloatFormat::MAX_DECIMALS; decimals++) {
+            expectFixed(values, decimals);
+        }
+    }
+
+}
@@ -0,0 +1,131 @@
+/* intake-inl.h -- values from many threads, merged in time order
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifndef PPAML_VREP_AUTOMOBILE_PLUGIN_INTAKE_INL_H
+#define PPAML_VREP_AUTOMOBILE_PLUGIN_INTAKE_INL_H
+
+#include <utility>
+
+template<typename T>
+Intake<T>::Intake(const std::size_t ringCapacity)
+    : ringCapacity(ringCapacity), producers(nullptr) {
+}
+
+template<typename T>
+Intake<T>::~Intake() {
+    Producer *producer = producers.load(std::memory_order_acquire);
+    while (producer) {
+        Producer *const next = producer->next;
+        delete producer;
+        producer = next;
+    }
+}
+
+template<typename T>
+bool Intake<T>::tryPush(const float time, T &value) {
+    Producer &producer = producerForThisThread();
+    Entry entry;
+    entry.time = time;
+    entry.value = std::move(value);
+    if (producer.ring.tryPush(entry)) {
+        return true;
+    }
+    // Hand the value back, as promised.
+    value = std::move(entry.value);
+    return false;
+}
+
+template<typename T>
+void Intake<T>::drain(std::vector<T> &out) {
+    Producer *const first = producers.load(std::memory_order_acquire);
+    for (Producer *producer = first; producer; producer = producer->next) {
+        Entry entry;
+        while (producer->ring.tryPop(entry)) {
+            producer->drained.push_back(std::move(entry));
+        }
+    }
+    /* Take the earliest entry at the front of any producer's run until all
+     * are used up.  There are only ever a few producers, so a scan beats a
+     * heap. */
+    for (;;) {
+        Producer *earliest = nullptr;
+        for (Producer *producer = first; producer; producer = producer->next) {
+            if (producer->nextDrained < producer->drained.size()
+                && (! earliest
+                    || producer->drained[producer->nextDrained].time
+                       < earliest->drained[earliest->nextDrained].time)) {
+                earliest = producer;
+            }
+        }
+        if (! earliest) {
+            break;
+        }
+        out.push_back(
+            std::move(earliest->drained[earliest->nextDrained++].value));
+    }
+    for (Producer *producer = first; producer; producer = producer->next) {
+        producer->drained.clear();
+        producer->nextDrained = 0;
+    }
+}
+
+template<typename T>
+bool Intake<T>::empty() const {
+    for (const Producer *producer = producers.load(std::memory_order_acquire);
+         producer; producer = producer->next) {
+        if (! producer->ring.empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template<typename T>
+Intake<T>::Producer::Producer(const std::thread::id thread,
+                              const std::size_t ringCapacity)
+    : thread(thread), ring(ringCapacity), next(nullptr), drained(),
+      nextDrained(0) {
+}
+
+template<typename T>
+typename Intake<T>::Producer &Intake<T>::producerForThisThread() {
+    const std::thread::id self = std::this_thread::get_id();
+    Producer *head = producers.load(std::memory_order_acquire);
+    for (Producer *producer = head; producer; producer = producer->next) {
+        if (producer->thread == self) {
+            return *producer;
+        }
+    }
+    /* Only this thread adds a producer for itself, so if another thread adds
+     * one meanwhile, it is not ours; just try again in front of it.  (A
+     * thread which has exited may leave a producer with an id the system
+     * then reuses, but that thread no longer pushes, so the new thread can
+     * take over its ring.) */
+    Producer *const added = new Producer(self, ringCapacity);
+    added->next = head;
+    while (! producers.compare_exchange_weak(head, added,
+                                             std::memory_order_release,
+                                             std::memory_order_acquire)) {
+        added->next = head;
+    }
+    return *added;
+}
+
+#endif
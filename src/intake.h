@@ -0,0 +1,96 @@
+/* intake.h -- values from many threads, merged in time order
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifndef PPAML_VREP_AUTOMOBILE_PLUGIN_INTAKE_H
+#define PPAML_VREP_AUTOMOBILE_PLUGIN_INTAKE_H
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cstddef>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "ring.h"
+
+/* Takes timestamped values from any number of threads, without locks, and
+ * hands them to one consumer at a time merged in time order.
+ *
+ * Each thread gets its own single-producer ring (see ring.h) the first time
+ * it pushes.  The rings hang off a list which only ever grows, so a thread
+ * finds its ring by walking a few nodes, and adding one takes a single
+ * compare-and-swap.  Draining empties every ring and merges their contents
+ * by time, keeping each thread's values in the order it pushed them, so a
+ * single thread's values come out exactly as they went in.
+ *
+ * The merge orders what has arrived when it runs; it does not hold values
+ * back waiting for slower threads.  (For that, see reorder.h.) */
+template<typename T>
+class Intake {
+public:
+    // Each thread's ring holds at least 'ringCapacity' values.
+    explicit Intake(std::size_t ringCapacity);
+    ~Intake();
+    Intake(const Intake &) = delete;
+    Intake &operator=(const Intake &) = delete;
+
+    /* Moves a value into the calling thread's ring.  Returns false, leaving
+     * the value untouched, if the ring is full.  Safe to call from any
+     * thread. */
+    bool tryPush(float time, T &);
+
+    /* Appends every value pushed so far to the passed vector, in time order.
+     * Only one thread may drain at a time. */
+    void drain(std::vector<T> &);
+
+    /* Whether every ring is empty.  Another thread may push meanwhile, so
+     * this is only a hint, unless no other thread is pushing. */
+    bool empty() const;
+
+private:
+    struct Entry {
+        float time;
+        T value;
+    };
+
+    struct Producer {
+        Producer(std::thread::id, std::size_t ringCapacity);
+
+        const std::thread::id thread;
+        SpscRing<Entry> ring;
+        Producer *next;
+        // Entries taken from the ring and not yet merged; drainer only
+        std::vector<Entry> drained;
+        std::size_t nextDrained;
+    };
+
+    // The calling thread's producer, which is added if it has none yet
+    Producer &producerForThisThread();
+
+    const std::size_t ringCapacity;
+    std::atomic<Producer *> producers;
+};
+
+#include "intake-inl.h"
+
+#endif
@@ -0,0 +1,272 @@
+/* intakeTest.cpp -- unit tests for the multi-producer intake
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cstddef>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "intake.h"
+#include "span.h"
+#include "unitTest.h"
+
+namespace {
+
+    // A value pushed by a producer, which says where it came from
+    struct Item {
+        float time;
+        unsigned int producer;
+        unsigned int sequence;
+    };
+
+    // A moved-from pointer is null, so values handed back are easy to tell.
+    typedef std::unique_ptr<Item> Value;
+
+    /* A thread which pushes into an intake when told to.  It lives until the
+     * object is destroyed, so no other thread can take over its ring, and it
+     * pushes only while the test thread waits, so the tests are
+     * deterministic. */
+    class Producer {
+    public:
+        Producer(Intake<Value> &, unsigned int id);
+        ~Producer();
+        Producer(const Producer &) = delete;
+        Producer &operator=(const Producer &) = delete;
+
+        /* Has the thread push a new item with each of the passed times, in
+         * order, and waits until it has.  Pushes which fail leave their
+         * values in 'rejected' (which is cleared first). */
+        void push(const std::vector<float> &times,
+                  std::vector<Value> &rejected);
+
+    private:
+        // The thread's loop
+        void run();
+
+        Intake<Value> &intake;
+        const unsigned int id;
+        unsigned int nPushed;
+        std::mutex lock;
+        std::condition_variable changed;
+        // The values to push, while the thread has work
+        std::vector<Value> *batch;
+        bool stopping;
+        std::thread thread;
+    };
+
+    // Drains the intake, and fails unless it gave back just these items.
+    void expectDrained(Intake<Value> &, const std::vector<float> &times,
+                       const std::vector<unsigned int> &producers,
+                       const std::string &what);
+
+
+    // Tests //
+
+    /* Values from several threads come out merged by time, and the values
+     * of each thread in the order it pushed them, even where its times go
+     * backwards. */
+    void mergesByTime() {
+        Intake<Value> intake(64);
+        Producer a(intake, 0);
+        Producer b(intake, 1);
+        Producer c(intake, 2);
+        std::vector<Value> rejected;
+        std::vector<float> times[3];
+        std::vector<float> expectedTimes;
+        std::vector<unsigned int> expectedProducers;
+        for (unsigned int i = 0; i < 30; i++) {
+            times[i % 3].push_back(i);
+            expectedTimes.push_back(i);
+            expectedProducers.push_back(i % 3);
+        }
+        // Push out of order across the threads.
+        c.push(times[2], rejected);
+        a.push(times[0], rejected);
+        b.push(times[1], rejected);
+        expectDrained(intake, expectedTimes, expectedProducers, "in order");
+
+        // A thread's values stay in its order when its times go backwards.
+        const float aTimes[] = {40, 38, 39};
+        const float bTimes[] = {37, 41};
+        a.push(std::vector<float>(aTimes, aTimes + 3), rejected);
+        b.push(std::vector<float>(bTimes, bTimes + 2), rejected);
+        const float mergedTimes[] = {37, 40, 38, 39, 41};
+        const unsigned int mergedProducers[] = {1, 0, 0, 0, 1};
+        expectDrained(intake, std::vector<float>(mergedTimes, mergedTimes + 5),
+                      std::vector<unsigned int>(mergedProducers,
+                                                mergedProducers + 5),
+                      "backwards");
+
+        // Nothing is left over for the next drain.
+        expectDrained(intake, std::vector<float>(),
+                      std::vector<unsigned int>(), "empty");
+    }
+
+    /* A full ring refuses values and hands them back whole, without holding
+     * up other threads; draining makes room again. */
+    void handsBackWhenFull() {
+        Intake<Value> intake(8);
+        Producer a(intake, 0);
+        Producer b(intake, 1);
+        std::vector<float> times;
+        for (unsigned int i = 0; i < 20; i++) {
+            times.push_back(i);
+        }
+        std::vector<Value> rejected;
+        a.push(times, rejected);
+        const std::size_t nAccepted = times.size() - rejected.size();
+        unitTest::expect(nAccepted >= 8 && ! rejected.empty(),
+                         std::to_string(nAccepted) + " of "
+                         + std::to_string(times.size())
+                         + " values fit in a ring of 8");
+        for (std::size_t i = 0; i < rejected.size(); i++) {
+            unitTest::expect(rejected[i]
+                             && rejected[i]->producer == 0
+                             && rejected[i]->sequence == nAccepted + i
+                             && rejected[i]->time == nAccepted + i,
+                             "value " + std::to_string(nAccepted + i)
+                             + " not handed back whole");
+        }
+        // The other thread has a ring of its own.
+        std::vector<Value> bRejected;
+        b.push(std::vector<float>(1, 0.5f), bRejected);
+        unitTest::expect(bRejected.empty(),
+                         "a full ring held up another thread");
+        std::vector<float> expectedTimes(1, 0);
+        std::vector<unsigned int> expectedProducers(1, 0);
+        expectedTimes.push_back(0.5f);
+        expectedProducers.push_back(1);
+        for (std::size_t i = 1; i < nAccepted; i++) {
+            expectedTimes.push_back(i);
+            expectedProducers.push_back(0);
+        }
+        expectDrained(intake, expectedTimes, expectedProducers, "full");
+
+        // Drained, the ring takes values again.
+        a.push(std::vector<float>(1, 100), rejected);
+        unitTest::expect(rejected.empty(), "a drained ring is still full");
+    }
+
+    const unitTest::Test TESTS[] = {
+        {"intake/merge", mergesByTime},
+        {"intake/full", handsBackWhenFull},
+    };
+
+}
+
+namespace unitTest {
+
+    const Span<const Test> intakeTests(TESTS, sizeof TESTS / sizeof TESTS[0]);
+
+}
+
+
+namespace {
+
+    // class Producer
+
+    Producer::Producer(Intake<Value> &intake, const unsigned int id)
+        : intake(intake), id(id), nPushed(0), lock(), changed(),
+          batch(nullptr), stopping(false), thread(&Producer::run, this) {
+    }
+
+    Producer::~Producer() {
+        {
+            const std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        changed.notify_all();
+        thread.join();
+    }
+
+    void Producer::push(const std::vector<float> &times,
+                        std::vector<Value> &rejected) {
+        std::vector<Value> values;
+        for (const float time : times) {
+            Item *const item = new Item;
+            item->time = time;
+            item->producer = id;
+            item->sequence = nPushed++;
+            values.push_back(Value(item));
+        }
+        std::unique_lock<std::mutex> guard(lock);
+        batch = &values;
+        changed.notify_all();
+        while (batch) {
+            changed.wait(guard);
+        }
+        guard.unlock();
+        rejected.clear();
+        for (Value &value : values) {
+            if (value) {
+                rejected.push_back(std::move(value));
+            }
+        }
+    }
+
+    void Producer::run() {
+        std::unique_lock<std::mutex> guard(lock);
+        while (true) {
+            while (! batch && ! stopping) {
+                changed.wait(guard);
+            }
+            if (! batch) {
+                return;
+            }
+            for (Value &value : *batch) {
+                intake.tryPush(value->time, value);
+            }
+            batch = nullptr;
+            changed.notify_all();
+        }
+    }
+
+
+    // Checks //
+
+    void expectDrained(Intake<Value> &intake,
+                       const std::vector<float> &times,
+                       const std::vector<unsigned int> &producers,
+                       const std::string &what) {
+        std::vector<Value> drained;
+        intake.drain(drained);
+        unitTest::expect(drained.size() == times.size(),
+                         what + ": drained " + std::to_string(drained.size())
+                         + " values, not " + std::to_string(times.size()));
+        for (std::size_t i = 0; i < drained.size(); i++) {
+            unitTest::expect(drained[i]->time == times[i]
+                             && drained[i]->producer == producers[i],
+                             what + ": value " + std::to_string(i)
+                             + " has time " + std::to_string(drained[i]->time)
+                             + " from producer "
+                             + std::to_string(drained[i]->producer));
+        }
+        unitTest::expect(intake.empty(), what + ": not empty after draining");
+    }
+
+}
@@ -0,0 +1,71 @@
+/* latency-inl.h -- histograms of how long things take
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifndef PPAML_VREP_AUTOMOBILE_PLUGIN_LATENCY_INL_H
+#define PPAML_VREP_AUTOMOBILE_PLUGIN_LATENCY_INL_H
+
+namespace latency {
+
+    // class Histogram
+
+    void Histogram::record(const std::uint64_t nanoseconds) {
+        counts[bucketFor(nanoseconds)].fetch_add(1,
+                                                 std::memory_order_relaxed);
+        std::uint64_t longest = max_.load(std::memory_order_relaxed);
+        while (nanoseconds > longest
+               && ! max_.compare_exchange_weak(longest, nanoseconds,
+                                               std::memory_order_relaxed)) {
+        }
+    }
+
+    std::uint64_t Histogram::max() const {
+        return max_.load(std::memory_order_relaxed);
+    }
+
+    std::size_t Histogram::bucketFor(const std::uint64_t nanoseconds) {
+        if (nanoseconds < SUB_BUCKETS) {
+            return nanoseconds;
+        }
+        const unsigned int exponent = 63 - __builtin_clzll(nanoseconds);
+        if (exponent > MAX_EXPONENT) {
+            return N_BUCKETS - 1;
+        }
+        /* The top SUB_BUCKET_BITS + 1 bits pick the bucket within the power
+         * of two; they run from SUB_BUCKETS to 2 * SUB_BUCKETS - 1. */
+        const unsigned int shift = exponent - SUB_BUCKET_BITS;
+        return shift * SUB_BUCKETS + (nanoseconds >> shift);
+    }
+
+
+    // class Timer
+
+    Timer::Timer(Histogram &histogram)
+        : histogram(histogram), start(Clock::now()) {
+    }
+
+    Timer::~Timer() {
+        histogram.record(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                Clock::now() - start).count());
+    }
+
+}
+
+#endif
@@ -0,0 +1,91 @@
+/* latency.cpp -- histograms of how long things take
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <atomic>
+
+#include "latency.h"
+
+namespace latency {
+
+    // class Histogram
+
+    Histogram::Histogram() {
+        clear();
+    }
+
+    void Histogram::clear() {
+        for (std::atomic<std::uint64_t> &count : counts) {
+            count.store(0, std::memory_order_relaxed);
+        }
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+    std::uint64_t Histogram::count() const {
+        std::uint64_t result = 0;
+        for (const std::atomic<std::uint64_t> &count : counts) {
+            result += count.load(std::memory_order_relaxed);
+        }
+        return result;
+    }
+
+    std::uint64_t Histogram::percentile(const double fraction) const {
+        std::array<std::uint64_t, N_BUCKETS> snapshot;
+        std::uint64_t total = 0;
+        for (std::size_t i = 0; i < N_BUCKETS; i++) {
+            snapshot[i] = counts[i].load(std::memory_order_relaxed);
+            total += snapshot[i];
+        }
+        if (total == 0) {
+            return 0;
+        }
+        // The rank of the duration sought, counting from one
+        const std::uint64_t rank = std::max<std::uint64_t>(
+            1, std::ceil(std::min(std::max(fraction, 0.), 1.) * total));
+        std::uint64_t seen = 0;
+        std::size_t bucket = 0;
+        while (seen + snapshot[bucket] < rank) {
+            seen += snapshot[bucket];
+            bucket++;
+        }
+        // The bucket may reach past the longest duration in it.
+        return std::min(highestIn(bucket), max());
+    }
+
+    std::uint64_t Histogram::highestIn(const std::size_t bucket) {
+        if (bucket < SUB_BUCKETS) {
+            return bucket;
+        }
+        const unsigned int shift = bucket / SUB_BUCKETS - 1;
+        const std::uint64_t lowest =
+            static_cast<std::uint64_t>(bucket % SUB_BUCKETS + SUB_BUCKETS)
+            << shift;
+        return lowest + (std::uint64_t(1) << shift) - 1;
+    }
+
+}
@@ -0,0 +1,102 @@
+/* latency.h -- histograms of how long things take
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifndef PPAML_VREP_AUTOMOBILE_PLUGIN_LATENCY_H
+#define PPAML_VREP_AUTOMOBILE_PLUGIN_LATENCY_H
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+
+namespace latency {
+
+    /* A histogram of durations in nanoseconds, in the style of HdrHistogram.
+     * Durations under 32 ns get a bucket each; above that, each power of two
+     * is split into 32 buckets, so a bucket's values are within about 3% of
+     * each other.  Durations past about half an hour share the last bucket.
+     *
+     * Recording is a few instructions and takes no locks, so any number of
+     * threads may record at once, and the histogram may be read while they
+     * do; a reading taken meanwhile may miss the latest durations. */
+    class Histogram {
+    public:
+        Histogram();
+        Histogram(const Histogram &) = delete;
+        Histogram &operator=(const Histogram &) = delete;
+
+        inline void record(std::uint64_t nanoseconds);
+
+        // Forgets every duration recorded.  Don't record meanwhile.
+        void clear();
+
+        std::uint64_t count() const;
+
+        /* The duration which the passed fraction of the recorded durations do
+         * not exceed--e.g., 0.99 for the 99th percentile--to within the
+         * width of its bucket.  Zero if nothing was recorded. */
+        std::uint64_t percentile(double fraction) const;
+
+        // The longest duration recorded, exactly
+        inline std::uint64_t max() const;
+
+    private:
+        static const unsigned int SUB_BUCKET_BITS = 5;
+        static const std::size_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+        // The last power of two with buckets of its own
+        static const unsigned int MAX_EXPONENT = 40;
+        static const std::size_t N_BUCKETS =
+            (MAX_EXPONENT - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+
+        static inline std::size_t bucketFor(std::uint64_t);
+        // The longest duration which goes in the passed bucket
+        static std::uint64_t highestIn(std::size_t bucket);
+
+        std::array<std::atomic<std::uint64_t>, N_BUCKETS> counts;
+        std::atomic<std::uint64_t> max_;
+    };
+
+    /* Records how long it exists--usually, a scope--in a histogram.  It
+     * records even if the scope is left by an exception. */
+    class Timer {
+    public:
+        explicit inline Timer(Histogram &);
+        inline ~Timer();
+        Timer(const Timer &) = delete;
+        Timer &operator=(const Timer &) = delete;
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        Histogram &histogram;
+        const Clock::time_point start;
+    };
+
+}
+
+#include "latency-inl.h"
+
+#endif
@@ -0,0 +1,54 @@
+/* lidar-inl.h -- lidar preprocessing kernels
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifndef PPAML_VREP_AUTOMOBILE_PLUGIN_LIDAR_INL_H
+#define PPAML_VREP_AUTOMOBILE_PLUGIN_LIDAR_INL_H
+
+#include <cmath>
+
+namespace lidar {
+
+    // class Quantizer
+
+    float Quantizer::scale() const {
+        return scale_;
+    }
+
+    std::uint16_t Quantizer::quantize(const float value) const {
+        // Dividing in double keeps values near a tie on the right side.
+        const double steps = static_cast<double>(value) / scale_;
+        // This also sends NaN to 0.
+        if (! (steps > 0)) {
+            return 0;
+        } else if (steps >= MAX_STORED) {
+            return MAX_STORED;
+        } else {
+            return static_cast<std::uint16_t>(std::lround(steps));
+        }
+    }
+
+
+    float dequantize(const std::uint16_t stored, const float scale) {
+        return stored * scale;
+    }
+
+}
+
+#endif
@@ -0,0 +1,314 @@
+/* lidar.cpp -- lidar preprocessing kernels
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef HAVE_X86_SIMD_DISPATCH
+#   include <immintrin.h>
+#endif
+
+#include "cpu.h"
+#include "lidar.h"
+#include "span.h"
+
+namespace lidar {
+
+    namespace {
+
+        /* Each kernel handles one contiguous input; 'concatenateScaled' calls
+         * it once per half.  The vector loops leave any tail shorter than a
+         * register to the scalar loop, which rounds identically. */
+
+        typedef void Kernel(const float *in, std::size_t n, float scale,
+                            const float *noise, float *out);
+
+        void scaleScalar(const float *const in, const std::size_t n,
+                         const float scale, const float *const noise,
+                         float *const out) {
+            if (noise) {
+                /* configure selects ISO C++ (-std=c++11), in which GCC and
+                 * Clang don't contract this into a fused multiply-add, so it
+                 * rounds just like the vector kernels. */
+                for (std::size_t i = 0; i < n; i++) {
+                    out[i] = in[i] * scale + noise[i];
+                }
+            } else {
+                for (std::size_t i = 0; i < n; i++) {
+                    out[i] = in[i] * scale;
+                }
+            }
+        }
+
+#       ifdef HAVE_X86_SIMD_DISPATCH
+
+        __attribute__((target("sse2")))
+        void scaleSse2(const float *const in, const std::size_t n,
+                       const float scale, const float *const noise,
+                       float *const out) {
+            const __m128 factor = _mm_set1_ps(scale);
+            std::size_t i = 0;
+            if (noise) {
+                for (; i + 4 <= n; i += 4) {
+                    const __m128 scaled =
+                        _mm_mul_ps(_mm_loadu_ps(in + i), factor);
+                    _mm_storeu_ps(out + i,
+                                  _mm_add_ps(scaled, _mm_loadu_ps(noise + i)));
+                }
+            } else {
+                for (; i + 4 <= n; i += 4) {
+                    _mm_storeu_ps(out + i,
+                                  _mm_mul_ps(_mm_loadu_ps(in + i), factor));
+                }
+            }
+            scaleScalar(in + i, n - i, scale, noise ? noise + i : nullptr,
+                        out + i);
+        }
+
+        __attribute__((target("avx2")))
+        void scaleAvx2(const float *const in, const std::size_t n,
+                       const float scale, const float *const noise,
+                       float *const out) {
+            const __m256 factor = _mm256_set1_ps(scale);
+            std::size_t i = 0;
+            if (noise) {
+                for (; i + 8 <= n; i += 8) {
+                    const __m256 scaled =
+                        _mm256_mul_ps(_mm256_loadu_ps(in + i), factor);
+                    _mm256_storeu_ps(
+                        out + i,
+                        _mm256_add_ps(scaled, _mm256_loadu_ps(noise + i)));
+                }
+            } else {
+                for (; i + 8 <= n; i += 8) {
+                    _mm256_storeu_ps(
+                        out + i,
+                        _mm256_mul_ps(_mm256_loadu_ps(in + i), factor));
+                }
+            }
+            scaleScalar(in + i, n - i, scale, noise ? noise + i : nullptr,
+                        out + i);
+        }
+
+#       endif
+
+        Kernel *kernelFor(const cpu::Isa isa) {
+            switch (isa) {
+#           ifdef HAVE_X86_SIMD_DISPATCH
+            case cpu::Isa::AVX2:
+                return scaleAvx2;
+            case cpu::Isa::SSE2:
+                return scaleSse2;
+#           endif
+            default:
+                return scaleScalar;
+            }
+        }
+
+        // The beam at an index of the scan made of 'left' followed by 'right'
+        inline float beamAt(const Span<const float> left,
+                            const Span<const float> right,
+                            const std::size_t i) {
+            return i < left.size() ? left[i] : right[i - left.size()];
+        }
+
+    }
+
+
+    void concatenateScaled(const Span<const float> left,
+                           const Span<const float> right, const float scale,
+                           const float *const noise, float *const out) {
+        // Probe the processor once, the first time through.
+        static const cpu::Isa isa = cpu::bestIsa();
+        concatenateScaled(isa, left, right, scale, noise, out);
+    }
+
+    void concatenateScaled(const cpu::Isa isa, const Span<const float> left,
+                           const Span<const float> right, const float scale,
+                           const float *const noise, float *const out) {
+        Kernel *const kernel = kernelFor(isa);
+        kernel(left.data(), left.size(), scale, noise, out);
+        kernel(right.data(), right.size(), scale,
+               noise ? noise + left.size() : nullptr, out + left.size());
+    }
+
+
+
+    // class BeamSelection
+
+    BeamSelection BeamSelection::all() {
+        return BeamSelection(Kind::ALL, 1, 0, 0, 0,
+                             std::vector<std::size_t>());
+    }
+
+    BeamSelection BeamSelection::stride(const std::size_t stride) {
+        return BeamSelection(Kind::STRIDE, stride, 0, 0, 0,
+                             std::vector<std::size_t>());
+    }
+
+    BeamSelection BeamSelection::window(const float sweep, const float from,
+                                        const float to) {
+        return BeamSelection(Kind::WINDOW, 1, sweep, from, to,
+                             std::vector<std::size_t>());
+    }
+
+    BeamSelection BeamSelection::list(std::vector<std::size_t> indices) {
+        return BeamSelection(Kind::LIST, 1, 0, 0, 0, std::move(indices));
+    }
+
+    BeamSelection::BeamSelection(const Kind kind, const std::size_t step,
+                                 const float sweep, const float from,
+                                 const float to,
+                                 std::vector<std::size_t> indices)
+        : kind(kind), step(step), sweep(sweep), from(from), to(to),
+          indices(std::move(indices)) {
+    }
+
+    std::size_t BeamSelection::count(const std::size_t nBeams) const {
+        std::size_t result;
+        if (kind == Kind::ALL) {
+            result = nBeams;
+        } else if (kind == Kind::STRIDE) {
+            result = (nBeams + step - 1) / step;
+        } else if (kind == Kind::WINDOW) {
+            std::size_t begin;
+            std::size_t end;
+            windowBounds(nBeams, begin, end);
+            result = end - begin;
+        } else {
+            if (! indices.empty() && indices.back() >= nBeams) {
+                throw std::invalid_argument(
+                    "beam " + std::to_string(indices.back())
+                    + " is past the end of a scan of "
+                    + std::to_string(nBeams) + " beams");
+            }
+            result = indices.size();
+        }
+        if (result == 0 && nBeams > 0) {
+            throw std::invalid_argument(
+                "the beam selection keeps none of a scan of "
+                + std::to_string(nBeams) + " beams");
+        }
+        return result;
+    }
+
+    void BeamSelection::selectScaled(const Span<const float> left,
+                                     const Span<const float> right,
+                                     const float scale,
+                                     float *const out) const {
+        const std::size_t nLeft = left.size();
+        if (kind == Kind::ALL) {
+            concatenateScaled(left, right, scale, nullptr, out);
+        } else if (kind == Kind::WINDOW) {
+            // A window is one run of beams, so it takes the vector kernels.
+            std::size_t begin;
+            std::size_t end;
+            windowBounds(nLeft + right.size(), begin, end);
+            const std::size_t leftBegin = std::min(begin, nLeft);
+            const std::size_t leftEnd = std::min(end, nLeft);
+            const std::size_t rightBegin = std::max(begin, nLeft) - nLeft;
+            const std::size_t rightEnd = std::max(end, nLeft) - nLeft;
+            concatenateScaled(
+                Span<const float>(left.data() + leftBegin,
+                                  leftEnd - leftBegin),
+                Span<const float>(right.data() + rightBegin,
+                                  rightEnd - rightBegin),
+                scale, nullptr, out);
+        } else if (kind == Kind::STRIDE) {
+            float *next = out;
+            std::size_t i = 0;
+            for (; i < nLeft; i += step) {
+                *next++ = left[i] * scale;
+            }
+            for (i -= nLeft; i < right.size(); i += step) {
+                *next++ = right[i] * scale;
+            }
+        } else {
+            for (std::size_t k = 0; k < indices.size(); k++) {
+                out[k] = beamAt(left, right, indices[k]) * scale;
+            }
+        }
+    }
+
+    void BeamSelection::windowBounds(const std::size_t nBeams,
+                                     std::size_t &begin,
+                                     std::size_t &end) const {
+        /* Beam i points at sweep/2 - (i + 1/2) * sweep/n degrees, so it is in
+         * the window when (sweep/2 - to) * n/sweep - 1/2 <= i <= (sweep/2 -
+         * from) * n/sweep - 1/2. */
+        const double n = static_cast<double>(nBeams);
+        const double first = std::ceil((sweep / 2.0 - to) * n / sweep - 0.5);
+        const double last = std::floor((sweep / 2.0 - from) * n / sweep - 0.5);
+        if (first <= 0) {
+            begin = 0;
+        } else if (first >= n) {
+            begin = nBeams;
+        } else {
+            begin = static_cast<std::size_t>(first);
+        }
+        if (last < 0) {
+            end = 0;
+        } else if (last >= n) {
+            end = nBeams;
+        } else {
+            end = static_cast<std::size_t>(last) + 1;
+        }
+        if (end < begin) {
+            end = begin;
+        }
+    }
+
+
+
+    // class Quantizer
+
+    const std::uint16_t Quantizer::MAX_STORED;
+
+    Quantizer::Quantizer(const float max)
+        : scale_(max / MAX_STORED) {
+    }
+
+    void Quantizer::quantize(const Span<const float> values,
+                             std::uint16_t *const out) const {
+        for (std::size_t i = 0; i < values.size(); i++) {
+            out[i] = quantize(values[i]);
+        }
+    }
+
+
+    void dequantize(const Span<const std::uint16_t> stored, const float scale,
+                    float *const out) {
+        for (std::size_t i = 0; i < stored.size(); i++) {
+            out[i] = dequantize(stored[i], scale);
+        }
+    }
+
+}
@@ -0,0 +1,146 @@
+/* lidar.h -- lidar preprocessing kernels
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifndef PPAML_VREP_AUTOMOBILE_PLUGIN_LIDAR_H
+#define PPAML_VREP_AUTOMOBILE_PLUGIN_LIDAR_H
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cstddef>
+#include <cstdint>
+
+#include <vector>
+
+#include "cpu.h"
+#include "span.h"
+
+namespace lidar {
+
+    /* Writes the elements of 'left' followed by those of 'right', each
+     * multiplied by 'scale' and, if 'noise' is non-null, then added to the
+     * corresponding element of 'noise', into 'out'.  'out' (and 'noise') must
+     * have room for left.size() + right.size() elements; 'noise' may be the
+     * same array as 'out', but the inputs must not otherwise overlap it.
+     *
+     * Every instruction set computes exactly the same result: each element is
+     * rounded once after the multiplication and once after the addition.
+     * (Where two NaNs meet, the result is a NaN, but IEEE 754 leaves open
+     * which of their payloads it carries.) */
+    void concatenateScaled(Span<const float> left, Span<const float> right,
+                           float scale, const float *noise, float *out);
+
+    // Like the above, but forces a particular instruction set.
+    void concatenateScaled(cpu::Isa, Span<const float> left,
+                           Span<const float> right, float scale,
+                           const float *noise, float *out);
+
+    /* Which beams of each scan to record.  A scan is the left input followed
+     * by the right one, as 'concatenateScaled' puts them together.  The
+     * selection is worked out against the length of each scan as it comes
+     * in, so one selection suits sensors of any resolution. */
+    class BeamSelection {
+    public:
+        // Every beam
+        static BeamSelection all();
+        // Every 'stride'th beam, starting with the first; 'stride' must be 1+.
+        static BeamSelection stride(std::size_t);
+        /* The beams pointing between 'from' and 'to' degrees, counted
+         * positive to the left of straight ahead, for a scan whose beams are
+         * spread evenly over 'sweep' degrees from the leftmost to the
+         * rightmost.  'sweep' must be in (0, 360] and 'from' no more than
+         * 'to'. */
+        static BeamSelection window(float sweep, float from, float to);
+        /* The beams at the passed indices, which must be strictly
+         * increasing. */
+        static BeamSelection list(std::vector<std::size_t>);
+
+        /* The number of beams selected from a scan of the passed length.
+         * Throws a 'std::invalid_argument' if a listed index is past the end
+         * of the scan, or if the selection keeps none of a non-empty scan. */
+        std::size_t count(std::size_t nBeams) const;
+
+        /* Writes the selected beams of the scan made of 'left' followed by
+         * 'right', each multiplied by 'scale', into 'out', which must have
+         * room for count(left.size() + right.size()) elements.  Each beam
+         * comes out exactly as 'concatenateScaled' would write it; everything
+         * and windows go through it directly. */
+        void selectScaled(Span<const float> left, Span<const float> right,
+                          float scale, float *out) const;
+
+    private:
+        enum class Kind {
+            ALL,
+            STRIDE,
+            WINDOW,
+            LIST
+        };
+
+        BeamSelection(Kind, std::size_t step, float sweep, float from,
+                      float to, std::vector<std::size_t> indices);
+
+        /* For a window, the first beam it keeps and one past the last, in a
+         * scan of the passed length */
+        void windowBounds(std::size_t nBeams, std::size_t &begin,
+                          std::size_t &end) const;
+
+        Kind kind;
+        std::size_t step;
+        float sweep;
+        float from;
+        float to;
+        std::vector<std::size_t> indices;
+    };
+
+    /* Lidar values stored as unsigned 16-bit integers.  A value is stored as
+     * its multiple of a fixed scale, rounded to the nearest integer and
+     * clamped to [0, MAX_STORED], so with a scale of max / MAX_STORED the
+     * values from 0 to max are kept to within half a step.  Readers get them
+     * back with 'dequantize', below. */
+    class Quantizer {
+    public:
+        static const std::uint16_t MAX_STORED = 65535;
+
+        /* Covers the values from 0 to 'max', which must be positive and
+         * finite. */
+        explicit Quantizer(float max);
+
+        // The value one step of the stored integers stands for
+        inline float scale() const;
+
+        inline std::uint16_t quantize(float) const;
+        // Quantizes each of the passed values into 'out'.
+        void quantize(Span<const float>, std::uint16_t *out) const;
+
+    private:
+        float scale_;
+    };
+
+    // The value stored as the passed integer with the passed scale
+    inline float dequantize(std::uint16_t stored, float scale);
+    // Dequantizes each of the passed integers into 'out'.
+    void dequantize(Span<const std::uint16_t>, float scale, float *out);
+
+}
+
+#include "lidar-inl.h"
+
+#endif
@@ -0,0 +1,579 @@
+/* lidarTest.cpp -- unit tests for the lidar preprocessing kernels
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "cpu.h"
+#include "lidar.h"
+#include "options.h"
+#include "span.h"
+#include "unitTest.h"
+
+namespace {
+
+    /* Each vector kernel must write exactly the bits the scalar kernel
+     * does, for every input--NaNs, infinities and subnormals included--so
+     * the data files are the same whichever processor wrote them.  The one
+     * exception is where two NaNs meet: IEEE 754 doesn't say whose payload
+     * the result carries, and compilers swap the operands of a
+     * multiplication freely, so there the result need only be a NaN. */
+
+    // Filler for the room past each output, so stray writes show up
+    const unsigned char GUARD_BYTE = 0xa5;
+    const std::size_t GUARD_SIZE = 16;
+
+    // Where the noise goes, relative to the output
+    enum class NoiseKind {
+        NONE,
+        SEPARATE,
+        IN_PLACE                // the output array holds the noise
+    };
+
+    class KernelComparison {
+    public:
+        explicit KernelComparison(cpu::Isa);
+
+        /* Runs the kernel and the scalar one on the passed scan, and fails
+         * unless they agree bit for bit. */
+        void check(const std::vector<float> &left,
+                   const std::vector<float> &right, float scale,
+                   const std::vector<float> &noise, NoiseKind);
+
+    private:
+        // How many of the inputs to an element of the output are NaNs
+        static unsigned int nNaNs(const std::vector<float> &left,
+                                  const std::vector<float> &right,
+                                  float scale,
+                                  const std::vector<float> &noise, NoiseKind,
+                                  std::size_t);
+
+        void run(cpu::Isa, const std::vector<float> &left,
+                 const std::vector<float> &right, float scale,
+                 const std::vector<float> &noise, NoiseKind,
+                 std::vector<float> &out) const;
+
+        const cpu::Isa isa;
+        std::vector<float> expected;
+        std::vector<float> actual;
+    };
+
+    // The bits of a float, for messages
+    std::string bits(float);
+
+    // Floats with uniformly random bit patterns, most of them unusual
+    std::vector<float> randomBits(std::mt19937 &, std::size_t n);
+    // Floats in the range of V-REP's scans
+    std::vector<float> typical(std::mt19937 &, std::size_t n);
+
+    /* Compares a kernel against the scalar one for every split of scans up
+     * to a few registers long, and a few scans as long as real ones. */
+    void compareWithScalar(cpu::Isa);
+
+    /* Fails unless the selection picks the beams at the expected indices,
+     * scaled, from a scan split into 'nLeft' beams on the left and 'nRight'
+     * on the right, and writes nothing past them. */
+    void expectSelects(const lidar::BeamSelection &, std::size_t nLeft,
+                       std::size_t nRight,
+                       const std::vector<std::size_t> &expected,
+                       const std::string &what);
+
+    // Fails unless counting the beams of a scan of 'n' throws.
+    void expectRejects(const lidar::BeamSelection &, std::size_t n,
+                       const std::string &what);
+
+    /* The beams a window keeps, worked out one beam at a time: beam i of n
+     * points at sweep/2 - (i + 1/2) * sweep/n degrees. */
+    std::vector<std::size_t> beamsInWindow(float sweep, float from, float to,
+                                           std::size_t n);
+
+    // The selection an options string's "beams" value makes
+    lidar::BeamSelection parseBeams(const std::string &value);
+
+    // The ways the test scans are split between left and right
+    const std::size_t SPLITS[][2] = {
+        {90, 90},
+        {100, 80},
+        {0, 180},
+        {180, 0},
+        {7, 6},
+    };
+
+
+    // Tests //
+
+    void sse2MatchesScalar() {
+        compareWithScalar(cpu::Isa::SSE2);
+    }
+
+    void avx2MatchesScalar() {
+        compareWithScalar(cpu::Isa::AVX2);
+    }
+
+    /* Values from 0 to the maximum come back from storage within half a
+     * step, and quantizing or dequantizing a run of values does just what
+     * doing them one at a time does. */
+    void quantizerStaysWithinHalfAStep() {
+        std::mt19937 random(25);
+        const float maxima[] = {1e-3f, 1, 10, 30, 32768, 65535, 1e6f, 3e38f};
+        for (const float max : maxima) {
+            const lidar::Quantizer quantizer(max);
+            const float scale = quantizer.scale();
+            std::uniform_real_distribution<float> pick(0, max);
+            std::vector<float> values(1000);
+            for (float &value : values) {
+                value = pick(random);
+            }
+            // The ends of the range, and the first tie
+            values[0] = 0;
+            values[1] = max;
+            values[2] = std::nextafter(max, 0.0f);
+            values[3] = scale / 2;
+            std::vector<std::uint16_t> stored(values.size());
+            quantizer.quantize(values, stored.data());
+            std::vector<float> restored(values.size());
+            lidar::dequantize(stored, scale, restored.data());
+            for (std::size_t i = 0; i < values.size(); i++) {
+                unitTest::expect(stored[i] == quantizer.quantize(values[i])
+                                 && restored[i]
+                                    == lidar::dequantize(stored[i], scale),
+                                 "runs differ from single values");
+                /* Rounding to a step is off by half a step at most, and
+                 * the product by half an ulp. */
+                const double error =
+                    std::fabs(static_cast<double>(restored[i]) - values[i]);
+                const double ulp = std::nextafter(
+                    restored[i], std::numeric_limits<float>::infinity())
+                    - restored[i];
+                unitTest::expect(error <= scale / 2.0 * (1 + 1e-9) + ulp / 2,
+                                 bits(values[i]) + " came back as "
+                                 + bits(restored[i]) + " with a maximum of "
+                                 + bits(max));
+            }
+            unitTest::expect(
+                stored[0] == 0 && stored[1] == lidar::Quantizer::MAX_STORED,
+                "the ends of the range with a maximum of " + bits(max)
+                + " are stored as " + std::to_string(stored[0]) + " and "
+                + std::to_string(stored[1]));
+        }
+    }
+
+    /* Values past the maximum are stored as the largest integer, and
+     * negative values and NaNs as 0. */
+    void quantizerClamps() {
+        const float inf = std::numeric_limits<float>::infinity();
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        const lidar::Quantizer quantizer(10);
+        const float scale = quantizer.scale();
+        const float high[] = {10, std::nextafter(10.0f, inf), 11, 1e30f, inf};
+        for (const float value : high) {
+            unitTest::expect(
+                quantizer.quantize(value) == lidar::Quantizer::MAX_STORED,
+                bits(value) + " not stored as the maximum");
+        }
+        const float low[] = {
+            0, -0.0f, -std::numeric_limits<float>::denorm_min(), -1, -inf,
+            nan, -nan, std::numeric_limits<float>::denorm_min(),
+            scale * 0.49f,
+        };
+        for (const float value : low) {
+            unitTest::expect(quantizer.quantize(value) == 0,
+                             bits(value) + " not stored as 0");
+        }
+        unitTest::expect(quantizer.quantize(scale * 0.51f) == 1,
+                         "just over half a step not stored as 1");
+        // Runs clamp the same way.
+        std::vector<float> values(high, high + sizeof high / sizeof high[0]);
+        values.insert(values.end(), low, low + sizeof low / sizeof low[0]);
+        std::vector<std::uint16_t> stored(values.size());
+        quantizer.quantize(values, stored.data());
+        for (std::size_t i = 0; i < values.size(); i++) {
+            unitTest::expect(stored[i] == quantizer.quantize(values[i]),
+                             bits(values[i]) + " stored differently in a "
+                             "run");
+        }
+    }
+
+    /* A stride keeps every so many beams across the whole scan, however it
+     * is split. */
+    void selectsStride() {
+        const std::size_t strides[] = {1, 2, 3, 7, 179, 180, 1000};
+        for (const std::size_t *const split : SPLITS) {
+            const std::size_t n = split[0] + split[1];
+            for (const std::size_t stride : strides) {
+                std::vector<std::size_t> expected;
+                for (std::size_t i = 0; i < n; i += stride) {
+                    expected.push_back(i);
+                }
+                expectSelects(lidar::BeamSelection::stride(stride), split[0],
+                              split[1], expected,
+                              "stride " + std::to_string(stride));
+            }
+        }
+    }
+
+    /* A window keeps the beams pointing into it, including when it spans
+     * the left and right inputs. */
+    void selectsWindow() {
+        const float windows[][3] = {
+            {180, 30, 60},              // on the left
+            {180, -60, -30},            // on the right
+            {180, -10, 10},             // across the split
+            {180, -90, 90},             // everything
+            {180, -200, 200},           // past both ends
+            {180, 0, 0},                // between two beams
+            {270, -100, 3},
+            {360, 170, 180},
+        };
+        for (const std::size_t *const split : SPLITS) {
+            const std::size_t n = split[0] + split[1];
+            for (const float *const window : windows) {
+                const lidar::BeamSelection selection =
+                    lidar::BeamSelection::window(window[0], window[1],
+                                                 window[2]);
+                const std::vector<std::size_t> expected =
+                    beamsInWindow(window[0], window[1], window[2], n);
+                const std::string what =
+                    "window " + std::to_string(window[1]) + " to "
+                    + std::to_string(window[2]) + " of "
+                    + std::to_string(window[0]);
+                if (expected.empty()) {
+                    expectRejects(selection, n, what);
+                } else {
+                    expectSelects(selection, split[0], split[1], expected,
+                                  what);
+                }
+            }
+        }
+        // A window off the edge keeps nothing.
+        expectRejects(lidar::BeamSelection::window(180, 100, 120), 180,
+                      "window past the left edge");
+    }
+
+    /* A list keeps just the listed beams, and an index past the end of the
+     * scan is an error. */
+    void selectsList() {
+        const std::size_t listed[] = {0, 3, 6, 12, 89, 90, 91, 179};
+        const std::vector<std::size_t> indices(
+            listed, listed + sizeof listed / sizeof listed[0]);
+        const lidar::BeamSelection selection =
+            lidar::BeamSelection::list(indices);
+        for (const std::size_t *const split : SPLITS) {
+            if (split[0] + split[1] > indices.back()) {
+                expectSelects(selection, split[0], split[1], indices,
+                              "list");
+            }
+        }
+        expectRejects(selection, 179, "list past the end");
+        expectRejects(lidar::BeamSelection::list(std::vector<std::size_t>()),
+                      180, "empty list");
+    }
+
+    // The "beams" option makes the selections above, and rejects nonsense.
+    void parsesBeams() {
+        std::vector<std::size_t> expected;
+        for (std::size_t i = 0; i < 180; i++) {
+            expected.push_back(i);
+        }
+        expectSelects(parseBeams("all"), 90, 90, expected, "beams=all");
+        expected.clear();
+        for (std::size_t i = 0; i < 180; i += 3) {
+            expected.push_back(i);
+        }
+        expectSelects(parseBeams("stride:3"), 90, 90, expected,
+                      "beams=stride:3");
+        expectSelects(parseBeams("window:180:-10:10.5"), 90, 90,
+                      beamsInWindow(180, -10, 10.5f, 180),
+                      "beams=window:180:-10:10.5");
+        const std::size_t listed[] = {0, 4, 10, 11, 12, 13, 15};
+        expectSelects(parseBeams("list:0;4;10-13;15"), 10, 10,
+                      std::vector<std::size_t>(
+                          listed, listed + sizeof listed / sizeof listed[0]),
+                      "beams=list:0;4;10-13;15");
+        const char *const bad[] = {
+            "", "none", "stride", "stride:", "stride:0", "stride:-1",
+            "stride:2x", "window:180:0", "window:180:0:1:2", "window:0:0:1",
+            "window:361:0:1", "window:180:10:-10", "window:180:nan:1",
+            "window:180:0:inf", "list:", "list:a", "list:5;3", "list:3;3",
+            "list:4-2", "list:1-", "list:-1", "list:0-99999999999",
+            "bogus:1",
+        };
+        for (const char *const value : bad) {
+            bool threw = false;
+            try {
+                parseBeams(value);
+            } catch (const std::invalid_argument &) {
+                threw = true;
+            }
+            unitTest::expect(threw, std::string("beams=") + value
+                             + " accepted");
+        }
+    }
+
+    const unitTest::Test TESTS[] = {
+        {"lidar::concatenateScaled/sse2", sse2MatchesScalar},
+        {"lidar::concatenateScaled/avx2", avx2MatchesScalar},
+        {"lidar::Quantizer/errorBound", quantizerStaysWithinHalfAStep},
+        {"lidar::Quantizer/clamp", quantizerClamps},
+        {"lidar::BeamSelection/stride", selectsStride},
+        {"lidar::BeamSelection/window", selectsWindow},
+        {"lidar::BeamSelection/list", selectsList},
+        {"lidar::BeamSelection/parse", parsesBeams},
+    };
+
+}
+
+namespace unitTest {
+
+    const Span<const Test> lidarTests(TESTS, sizeof TESTS / sizeof TESTS[0]);
+
+}
+
+
+namespace {
+
+    void compareWithScalar(const cpu::Isa isa) {
+        unitTest::requireIsa(isa);
+        std::mt19937 random(20140601);
+        KernelComparison comparison(isa);
+        const float scales[] = {
+            1, 0.5f, 0.3f, -0.0f, 1e-30f,             // subnormal products
+            3e38f,                                    // overflowing ones
+            std::numeric_limits<float>::infinity(),
+            std::numeric_limits<float>::quiet_NaN(),
+            std::numeric_limits<float>::denorm_min(),
+        };
+        const NoiseKind noiseKinds[] = {
+            NoiseKind::NONE,
+            NoiseKind::SEPARATE,
+            NoiseKind::IN_PLACE,
+        };
+        // Past two AVX2 registers, plus every possible tail
+        const std::size_t MAX_SHORT = 19;
+        for (std::size_t nLeft = 0; nLeft <= MAX_SHORT; nLeft++) {
+            for (std::size_t nRight = 0; nRight <= MAX_SHORT; nRight++) {
+                const std::size_t n = nLeft + nRight;
+                for (const float scale : scales) {
+                    for (const NoiseKind noiseKind : noiseKinds) {
+                        comparison.check(randomBits(random, nLeft),
+                                         randomBits(random, nRight), scale,
+                                         randomBits(random, n), noiseKind);
+                        comparison.check(typical(random, nLeft),
+                                         typical(random, nRight), scale,
+                                         typical(random, n), noiseKind);
+                    }
+                }
+            }
+        }
+        const std::size_t longScans[][2] = {
+            {90, 90},
+            {512, 512},
+            {1031, 517},
+        };
+        for (const std::size_t *const sizes : longScans) {
+            const std::size_t n = sizes[0] + sizes[1];
+            for (const NoiseKind noiseKind : noiseKinds) {
+                comparison.check(randomBits(random, sizes[0]),
+                                 randomBits(random, sizes[1]), 0.3f,
+                                 randomBits(random, n), noiseKind);
+                comparison.check(typical(random, sizes[0]),
+                                 typical(random, sizes[1]), 10,
+                                 typical(random, n), noiseKind);
+            }
+        }
+    }
+
+    void expectSelects(const lidar::BeamSelection &selection,
+                       const std::size_t nLeft, const std::size_t nRight,
+                       const std::vector<std::size_t> &expected,
+                       const std::string &what) {
+        const std::string scan = " of " + std::to_string(nLeft) + "+"
+            + std::to_string(nRight) + " beams";
+        const std::size_t count = selection.count(nLeft + nRight);
+        unitTest::expect(count == expected.size(),
+                         what + " counts " + std::to_string(count)
+                         + " beams" + scan + ", not "
+                         + std::to_string(expected.size()));
+        // Each beam holds its own index, so it shows where it came from.
+        std::vector<float> left(nLeft);
+        std::vector<float> right(nRight);
+        for (std::size_t i = 0; i < nLeft + nRight; i++) {
+            (i < nLeft ? left[i] : right[i - nLeft]) = static_cast<float>(i);
+        }
+        const float scale = 0.5f;
+        std::vector<float> out(count + GUARD_SIZE);
+        std::memset(out.data(), GUARD_BYTE, out.size() * sizeof(float));
+        selection.selectScaled(left, right, scale, out.data());
+        for (std::size_t k = 0; k < count; k++) {
+            unitTest::expect(out[k] == expected[k] * scale,
+                             what + " picked beam "
+                             + std::to_string(out[k] / scale) + " instead of "
+                             + std::to_string(expected[k]) + scan);
+        }
+        for (std::size_t k = count; k < out.size(); k++) {
+            unsigned char bytes[sizeof(float)];
+            std::memcpy(bytes, &out[k], sizeof bytes);
+            for (const unsigned char byte : bytes) {
+                unitTest::expect(byte == GUARD_BYTE,
+                                 what + " wrote past its beams" + scan);
+            }
+        }
+    }
+
+    void expectRejects(const lidar::BeamSelection &selection,
+                       const std::size_t n, const std::string &what) {
+        bool threw = false;
+        try {
+            selection.count(n);
+        } catch (const std::invalid_argument &) {
+            threw = true;
+        }
+        unitTest::expect(threw, what + " accepted for a scan of "
+                         + std::to_string(n) + " beams");
+    }
+
+    std::vector<std::size_t> beamsInWindow(const float sweep,
+                                           const float from, const float to,
+                                           const std::size_t n) {
+        std::vector<std::size_t> result;
+        for (std::size_t i = 0; i < n; i++) {
+            const double angle = sweep / 2.0 - (i + 0.5) * sweep / n;
+            if (from <= angle && angle <= to) {
+                result.push_back(i);
+            }
+        }
+        return result;
+    }
+
+    lidar::BeamSelection parseBeams(const std::string &value) {
+        return parseOptions("beams=" + value).beams;
+    }
+
+    std::string bits(const float x) {
+        std::uint32_t pattern;
+        std::memcpy(&pattern, &x, sizeof pattern);
+        char buffer[11];
+        std::snprintf(buffer, sizeof buffer, "0x%08lx",
+                      static_cast<unsigned long>(pattern));
+        return buffer;
+    }
+
+    std::vector<float> randomBits(std::mt19937 &random, const std::size_t n) {
+        std::vector<float> result(n);
+        for (float &x : result) {
+            const std::uint32_t pattern = random();
+            std::memcpy(&x, &pattern, sizeof x);
+        }
+        return result;
+    }
+
+    std::vector<float> typical(std::mt19937 &random, const std::size_t n) {
+        std::uniform_real_distribution<float> fraction(0, 1);
+        std::vector<float> result(n);
+        for (float &x : result) {
+            x = fraction(random);
+        }
+        return result;
+    }
+
+
+    // class KernelComparison
+
+    KernelComparison::KernelComparison(const cpu::Isa isa)
+        : isa(isa), expected(), actual() {
+    }
+
+    void KernelComparison::check(const std::vector<float> &left,
+                                 const std::vector<float> &right,
+                                 const float scale,
+                                 const std::vector<float> &noise,
+                                 const NoiseKind noiseKind) {
+        run(cpu::Isa::SCALAR, left, right, scale, noise, noiseKind,
+            expected);
+        run(isa, left, right, scale, noise, noiseKind, actual);
+        const std::size_t n = left.size() + right.size();
+        for (std::size_t i = 0; i < n + GUARD_SIZE; i++) {
+            if (std::memcmp(&expected[i], &actual[i], sizeof(float)) != 0
+                && ! (i < n && std::isnan(expected[i])
+                      && std::isnan(actual[i])
+                      && nNaNs(left, right, scale, noise, noiseKind, i)
+                         >= 2)) {
+                unitTest::expect(
+                    false,
+                    std::string(cpu::name(isa)) + " wrote "
+                    + bits(actual[i]) + " instead of " + bits(expected[i])
+                    + " at " + std::to_string(i) + " of "
+                    + std::to_string(left.size()) + "+"
+                    + std::to_string(right.size()) + " beams scaled by "
+                    + bits(scale));
+            }
+        }
+    }
+
+    unsigned int KernelComparison::nNaNs(const std::vector<float> &left,
+                                         const std::vector<float> &right,
+                                         const float scale,
+                                         const std::vector<float> &noise,
+                                         const NoiseKind noiseKind,
+                                         const std::size_t i) {
+        const float beam =
+            i < left.size() ? left[i] : right[i - left.size()];
+        unsigned int result = std::isnan(beam) + std::isnan(scale);
+        if (noiseKind != NoiseKind::NONE) {
+            result += std::isnan(noise[i]);
+        }
+        return result;
+    }
+
+    void KernelComparison::run(const cpu::Isa kernel,
+                               const std::vector<float> &left,
+                               const std::vector<float> &right,
+                               const float scale,
+                               const std::vector<float> &noise,
+                               const NoiseKind noiseKind,
+                               std::vector<float> &out) const {
+        const std::size_t n = left.size() + right.size();
+        out.resize(n + GUARD_SIZE);
+        std::memset(out.data(), GUARD_BYTE, out.size() * sizeof(float));
+        const float *noiseData = nullptr;
+        if (noiseKind == NoiseKind::SEPARATE) {
+            noiseData = noise.data();
+        } else if (noiseKind == NoiseKind::IN_PLACE) {
+            std::memcpy(out.data(), noise.data(), n * sizeof(float));
+            noiseData = out.data();
+        }
+        lidar::concatenateScaled(kernel, left, right, scale, noiseData,
+                                 out.data());
+    }
+
+}
@@ -89,10 +89,44 @@ unsigned char v_repStart(void *, int) {
 }
 
 void v_repEnd() {
+    try {
+        finishRecording();
+    } catch (const std::exception &error) {
+        // We're shutting down anyway; there's nobody left to tell.
+    }
     unloadVrepLibrary(vrepLibrary);
 }
 
-void *v_repMessage(int, int *, void *, int *) {
+void *v_repMessage(int message, int *, void *, int *) {
+    try {
+        switch (message) {
+        case sim_message_eventcallback_simulationabouttostart:
+            /* Start the simulation from a clean slate, with anything saved
+             * outside it written and closed.
+             *
+             * The run's own files can't be opened yet: their directory and
+             * options only arrive with simExtAutomobileInit, which scripts
+             * call in their first step.  Reopening the vehicles of the last
+             * run instead would mean wiping their data before any script had
+             * asked to record there again, so simExtAutomobileInit opens the
+             * files, before the first save. */
+            finishRecording();
+            break;
+        case sim_message_eventcallback_simulationabouttoend:
+            /* Get the bulk of the writing done now, while scripts may still
+             * save a last datum or two in their cleanup. */
+            drainRecording();
+            break;
+        case sim_message_eventcallback_simulationended:
+            finishRecording();
+            break;
+        default:
+            break;
+        }
+    } catch (const std::exception &error) {
+        /* Exceptions must not propagate into V-REP.  The data written so far
+         * is as good as it's going to get. */
+    }
     return nullptr;
 }
 
@@ -21,42 +21,92 @@
 #ifndef PPAML_VREP_AUTOMOBILE_PLUGIN_MEASUREMENT_INL_H
 #define PPAML_VREP_AUTOMOBILE_PLUGIN_MEASUREMENT_INL_H
 
-std::string Pose::csvHeader() const {
-    return csvHeader_;
+float Pose::timestamp() const {
+    return time;
 }
 
-std::string Pose::csv() const {
-#   ifdef HAVE_CXX11_INITIALIZER_LISTS
-        return csv::fromContainer(std::vector<float> {time, y, x, theta});
-#   else
-        return csv::fromContainer(makeList<float>(nCols(), time, y, x, theta));
-#   endif
+void Pose::appendTo(arrowIpc::BatchBuilder &batch) const {
+    batch.put(time);
+    batch.put(y);
+    batch.put(x);
+    batch.put(theta);
 }
 
-unsigned int Pose::nCols() const {
-    return 4;
+float ControlSignals::timestamp() const {
+    return time;
 }
 
-std::string ControlSignals::csvHeader() const {
-    return csvHeader_;
+void ControlSignals::appendTo(arrowIpc::BatchBuilder &batch) const {
+    batch.put(time);
+    batch.put(speed);
+    batch.put(steeringAngle);
 }
 
-std::string ControlSignals::csv() const {
-#   ifdef HAVE_CXX11_INITIALIZER_LISTS
-        return csv::fromContainer(
-            std::vector<float> {time, speed, steeringAngle});
-#   else
-        return csv::fromContainer(
-            makeList<float>(nCols(), time, speed, steeringAngle));
-#   endif
+float LidarDatum::timestamp() const {
+    return time;
 }
 
-unsigned int ControlSignals::nCols() const {
-    return 3;
+void LidarDatum::appendTo(arrowIpc::BatchBuilder &batch) const {
+    batch.put(time);
+    batch.put(distance.data(), distance.size());
+    batch.put(intensity.data(), intensity.size());
 }
 
-unsigned int LidarDatum::nCols() const {
-    return 1 + distance.size() + intensity.size();
+QuantizedLidarDatum::QuantizedLidarDatum()
+    : ::Datum(0), distance(), intensity() {
+}
+
+float QuantizedLidarDatum::timestamp() const {
+    return time;
+}
+
+void QuantizedLidarDatum::appendTo(arrowIpc::BatchBuilder &batch) const {
+    batch.put(time);
+    batch.put(distance.data(), distance.size());
+    batch.put(intensity.data(), intensity.size());
+}
+
+
+// CSV schemas //
+
+namespace csv {
+
+    void Schema<Pose>::write(Row &row, const Pose &pose) {
+        row.put(pose.time);
+        row.put(pose.y);
+        row.put(pose.x);
+        row.put(pose.theta);
+    }
+
+    void Schema<ControlSignals>::write(Row &row,
+                                       const ControlSignals &signals) {
+        row.put(signals.time);
+        row.put(signals.speed);
+        row.put(signals.steeringAngle);
+    }
+
+    unsigned int Schema<LidarDatum>::nCols(const LidarDatum &datum) {
+        return 1 + datum.distance.size() + datum.intensity.size();
+    }
+
+    void Schema<LidarDatum>::write(Row &row, const LidarDatum &datum) {
+        row.put(datum.time);
+        row.put(datum.distance.data(), datum.distance.size());
+        row.put(datum.intensity.data(), datum.intensity.size());
+    }
+
+    unsigned int Schema<QuantizedLidarDatum>::nCols(
+            const QuantizedLidarDatum &datum) {
+        return 1 + datum.distance.size() + datum.intensity.size();
+    }
+
+    void Schema<QuantizedLidarDatum>::write(Row &row,
+                                            const QuantizedLidarDatum &datum) {
+        row.put(datum.time);
+        row.put(datum.distance.data(), datum.distance.size());
+        row.put(datum.intensity.data(), datum.intensity.size());
+    }
+
 }
 
 #endif
@@ -22,47 +22,111 @@
 #   include <config.h>
 #endif
 
-#include <array>
+#include <cstddef>
+
 #include <string>
 #include <vector>
 
+#include "arrowIpc.h"
 #include "csv.h"
+#include "lidar.h"
 #include "measurement.h"
 
-const std::string Pose::csvHeader_ = "TimeGPS,GPSLat,GPSLon,Orientation";
-
-const std::string ControlSignals::csvHeader_ = "Time_VS,Velocity,Steering";
-
-std::string LidarDatum::csvHeader() const {
-    std::string result;
-    const std::string timeLaserHeader = "TimeLaser";
-    const std::string distanceHeader = "Laser";
-    const std::string intensityHeader = "Intensity";
-    result.reserve(timeLaserHeader.size()
-                   + distance.size() * (1 + distanceHeader.size())
-                   + intensity.size() * (1 + intensityHeader.size()));
-    result.append(timeLaserHeader);
-    for (std::vector<float>::size_type i = 0; i < distance.size(); i++) {
-        result.append(",");
-        result.append(distanceHeader);
-    }
-    for (std::vector<float>::size_type i = 0; i < intensity.size(); i++) {
-        result.append(",");
-        result.append(intensityHeader);
+namespace {
+
+    // The schema of a lidar file, whose beams are stored as the passed type
+    arrowIpc::Schema lidarSchema(const arrowIpc::Type type,
+                                 const std::size_t nDistances,
+                                 const std::size_t nIntensities) {
+        /* The beams go in fixed-size list columns rather than one column
+         * apiece. */
+        arrowIpc::Schema result;
+        result.push_back(arrowIpc::Field("TimeLaser",
+                                         arrowIpc::Type::FLOAT32));
+        result.push_back(arrowIpc::Field("Laser", type, nDistances));
+        result.push_back(arrowIpc::Field("Intensity", type, nIntensities));
+        return result;
     }
-    return result;
-}
 
-std::string LidarDatum::csv() const {
-    std::string result = std::to_string(time);
-    /* Yes, there are double braces in the initializer on the next line.  See
-     * <http://stackoverflow.com/questions/11400090>. */
-    const std::array<std::vector<float>, 2> dataSets = {{distance, intensity}};
-    for (const std::vector<float> &data : dataSets) {
-        if (! data.empty()) {
+    // The CSV header of a lidar file: a column per beam for each quantity
+    std::string lidarHeader(const std::size_t nDistances,
+                            const std::size_t nIntensities) {
+        std::string result;
+        const std::string timeLaserHeader = "TimeLaser";
+        const std::string distanceHeader = "Laser";
+        const std::string intensityHeader = "Intensity";
+        result.reserve(timeLaserHeader.size()
+                       + nDistances * (1 + distanceHeader.size())
+                       + nIntensities * (1 + intensityHeader.size()));
+        result.append(timeLaserHeader);
+        for (std::size_t i = 0; i < nDistances; i++) {
+            result.append(",");
+            result.append(distanceHeader);
+        }
+        for (std::size_t i = 0; i < nIntensities; i++) {
             result.append(",");
-            result.append(csv::fromContainer(data));
+            result.append(intensityHeader);
         }
+        return result;
     }
+
+}
+
+arrowIpc::Schema Pose::arrowSchema() const {
+    arrowIpc::Schema result;
+    result.push_back(arrowIpc::Field("TimeGPS", arrowIpc::Type::FLOAT32));
+    result.push_back(arrowIpc::Field("GPSLat", arrowIpc::Type::FLOAT32));
+    result.push_back(arrowIpc::Field("GPSLon", arrowIpc::Type::FLOAT32));
+    result.push_back(arrowIpc::Field("Orientation", arrowIpc::Type::FLOAT32));
     return result;
 }
+
+arrowIpc::Schema ControlSignals::arrowSchema() const {
+    arrowIpc::Schema result;
+    result.push_back(arrowIpc::Field("Time_VS", arrowIpc::Type::FLOAT32));
+    result.push_back(arrowIpc::Field("Velocity", arrowIpc::Type::FLOAT32));
+    result.push_back(arrowIpc::Field("Steering", arrowIpc::Type::FLOAT32));
+    return result;
+}
+
+arrowIpc::Schema LidarDatum::arrowSchema() const {
+    return lidarSchema(arrowIpc::Type::FLOAT32, distance.size(),
+                       intensity.size());
+}
+
+void QuantizedLidarDatum::assign(const LidarDatum &scan,
+                                 const lidar::Quantizer &distanceQuantizer,
+                                 const lidar::Quantizer &intensityQuantizer) {
+    time = scan.time;
+    distance.resize(scan.distance.size());
+    distanceQuantizer.quantize(scan.distance, distance.data());
+    intensity.resize(scan.intensity.size());
+    intensityQuantizer.quantize(scan.intensity, intensity.data());
+}
+
+arrowIpc::Schema QuantizedLidarDatum::arrowSchema() const {
+    return lidarSchema(arrowIpc::Type::UINT16, distance.size(),
+                       intensity.size());
+}
+
+
+// CSV schemas //
+
+namespace csv {
+
+    const char *const Schema<Pose>::COLUMNS[] =
+        {"TimeGPS", "GPSLat", "GPSLon", "Orientation"};
+
+    const char *const Schema<ControlSignals>::COLUMNS[] =
+        {"Time_VS", "Velocity", "Steering"};
+
+    std::string Schema<LidarDatum>::header(const LidarDatum &datum) {
+        return lidarHeader(datum.distance.size(), datum.intensity.size());
+    }
+
+    std::string Schema<QuantizedLidarDatum>::header(
+            const QuantizedLidarDatum &datum) {
+        return lidarHeader(datum.distance.size(), datum.intensity.size());
+    }
+
+}
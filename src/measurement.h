@@ -25,10 +25,15 @@
 #   include <config.h>
 #endif
 
+#include <cstdint>
+
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "arrowIpc.h"
 #include "csv.h"
+#include "lidar.h"
 
 // Base class for time-series data
 struct Datum {
@@ -38,10 +43,17 @@ struct Datum {
     float time;
 };
 
+/* Interface: Any datum which can be written in every output format.  The CSV
+ * columns come from the type's csv::Schema, below. */
+struct Record : public arrowIpc::Datum {
+    // The time the record was taken, under which it is indexed
+    virtual float timestamp() const = 0;
+};
+
 
 // Datum definitions //
 
-class Pose : public Datum, public csv::Datum {
+class Pose : public Datum, public Record {
 public:
     inline Pose(float time, float x, float y, float theta)
         : ::Datum(time), x(x), y(y), theta(theta) {
@@ -49,45 +61,93 @@ public:
     float x;
     float y;
     float theta;
-    inline virtual std::string csvHeader() const;
-    inline virtual std::string csv() const;
-    inline virtual unsigned int nCols() const;
-
-protected:
-    static const std::string csvHeader_;
+    inline virtual float timestamp() const;
+    virtual arrowIpc::Schema arrowSchema() const;
+    inline virtual void appendTo(arrowIpc::BatchBuilder &) const;
 };
 
 
-class ControlSignals : public Datum, public csv::Datum {
+class ControlSignals : public Datum, public Record {
 public:
     inline ControlSignals(float time, float speed, float steeringAngle)
         : ::Datum(time), speed(speed), steeringAngle(steeringAngle) {
     }
     float speed;
     float steeringAngle;
-    inline virtual std::string csvHeader() const;
-    inline virtual std::string csv() const;
-    inline virtual unsigned int nCols() const;
-
-protected:
-    static const std::string csvHeader_;
+    inline virtual float timestamp() const;
+    virtual arrowIpc::Schema arrowSchema() const;
+    inline virtual void appendTo(arrowIpc::BatchBuilder &) const;
 };
 
 
-class LidarDatum : public Datum, public csv::Datum {
+class LidarDatum : public Datum, public Record {
 public:
     inline LidarDatum(float time, std::vector<float> distance,
                       std::vector<float> intensity)
-        : ::Datum(time), distance(distance), intensity(intensity) {
+        : ::Datum(time), distance(std::move(distance)),
+          intensity(std::move(intensity)) {
     }
     std::vector<float> distance;
     std::vector<float> intensity;
-    virtual std::string csvHeader() const;
-    inline virtual std::string csv() const;
-    inline virtual unsigned int nCols() const;
+    inline virtual float timestamp() const;
+    virtual arrowIpc::Schema arrowSchema() const;
+    inline virtual void appendTo(arrowIpc::BatchBuilder &) const;
 };
 
 
+/* A lidar scan with its beams stored as 16-bit integers (see
+ * lidar::Quantizer).  Its columns are named like a LidarDatum's. */
+class QuantizedLidarDatum : public Datum, public Record {
+public:
+    inline QuantizedLidarDatum();
+    /* Quantizes a scan into this datum, reusing the storage of the scan it
+     * held before. */
+    void assign(const LidarDatum &, const lidar::Quantizer &distance,
+                const lidar::Quantizer &intensity);
+    std::vector<std::uint16_t> distance;
+    std::vector<std::uint16_t> intensity;
+    inline virtual float timestamp() const;
+    virtual arrowIpc::Schema arrowSchema() const;
+    inline virtual void appendTo(arrowIpc::BatchBuilder &) const;
+};
+
+
+// CSV schemas //
+
+namespace csv {
+
+    template<>
+    struct Schema<Pose> : public FixedSchema<Pose, 4> {
+        static const char *const COLUMNS[N_COLS];
+        static inline void write(Row &, const Pose &);
+    };
+
+    template<>
+    struct Schema<ControlSignals> : public FixedSchema<ControlSignals, 3> {
+        static const char *const COLUMNS[N_COLS];
+        static inline void write(Row &, const ControlSignals &);
+    };
+
+    /* A scan has a column per beam for the distances and another per beam for
+     * the intensities, so its header is built from the first scan written to
+     * a file. */
+    template<>
+    struct Schema<LidarDatum> {
+        static inline unsigned int nCols(const LidarDatum &);
+        static std::string header(const LidarDatum &);
+        static inline void write(Row &, const LidarDatum &);
+    };
+
+    template<>
+    struct Schema<QuantizedLidarDatum> {
+        static inline unsigned int nCols(const QuantizedLidarDatum &);
+        static std::string header(const QuantizedLidarDatum &);
+        static inline void write(Row &, const QuantizedLidarDatum &);
+    };
+
+}
+
+
 #include "measurement-inl.h"
 
 #endif
@@ -25,26 +25,34 @@
 #   include <config.h>
 #endif
 
-template<typename RealType>
-GaussianNoiseSource<RealType>::GaussianNoiseSource(RealType mean,
-                                                   RealType stddev)
-	: generator(), distribution(mean, stddev) {
-    generator.seed(std::random_device()());
+GaussianNoiseSource::GaussianNoiseSource(const float mean, const float stddev,
+                                         const std::uint64_t seed,
+                                         const std::uint64_t stream)
+    : mean(mean), stddev(stddev), sampler(seed, stream) {
 }
 
-template<typename RealType>
-RealType GaussianNoiseSource<RealType>::get() {
-    return distribution(generator);
+float GaussianNoiseSource::get() {
+    return sampler.next(mean, stddev);
 }
 
-GaussianNoiseSource<float> gaussian(const std::vector<float> params) {
+void GaussianNoiseSource::fill(const Span<float> out) {
+    sampler.fill(out, mean, stddev);
+}
+
+std::uint32_t randomSeed() {
+    return std::random_device()() & 0x7FFFFFFF;
+}
+
+GaussianNoiseSource gaussian(const std::vector<float> params,
+                             const std::uint64_t seed,
+                             const std::uint64_t stream) {
     if (params.size() != 2) {
         throw std::invalid_argument(std::string()
             + "expected two-element vector of distribution parameters "
             + "(got " + std::to_string(params.size()) + "-element "
             + "vector instead");
     } else {
-        return GaussianNoiseSource<float>(params[0], params[1]);
+        return GaussianNoiseSource(params[0], params[1], seed, stream);
     }
 }
 
@@ -22,16 +22,17 @@
 #   include <config.h>
 #endif
 
-#ifdef HAVE_CXX11_CLOSURES
-#   include <algorithm>
-#endif
+#include <utility>
+#include <vector>
 
+#include "lidar.h"
 #include "measurement.h"
 #include "noise.h"
+#include "span.h"
 
 Pose addNoise(const Pose &pose,
-              GaussianNoiseSource<float> &positionNoise,
-              GaussianNoiseSource<float> &angleNoise) {
+              GaussianNoiseSource &positionNoise,
+              GaussianNoiseSource &angleNoise) {
     Pose result = pose;
     result.x += positionNoise.get();
     result.y += positionNoise.get();
@@ -40,8 +41,8 @@ Pose addNoise(const Pose &pose,
 }
 
 ControlSignals addNoise(const ControlSignals &signals,
-                        GaussianNoiseSource<float> &speedNoise,
-                        GaussianNoiseSource<float> &steeringAngleNoise) {
+                        GaussianNoiseSource &speedNoise,
+                        GaussianNoiseSource &steeringAngleNoise) {
     ControlSignals result = signals;
     result.speed += speedNoise.get();
     result.steeringAngle += steeringAngleNoise.get();
@@ -49,25 +50,17 @@ ControlSignals addNoise(const ControlSignals &signals,
 }
 
 LidarDatum addNoise(const LidarDatum &datum,
-                    GaussianNoiseSource<float> &distanceNoise,
-                    GaussianNoiseSource<float> &intensityNoise) {
-    LidarDatum result = datum;
-#   ifdef HAVE_CXX11_CLOSURES
-        std::for_each(result.distance.begin(), result.distance.end(),
-                      [&distanceNoise](float &d) {
-                          d += distanceNoise.get();
-                      });
-        std::for_each(result.intensity.begin(), result.intensity.end(),
-                      [&intensityNoise](float &i) {
-                          i += intensityNoise.get();
-                      });
-#   else
-        for (float &d : result.distance) {
-            d += distanceNoise.get();
-        }
-        for (float &i : result.intensity) {
-            i += intensityNoise.get();
-        }
-#   endif
-    return result;
+                    GaussianNoiseSource &distanceNoise,
+                    GaussianNoiseSource &intensityNoise) {
+    /* Draw the noise straight into the result, then add the clean data to it
+     * in a single vectorized pass. */
+    std::vector<float> distance(datum.distance.size());
+    distanceNoise.fill(distance);
+    lidar::concatenateScaled(datum.distance, Span<const float>(), 1,
+                             distance.data(), distance.data());
+    std::vector<float> intensity(datum.intensity.size());
+    intensityNoise.fill(intensity);
+    lidar::concatenateScaled(datum.intensity, Span<const float>(), 1,
+                             intensity.data(), intensity.data());
+    return LidarDatum(datum.time, std::move(distance), std::move(intensity));
 }
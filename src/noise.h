@@ -25,6 +25,8 @@
 #   include <config.h>
 #endif
 
+#include <cstdint>
+
 #include <random>
 #include <stdexcept>
 #include <string>
@@ -32,39 +34,53 @@
 
 #include "csv.h"
 #include "measurement.h"
+#include "sampler.h"
+#include "span.h"
 
 
 // Noise sources //
 
-template<typename RealType = double>
+/* A source of Gaussian noise.  The samples are stream 'stream' of a
+ * NormalSampler keyed by 'seed', so the same seed and stream always give the
+ * same sequence of samples, whether they are drawn one at a time with 'get'
+ * or in bulk with 'fill'.  Samples are computed in single precision. */
 class GaussianNoiseSource {
 public:
-    inline GaussianNoiseSource(RealType mean, RealType stddev);
-    inline RealType get();
+    inline GaussianNoiseSource(float mean, float stddev, std::uint64_t seed,
+                               std::uint64_t stream);
+    inline float get();
+
+    // Fills an array with samples.  This is much faster than calling 'get'.
+    inline void fill(Span<float>);
 
 private:
-    std::mt19937 generator;
-    std::normal_distribution<RealType> distribution;
+    float mean;
+    float stddev;
+    NormalSampler sampler;
 };
 
-/* Convenience function to construct a GaussianNoiseSource<float> from a
+/* A seed from the system's source of randomness.  It fits in a Lua integer,
+ * so it can be passed back to simExtAutomobileRequestNoise. */
+inline std::uint32_t randomSeed();
+
+/* Convenience function to construct a GaussianNoiseSource from a
  * two-element float vector representing mean and standard deviation.
  * Throws a std::invalid_argument if the vector is of the wrong
  * length. */
-inline GaussianNoiseSource<float> gaussian(const std::vector<float>);
+inline GaussianNoiseSource gaussian(const std::vector<float>,
+                                    std::uint64_t seed, std::uint64_t stream);
 
 
 // Noisy values //
 
 // Adds noise to a value.
-Pose addNoise(const Pose &, GaussianNoiseSource<float> &positionNoise,
-              GaussianNoiseSource<float> &angleNoise);
+Pose addNoise(const Pose &, GaussianNoiseSource &positionNoise,
+              GaussianNoiseSource &angleNoise);
 ControlSignals addNoise(const ControlSignals &,
-                        GaussianNoiseSource<float> &speedNoise,
-                        GaussianNoiseSource<float> &steeringAngleNoise);
-LidarDatum addNoise(const LidarDatum &,
-                    GaussianNoiseSource<float> &distanceNoise,
-                    GaussianNoiseSource<float> &intensityNoise);
+                        GaussianNoiseSource &speedNoise,
+                        GaussianNoiseSource &steeringAngleNoise);
+LidarDatum addNoise(const LidarDatum &, GaussianNoiseSource &distanceNoise,
+                    GaussianNoiseSource &intensityNoise);
 
 
 #include "noise-inl.h"
@@ -0,0 +1,34 @@
+/* options-inl.h -- per-run settings
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifndef PPAML_VREP_AUTOMOBILE_PLUGIN_OPTIONS_INL_H
+#define PPAML_VREP_AUTOMOBILE_PLUGIN_OPTIONS_INL_H
+
+Options::Options()
+    : format(output::Format::CSV),
+      floatFormat(csv::FloatFormat::shortest()), compression(false),
+      backend(output::Backend::BUFFERED), timeIndex(false), asyncWriter(false),
+      queueDepth(1024), queuePolicy(output::QueuePolicy::BLOCK),
+      noiseThreads(0), inMemory(false), memoryLimit(std::size_t(1) << 30),
+      reorderSamples(false), lateness(0),
+      beams(lidar::BeamSelection::all()), quantizeLaser(false) {
+}
+
+#endif
@@ -0,0 +1,363 @@
+/* options.cpp -- per-run settings
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cctype>
+#include <cmath>
+#include <cstddef>
+
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "asyncWriter.h"
+#include "codec.h"
+#include "csv.h"
+#include "lidar.h"
+#include "options.h"
+#include "output.h"
+#include "sink.h"
+
+namespace {
+
+    /* The most beams a "list:" selection may name, so a mistyped range
+     * doesn't take all the memory.  Scans are far narrower than this. */
+    const std::size_t MAX_LISTED_BEAMS = std::size_t(1) << 20;
+
+    /* The deepest write queue allowed.  Its slots are allocated up front, so
+     * a mistyped depth would otherwise take all the memory. */
+    const std::size_t MAX_QUEUE_DEPTH = std::size_t(1) << 20;
+
+    // Removes leading and trailing spaces.
+    std::string trim(const std::string &s) {
+        const std::string::size_type first = s.find_first_not_of(' ');
+        if (first == std::string::npos) {
+            return std::string();
+        } else {
+            return s.substr(first, s.find_last_not_of(' ') - first + 1);
+        }
+    }
+
+    class BadOptionError : public std::invalid_argument {
+    public:
+        BadOptionError(const std::string &key, const std::string &value)
+            : std::invalid_argument("bad value `" + value + "' for option `"
+                                    + key + "'") {
+        }
+    };
+
+    /* Parses a nonnegative integer, which is part or all of the passed option
+     * value. */
+    std::size_t parseUnsigned(const std::string &key, const std::string &value,
+                              const std::string &text) {
+        // std::stoul would quietly wrap negative numbers around.
+        if (text.empty()
+            || ! std::isdigit(static_cast<unsigned char>(text[0]))) {
+            throw BadOptionError(key, value);
+        }
+        std::size_t end;
+        unsigned long result;
+        try {
+            result = std::stoul(text, &end);
+        } catch (const std::logic_error &) {
+            throw BadOptionError(key, value);
+        }
+        if (end != text.size()) {
+            throw BadOptionError(key, value);
+        }
+        return result;
+    }
+
+    std::size_t parseSize(const std::string &key, const std::string &value) {
+        const std::size_t result = parseUnsigned(key, value, value);
+        if (result == 0) {
+            throw BadOptionError(key, value);
+        }
+        return result;
+    }
+
+    /* Parses a number of bytes, which may have a binary suffix: "64K", "512M",
+     * "2G". */
+    std::size_t parseBytes(const std::string &key, const std::string &value) {
+        static const std::string suffixes = "KMG";
+        std::string digits = value;
+        unsigned int shift = 0;
+        const std::string::size_type suffix =
+            value.empty() ? std::string::npos : suffixes.find(value.back());
+        if (suffix != std::string::npos) {
+            digits = value.substr(0, value.size() - 1);
+            shift = 10 * (suffix + 1);
+        }
+        std::size_t count;
+        try {
+            count = parseSize(key, digits);
+        } catch (const BadOptionError &) {
+            throw BadOptionError(key, value);
+        }
+        if (count > (std::numeric_limits<std::size_t>::max() >> shift)) {
+            throw BadOptionError(key, value);
+        }
+        return count << shift;
+    }
+
+    // Splits a string at each occurrence of the passed separator.
+    std::vector<std::string> split(const std::string &s,
+                                   const char separator) {
+        std::vector<std::string> result;
+        std::string::size_type start = 0;
+        while (true) {
+            const std::string::size_type end = s.find(separator, start);
+            if (end == std::string::npos) {
+                result.push_back(s.substr(start));
+                return result;
+            }
+            result.push_back(s.substr(start, end - start));
+            start = end + 1;
+        }
+    }
+
+    // Parses a finite angle, in degrees.
+    float parseDegrees(const std::string &key, const std::string &value,
+                       const std::string &text) {
+        std::size_t end;
+        float result;
+        try {
+            result = std::stof(text, &end);
+        } catch (const std::logic_error &) {
+            throw BadOptionError(key, value);
+        }
+        if (end != text.size() || ! std::isfinite(result)) {
+            throw BadOptionError(key, value);
+        }
+        return result;
+    }
+
+    /* Parses a beam selection: "all", "stride:N", "window:SWEEP:FROM:TO", or
+     * "list:" followed by indices and inclusive ranges ("I-J") separated by
+     * semicolons, which must be increasing.  (Commas separate options.) */
+    lidar::BeamSelection parseBeams(const std::string &key,
+                                    const std::string &value) {
+        if (value == "all") {
+            return lidar::BeamSelection::all();
+        }
+        const std::string::size_type colon = value.find(':');
+        if (colon == std::string::npos) {
+            throw BadOptionError(key, value);
+        }
+        const std::string kind = value.substr(0, colon);
+        const std::string spec = value.substr(colon + 1);
+        if (kind == "stride") {
+            std::size_t stride;
+            try {
+                stride = parseSize(key, spec);
+            } catch (const BadOptionError &) {
+                throw BadOptionError(key, value);
+            }
+            return lidar::BeamSelection::stride(stride);
+        } else if (kind == "window") {
+            const std::vector<std::string> angles = split(spec, ':');
+            if (angles.size() != 3) {
+                throw BadOptionError(key, value);
+            }
+            const float sweep = parseDegrees(key, value, angles[0]);
+            const float from = parseDegrees(key, value, angles[1]);
+            const float to = parseDegrees(key, value, angles[2]);
+            if (! (0 < sweep && sweep <= 360) || from > to) {
+                throw BadOptionError(key, value);
+            }
+            return lidar::BeamSelection::window(sweep, from, to);
+        } else if (kind == "list") {
+            std::vector<std::size_t> indices;
+            const std::vector<std::string> items = split(spec, ';');
+            for (const std::string &item : items) {
+                const std::string::size_type dash = item.find('-');
+                const std::size_t first =
+                    parseUnsigned(key, value, item.substr(0, dash));
+                const std::size_t last =
+                    dash == std::string::npos
+                    ? first
+                    : parseUnsigned(key, value, item.substr(dash + 1));
+                if (last < first
+                    || (! indices.empty() && first <= indices.back())
+                    || last - first >= MAX_LISTED_BEAMS - indices.size()) {
+                    throw BadOptionError(key, value);
+                }
+                for (std::size_t i = first; i <= last; i++) {
+                    indices.push_back(i);
+                }
+            }
+            return lidar::BeamSelection::list(std::move(indices));
+        } else {
+            throw BadOptionError(key, value);
+        }
+    }
+
+    void setOption(Options &options, const std::string &key,
+                   const std::string &value) {
+        if (key == "format") {
+            if (value == "csv") {
+                options.format = output::Format::CSV;
+            } else if (value == "arrow") {
+                options.format = output::Format::ARROW;
+            } else {
+                throw BadOptionError(key, value);
+            }
+        } else if (key == "precision") {
+            if (value == "shortest") {
+                options.floatFormat = csv::FloatFormat::shortest();
+            } else {
+                const std::size_t decimals = parseUnsigned(key, value, value);
+                if (decimals > csv::FloatFormat::MAX_DECIMALS) {
+                    throw BadOptionError(key, value);
+                }
+                options.floatFormat = csv::FloatFormat::fixed(decimals);
+            }
+        } else if (key == "compression") {
+            if (value == "none") {
+                options.compression = false;
+            } else if (codec::available()
+                       && value == codec::codecName()) {
+                options.compression = true;
+            } else {
+                throw BadOptionError(key, value);
+            }
+        } else if (key == "io") {
+            if (value == "buffered") {
+                options.backend = output::Backend::BUFFERED;
+            } else if (value == "mmap") {
+                options.backend = output::Backend::MMAP;
+            } else if (value == "uring") {
+                options.backend = output::Backend::URING;
+            } else {
+                throw BadOptionError(key, value);
+            }
+        } else if (key == "index") {
+            if (value == "none") {
+                options.timeIndex = false;
+            } else if (value == "time") {
+                options.timeIndex = true;
+            } else {
+                throw BadOptionError(key, value);
+            }
+        } else if (key == "writer") {
+            if (value == "sync") {
+                options.asyncWriter = false;
+            } else if (value == "async") {
+                options.asyncWriter = true;
+            } else {
+                throw BadOptionError(key, value);
+            }
+        } else if (key == "queueDepth") {
+            options.queueDepth = parseSize(key, value);
+            if (options.queueDepth > MAX_QUEUE_DEPTH) {
+                throw BadOptionError(key, value);
+            }
+        } else if (key == "queueFull") {
+            if (value == "block") {
+                options.queuePolicy = output::QueuePolicy::BLOCK;
+            } else if (value == "drop") {
+                options.queuePolicy = output::QueuePolicy::DROP;
+            } else {
+                throw BadOptionError(key, value);
+            }
+        } else if (key == "noiseThreads") {
+            options.noiseThreads =
+                value == "auto" ? 0 : parseSize(key, value);
+        } else if (key == "recording") {
+            if (value == "stream") {
+                options.inMemory = false;
+            } else if (value == "memory") {
+                options.inMemory = true;
+            } else {
+                throw BadOptionError(key, value);
+            }
+        } else if (key == "memoryLimit") {
+            options.memoryLimit = parseBytes(key, value);
+        } else if (key == "lateness") {
+            if (value == "none") {
+                options.reorderSamples = false;
+            } else {
+                std::size_t end;
+                float seconds;
+                try {
+                    seconds = std::stof(value, &end);
+                } catch (const std::logic_error &) {
+                    throw BadOptionError(key, value);
+                }
+                // This also rejects NaN.
+                if (end != value.size() || ! (0 <= seconds)
+                    || seconds == std::numeric_limits<float>::infinity()) {
+                    throw BadOptionError(key, value);
+                }
+                options.reorderSamples = true;
+                options.lateness = seconds;
+            }
+        } else if (key == "beams") {
+            options.beams = parseBeams(key, value);
+        } else if (key == "laserStorage") {
+            if (value == "float") {
+                options.quantizeLaser = false;
+            } else if (value == "uint16") {
+                options.quantizeLaser = true;
+            } else {
+                throw BadOptionError(key, value);
+            }
+        } else {
+            throw std::invalid_argument("unknown option `" + key + "'");
+        }
+    }
+
+}
+
+Options parseOptions(const std::string &spec) {
+    Options result;
+    std::string::size_type start = 0;
+    while (start <= spec.size()) {
+        std::string::size_type end = spec.find(',', start);
+        if (end == std::string::npos) {
+            end = spec.size();
+        }
+        const std::string pair = trim(spec.substr(start, end - start));
+        if (! pair.empty()) {
+            const std::string::size_type equals = pair.find('=');
+            if (equals == std::string::npos) {
+                throw std::invalid_argument("expected key=value, got `" + pair
+                                            + "'");
+            }
+            setOption(result, trim(pair.substr(0, equals)),
+                      trim(pair.substr(equals + 1)));
+        }
+        start = end + 1;
+    }
+    // Arrow streams are neither block-compressed nor indexed.
+    if (result.compression && result.format == output::Format::ARROW) {
+        throw std::invalid_argument(
+            "compression only applies to format=csv");
+    }
+    if (result.timeIndex && result.format == output::Format::ARROW) {
+        throw std::invalid_argument("index only applies to format=csv");
+    }
+    return result;
+}
@@ -0,0 +1,99 @@
+/* options.h -- per-run settings
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifndef PPAML_VREP_AUTOMOBILE_PLUGIN_OPTIONS_H
+#define PPAML_VREP_AUTOMOBILE_PLUGIN_OPTIONS_H
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cstddef>
+
+#include <stdexcept>
+#include <string>
+
+#include "asyncWriter.h"
+#include "csv.h"
+#include "lidar.h"
+#include "output.h"
+#include "sink.h"
+
+/* Settings which may be passed to simExtAutomobileInit as a string of
+ * comma-separated "key=value" pairs--e.g., "writer=async,queueDepth=4096".
+ * Keys which are not mentioned keep their default values. */
+struct Options {
+    inline Options();
+
+    // The format of the data files ("format")
+    output::Format format;
+    // How CSV files print floats ("precision": "shortest" or a decimal count)
+    csv::FloatFormat floatFormat;
+    /* Whether to write CSV files as compressed blocks ("compression": "none"
+     * or the codec the plugin was built with) */
+    bool compression;
+    // How files are written to the disk ("io": "buffered", "mmap", "uring")
+    output::Backend backend;
+    /* Whether to write a time index next to each CSV data file ("index":
+     * "none" or "time") */
+    bool timeIndex;
+
+    // Whether to format and write data on a background thread ("writer")
+    bool asyncWriter;
+    // How many data may wait for the background thread ("queueDepth")
+    std::size_t queueDepth;
+    // What to do when the background thread falls behind ("queueFull")
+    output::QueuePolicy queuePolicy;
+
+    /* How many threads add noise when there are several noisy data sets
+     * ("noiseThreads": "auto" or a count); 0 means one per core */
+    std::size_t noiseThreads;
+
+    /* Whether to keep data in memory and write them all when the run ends
+     * ("recording": "stream" or "memory") */
+    bool inMemory;
+    /* How many bytes data kept in memory may take before the run goes back
+     * to writing them as they come ("memoryLimit": a count, optionally
+     * followed by K, M, or G) */
+    std::size_t memoryLimit;
+
+    /* Whether to put the table of contents in time order, and how far (in
+     * simulation seconds) a sample may arrive behind the newest one and
+     * still be put in its place ("lateness": "none" or a number) */
+    bool reorderSamples;
+    float lateness;
+
+    /* Which lidar beams to record ("beams": "all", "stride:N",
+     * "window:SWEEP:FROM:TO" in degrees, or "list:" followed by indices and
+     * inclusive ranges separated by semicolons, like "list:0;4;10-19") */
+    lidar::BeamSelection beams;
+    /* Whether to store lidar distances and intensities as 16-bit integers,
+     * scaled to max_distance and max_intensity ("laserStorage": "float" or
+     * "uint16") */
+    bool quantizeLaser;
+};
+
+/* Parses an options string.  Throws a 'std::invalid_argument' if a key is
+ * unknown or a value is malformed. */
+Options parseOptions(const std::string &);
+
+#include "options-inl.h"
+
+#endif
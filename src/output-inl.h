@@ -0,0 +1,176 @@
+/* output-inl.h -- output files that stay open for the whole run
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifndef PPAML_VREP_AUTOMOBILE_PLUGIN_OUTPUT_INL_H
+#define PPAML_VREP_AUTOMOBILE_PLUGIN_OUTPUT_INL_H
+
+namespace output {
+
+    // class File
+
+    bool File::isOpen() const {
+        return static_cast<bool>(sink);
+    }
+
+    void File::append(const char *const data, const std::size_t size) {
+        sink->write(data, size);
+    }
+
+    void File::append(const std::string &data) {
+        append(data.data(), data.size());
+    }
+
+
+    // class CsvFile
+
+    template<typename T>
+    CsvFile::CsvFile(const std::string &path, const T &datum,
+                     const csv::FloatFormat floatFormat, const Backend backend,
+                     const bool indexed)
+        : CsvFile(path, csv::Schema<T>::header(datum),
+                  csv::Schema<T>::nCols(datum), floatFormat, backend,
+                  indexed) {
+    }
+
+    template<typename T>
+    void CsvFile::write(const T &datum) {
+        const unsigned long long offset = size;
+        writeRow(datum);
+        if (index) {
+            index->add(datum.timestamp(), offset);
+        }
+    }
+
+    template<typename T>
+    void CsvFile::writeRow(const T &datum) {
+        if (csv::Schema<T>::nCols(datum) != nCols) {
+            throw HeaderMismatchError(header, csv::Schema<T>::header(datum));
+        }
+        line.clear();
+        csv::Row row(line, floatFormat);
+        csv::Schema<T>::write(row, datum);
+        line.push_back('\n');
+        append(line);
+        size += line.size();
+    }
+
+
+    // class CompressedCsvFile
+
+    template<typename T>
+    void CompressedCsvFile::write(const T &datum) {
+        if (csv::Schema<T>::nCols(datum) != nCols) {
+            throw HeaderMismatchError(header, csv::Schema<T>::header(datum));
+        }
+        const unsigned long long rowOffset = handedOff + block.size();
+        csv::Row row(block, floatFormat);
+        csv::Schema<T>::write(row, datum);
+        block.push_back('\n');
+        if (index) {
+            index->add(datum.timestamp(), rowOffset);
+        }
+        if (block.size() >= BLOCK_SIZE) {
+            flushBlock();
+        }
+    }
+
+
+    // class Registry
+
+    Registry::Registry()
+        : format(Format::CSV), floatFormat(csv::FloatFormat::shortest()),
+          compression(false), backend(Backend::BUFFERED), indexing(false),
+          compressor(), files() {
+    }
+
+    void Registry::setFormat(const Format newFormat) {
+        format = newFormat;
+    }
+
+    void Registry::setFloatFormat(const csv::FloatFormat newFloatFormat) {
+        floatFormat = newFloatFormat;
+    }
+
+    void Registry::setCompression(const bool newCompression) {
+        compression = newCompression;
+    }
+
+    void Registry::setBackend(const Backend newBackend) {
+        backend = newBackend;
+    }
+
+    void Registry::setIndexing(const bool newIndexing) {
+        indexing = newIndexing;
+    }
+
+    template<typename T>
+    Registry::Entry &Registry::open(const std::string &path, const T &datum) {
+        return get(path, datum);
+    }
+
+    template<typename T>
+    void Registry::write(const std::string &path, const T &datum) {
+        write(get(path, datum), datum);
+    }
+
+    template<typename T>
+    void Registry::writeAll(const std::string &path, const Span<const T> data) {
+        if (! data.empty()) {
+            writeAll(get(path, data[0]), data);
+        }
+    }
+
+    template<typename T>
+    Registry::Entry &Registry::get(const std::string &path, const T &datum) {
+        const std::map<std::string, Entry>::iterator entry = files.find(path);
+        if (entry == files.end()) {
+            return open(path, csv::Schema<T>::header(datum),
+                        csv::Schema<T>::nCols(datum), datum);
+        } else {
+            return entry->second;
+        }
+    }
+
+    template<typename T>
+    void Registry::write(Entry &entry, const T &datum) {
+        // Only the file's class is looked up; the row is written statically.
+        switch (entry.kind) {
+        case Entry::Kind::CSV:
+            static_cast<CsvFile &>(*entry.file).write(datum);
+            break;
+        case Entry::Kind::COMPRESSED_CSV:
+            static_cast<CompressedCsvFile &>(*entry.file).write(datum);
+            break;
+        case Entry::Kind::ARROW:
+            static_cast<ArrowFile &>(*entry.file).write(datum);
+            break;
+        }
+    }
+
+    template<typename T>
+    void Registry::writeAll(Entry &entry, const Span<const T> data) {
+        for (const T &datum : data) {
+            write(entry, datum);
+        }
+    }
+
+}
+
+#endif
@@ -0,0 +1,455 @@
+/* output.cpp -- output files that stay open for the whole run
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <exception>
+#include <fstream>
+#include <locale>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "arrowIpc.h"
+#include "asyncWriter.h"
+#include "codec.h"
+#include "csv.h"
+#include "output.h"
+#include "sink.h"
+#include "span.h"
+#include "timeIndex.h"
+
+namespace output {
+
+    namespace {
+
+        /* The number of blocks which may wait for the compressor before
+         * writers have to wait too */
+        const std::size_t COMPRESSOR_QUEUE_DEPTH = 16;
+
+        const std::string SEEK_TABLE_EXTENSION = ".seek";
+        const std::string SEEK_TABLE_HEADER =
+            "Offset,Length,UncompressedOffset,UncompressedLength";
+
+    }
+
+
+
+    const std::string &extension(const Format format) {
+        static const std::string csv = ".csv";
+        static const std::string arrow = ".arrows";
+        return format == Format::ARROW ? arrow : csv;
+    }
+
+    std::vector<SeekEntry> readSeekTable(const std::string &filePath) {
+        const std::string path = filePath + SEEK_TABLE_EXTENSION;
+        std::ifstream table(path);
+        std::string line;
+        std::istringstream fields;
+        fields.imbue(std::locale::classic());
+        if (! std::getline(table, line) || line != SEEK_TABLE_HEADER) {
+            throw IoError("bad seek table in", path);
+        }
+        std::vector<SeekEntry> result;
+        while (std::getline(table, line)) {
+            fields.clear();
+            fields.str(line);
+            SeekEntry entry;
+            char comma1, comma2, comma3;
+            if (! (fields >> entry.offset >> comma1 >> entry.length
+                   >> comma2 >> entry.uncompressedOffset >> comma3
+                   >> entry.uncompressedLength)
+                || comma1 != ',' || comma2 != ',' || comma3 != ',') {
+                throw IoError("bad seek table in", path);
+            }
+            result.push_back(entry);
+        }
+        return result;
+    }
+
+
+    // class File
+
+    File::File(const std::string &path, const Backend backend)
+        : path(path), backend(backend), sink(), streamBuffer(), out() {
+    }
+
+    File::~File() {
+    }
+
+    void File::open() {
+        boost::filesystem::create_directories(
+            boost::filesystem::path(path).parent_path());
+        sink = openSink(path, backend);
+    }
+
+    std::ostream &File::stream() {
+        if (! out) {
+            streamBuffer.reset(new SinkBuf(*sink));
+            out.reset(new std::ostream(streamBuffer.get()));
+            out->exceptions(std::ios::badbit);
+        }
+        return *out;
+    }
+
+    void File::close() {
+        if (sink) {
+            // Drop the file even if closing fails, so it is not closed twice.
+            out.reset();
+            streamBuffer.reset();
+            const std::unique_ptr<Sink> closing = std::move(sink);
+            closing->close();
+        }
+    }
+
+
+    // class CsvFile
+
+    CsvFile::CsvFile(const std::string &path, const std::string &header,
+                     const unsigned int nCols,
+                     const csv::FloatFormat floatFormat, const Backend backend,
+                     const bool indexed)
+        : File(path, backend),
+          header(header),
+          nCols(nCols),
+          floatFormat(floatFormat),
+          line(),
+          size(0),
+          index() {
+        // Ensure we're appending correctly-formatted data.
+        bool empty = true;
+        {
+            std::ifstream existing(path);
+            std::string firstLine;
+            if (existing && std::getline(existing, firstLine)) {
+                if (firstLine != header) {
+                    throw HeaderMismatchError(header, firstLine);
+                }
+                empty = false;
+            }
+        }
+        if (! empty) {
+            size = boost::filesystem::file_size(path);
+        }
+        open();
+        if (empty) {
+            // The file was empty, so write in the header.
+            append(header);
+            append("\n", 1);
+            size = header.size() + 1;
+        }
+        if (indexed) {
+            index.reset(new timeIndex::Writer(path + timeIndex::EXTENSION));
+        }
+    }
+
+    void CsvFile::close() {
+        // Close the file even if the index fails to close.
+        std::exception_ptr indexError;
+        if (index) {
+            try {
+                index->close();
+            } catch (const std::exception &) {
+                indexError = std::current_exception();
+            }
+        }
+        File::close();
+        if (indexError) {
+            std::rethrow_exception(indexError);
+        }
+    }
+
+
+    // class CompressedCsvFile
+
+    // A job which compresses and writes one block of a file
+    class CompressedCsvFile::BlockJob : public Job {
+    public:
+        BlockJob(CompressedCsvFile &file, std::string &&block)
+            : file(file), block(std::move(block)) {
+        }
+
+        virtual void run() {
+            file.writeBlock(block);
+        }
+
+    private:
+        CompressedCsvFile &file;
+        const std::string block;
+    };
+
+    const std::string::size_type CompressedCsvFile::BLOCK_SIZE;
+
+    CompressedCsvFile::CompressedCsvFile(const std::string &path,
+                                         const std::string &header,
+                                         const unsigned int nCols,
+                                         const csv::FloatFormat floatFormat,
+                                         const Backend backend,
+                                         AsyncWriter &compressor,
+                                         const bool indexed)
+        : File(path, backend), header(header), nCols(nCols),
+          floatFormat(floatFormat), compressor(compressor), block(),
+          handedOff(0), index(), seekTable(), compressed(), offset(0),
+          uncompressedOffset(0) {
+        const bool resuming = resume();
+        handedOff = uncompressedOffset;
+        open();
+        if (indexed) {
+            index.reset(new timeIndex::Writer(path + timeIndex::EXTENSION));
+        }
+        seekTable.open(path + SEEK_TABLE_EXTENSION,
+                       resuming ? std::ios::out | std::ios::app
+                                : std::ios::out | std::ios::trunc);
+        if (! seekTable) {
+            throw IoError("could not open", path + SEEK_TABLE_EXTENSION);
+        }
+        seekTable.imbue(std::locale::classic());
+        block.reserve(BLOCK_SIZE + header.size());
+        if (! resuming) {
+            seekTable << SEEK_TABLE_HEADER << '\n';
+            // The header goes at the start of the first block.
+            block.append(header);
+            block.push_back('\n');
+        }
+    }
+
+    CompressedCsvFile::~CompressedCsvFile() {
+        // Blocks still in the queue refer to this file.
+        try {
+            compressor.wait();
+        } catch (const std::exception &) {
+        }
+    }
+
+    bool CompressedCsvFile::resume() {
+        boost::system::error_code error;
+        const boost::uintmax_t size =
+            boost::filesystem::file_size(path, error);
+        if (error || size == 0) {
+            return false;
+        }
+        const std::vector<SeekEntry> table = readSeekTable(path);
+        if (table.empty()) {
+            throw IoError("empty seek table for", path);
+        }
+        // The first block had better start with the same header.
+        const SeekEntry &first = table.front();
+        std::string firstBlock(first.length, '\0');
+        {
+            std::ifstream existing(path, std::ios::in | std::ios::binary);
+            existing.read(&firstBlock[0], firstBlock.size());
+            if (! existing) {
+                throw IoError("could not read", path);
+            }
+        }
+        std::string rows;
+        codec::decompressBlock(
+            Span<const char>(firstBlock.data(), firstBlock.size()),
+            first.uncompressedLength, rows);
+        const std::string firstLine = rows.substr(0, rows.find('\n'));
+        if (firstLine != header) {
+            throw HeaderMismatchError(header, firstLine);
+        }
+        /* Carry on after the last block in the table, dropping anything a
+         * crash might have left after it. */
+        const SeekEntry &last = table.back();
+        offset = last.offset + last.length;
+        uncompressedOffset = last.uncompressedOffset + last.uncompressedLength;
+        if (size > offset) {
+            boost::filesystem::resize_file(path, offset);
+        }
+        return true;
+    }
+
+    void CompressedCsvFile::flushBlock() {
+        if (block.empty()) {
+            return;
+        }
+        handedOff += block.size();
+        compressor.submit(
+            std::unique_ptr<Job>(new BlockJob(*this, std::move(block))));
+        block = std::string();
+        block.reserve(BLOCK_SIZE);
+    }
+
+    void CompressedCsvFile::writeBlock(const std::string &rows) {
+        codec::compressBlock(Span<const char>(rows.data(), rows.size()),
+                             compressed);
+        append(compressed);
+        seekTable << offset << ',' << compressed.size() << ','
+                  << uncompressedOffset << ',' << rows.size() << '\n';
+        if (! seekTable) {
+            throw IoError("could not write to", path + SEEK_TABLE_EXTENSION);
+        }
+        offset += compressed.size();
+        uncompressedOffset += rows.size();
+    }
+
+    void CompressedCsvFile::close() {
+        if (isOpen()) {
+            flushBlock();
+            compressor.wait();
+            if (index) {
+                index->close();
+            }
+            seekTable.close();
+            if (! seekTable) {
+                throw IoError("could not close",
+                              path + SEEK_TABLE_EXTENSION);
+            }
+        }
+        File::close();
+    }
+
+
+    // class ArrowFile
+
+    ArrowFile::ArrowFile(const std::string &path,
+                         const arrowIpc::Datum &datum, const Backend backend)
+        : File(path, backend), writer() {
+        const arrowIpc::Schema schema = datum.arrowSchema();
+        const bool resuming = resume(schema);
+        open();
+        writer.reset(new arrowIpc::StreamWriter(stream(), schema, resuming));
+    }
+
+    bool ArrowFile::resume(const arrowIpc::Schema &schema) {
+        boost::system::error_code error;
+        const boost::uintmax_t size =
+            boost::filesystem::file_size(path, error);
+        if (error || size == 0) {
+            return false;
+        }
+        // The stream had better start with the same schema.
+        const std::string expected = arrowIpc::schemaMessage(schema);
+        std::string actual(expected.size(), '\0');
+        std::string tail(arrowIpc::END_OF_STREAM.size(), '\0');
+        {
+            std::ifstream existing(path, std::ios::in | std::ios::binary);
+            existing.read(&actual[0], actual.size());
+            if (size >= tail.size()) {
+                existing.seekg(size - tail.size());
+                existing.read(&tail[0], tail.size());
+            }
+        }
+        if (actual != expected) {
+            throw arrowIpc::SchemaMismatchError(
+                "existing stream " + path + " has a different schema");
+        }
+        // Drop the end-of-stream marker so new batches go before it.
+        if (tail == arrowIpc::END_OF_STREAM) {
+            boost::filesystem::resize_file(path, size - tail.size());
+        }
+        return true;
+    }
+
+    void ArrowFile::write(const arrowIpc::Datum &datum) {
+        writer->write(datum);
+    }
+
+    void ArrowFile::close() {
+        if (isOpen()) {
+            writer->finish();
+        }
+        File::close();
+    }
+
+
+    // class Registry
+
+    Registry::Entry &Registry::open(const std::string &path,
+                                    const std::string &header,
+                                    const unsigned int nCols,
+                                    const arrowIpc::Datum &datum) {
+        Entry entry;
+        if (format == Format::ARROW) {
+            entry.kind = Entry::Kind::ARROW;
+            entry.file.reset(new ArrowFile(path + extension(format), datum,
+                                           backend));
+        } else if (compression) {
+            if (! compressor) {
+                compressor.reset(new AsyncWriter(COMPRESSOR_QUEUE_DEPTH,
+                                                 QueuePolicy::BLOCK));
+            }
+            entry.kind = Entry::Kind::COMPRESSED_CSV;
+            entry.file.reset(new CompressedCsvFile(
+                                 path + extension(format) + codec::extension(),
+                                 header, nCols, floatFormat, backend,
+                                 *compressor, indexing));
+        } else {
+            entry.kind = Entry::Kind::CSV;
+            entry.file.reset(new CsvFile(path + extension(format), header,
+                                         nCols, floatFormat, backend,
+                                         indexing));
+        }
+        return files.insert(std::make_pair(path, std::move(entry)))
+            .first->second;
+    }
+
+    void Registry::closeAll() {
+        /* Close everything, even if some files fail to close, and report the
+         * first failure afterward. */
+        std::exception_ptr firstError;
+        for (std::pair<const std::string, Entry> &entry : files) {
+            try {
+                entry.second.file->close();
+            } catch (const std::exception &) {
+                if (! firstError) {
+                    firstError = std::current_exception();
+                }
+            }
+        }
+        files.clear();
+        if (compressor) {
+            try {
+                compressor->finish();
+            } catch (const std::exception &) {
+                if (! firstError) {
+                    firstError = std::current_exception();
+                }
+            }
+            compressor.reset();
+        }
+        if (firstError) {
+            std::rethrow_exception(firstError);
+        }
+    }
+
+
+    // Error handling //
+
+    HeaderMismatchError::HeaderMismatchError(const std::string &expected,
+                                             const std::string &actual)
+        : std::logic_error(std::string("CSV header mismatch: expected `")
+                           + expected
+                           + "', but got `"
+                           + actual
+                           + "'") {
+    }
+
+}
@@ -0,0 +1,320 @@
+/* output.h -- output files that stay open for the whole run
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifndef PPAML_VREP_AUTOMOBILE_PLUGIN_OUTPUT_H
+#define PPAML_VREP_AUTOMOBILE_PLUGIN_OUTPUT_H
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cstddef>
+
+#include <fstream>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "arrowIpc.h"
+#include "asyncWriter.h"
+#include "csv.h"
+#include "sink.h"
+#include "span.h"
+#include "timeIndex.h"
+
+namespace output {
+
+    // The formats data files may be written in
+    enum class Format {
+        CSV,
+        ARROW                   // Apache Arrow IPC stream
+    };
+
+    // The file name extension for each format, including the dot
+    const std::string &extension(Format);
+
+    // A row of a compressed file's seek table (see CompressedCsvFile)
+    struct SeekEntry {
+        unsigned long long offset;
+        unsigned long long length;
+        unsigned long long uncompressedOffset;
+        unsigned long long uncompressedLength;
+    };
+
+    /* Reads the seek table of the compressed file at the passed path.  Throws
+     * an 'IoError' if it is missing or malformed. */
+    std::vector<SeekEntry> readSeekTable(const std::string &filePath);
+
+    /* An output file which is opened once and then appended to for the rest
+     * of the run.  Bytes go to the disk through a sink (see sink.h), which
+     * buffers them, so they may not reach the file until it is closed. */
+    class File {
+    public:
+        virtual ~File();
+        File(const File &) = delete;
+        File &operator=(const File &) = delete;
+
+        // Flushes and closes the file.  Throws if any write failed.
+        virtual void close();
+
+    protected:
+        File(const std::string &path, Backend);
+
+        /* Opens the file for appending, creating its parent directories as
+         * necessary. */
+        void open();
+
+        inline bool isOpen() const;
+
+        // Appends bytes to the open file.
+        inline void append(const char *, std::size_t);
+        inline void append(const std::string &);
+
+        /* A stream on top of the open file, for code which needs one.  Its
+         * exceptions are turned on, so errors surface as 'IoError's. */
+        std::ostream &stream();
+
+        const std::string path;
+
+    private:
+        const Backend backend;
+        std::unique_ptr<Sink> sink;
+        std::unique_ptr<SinkBuf> streamBuffer;
+        std::unique_ptr<std::ostream> out;
+    };
+
+    /* A CSV file.  The header is checked (or written, if the file is empty)
+     * when the file is opened; after that, each write only checks that the
+     * datum has the same number of columns as the header.  Rows are built in
+     * a line buffer that is reused, so writing does not allocate.  Data of
+     * any type with a csv::Schema may be written.
+     *
+     * If 'indexed', each record written also gets an entry in a time index
+     * next to the file (see timeIndex.h). */
+    class CsvFile : public File {
+    public:
+        // Opens the file at the passed path, with the passed header.
+        CsvFile(const std::string &path, const std::string &header,
+                unsigned int nCols, csv::FloatFormat, Backend,
+                bool indexed = false);
+
+        /* Opens the file at the passed path.  The passed datum determines the
+         * header; it is not written. */
+        template<typename T>
+        inline CsvFile(const std::string &path, const T &, csv::FloatFormat,
+                       Backend, bool indexed = false);
+
+        // Writes a record, indexing it under its timestamp.
+        template<typename T>
+        inline void write(const T &);
+        template<typename T>
+        inline void writeRow(const T &);
+        virtual void close();
+
+    private:
+        const std::string header;
+        const unsigned int nCols;
+        const csv::FloatFormat floatFormat;
+        std::string line;
+        // The size of the file so far, which is where the next row goes
+        unsigned long long size;
+        std::unique_ptr<timeIndex::Writer> index;
+    };
+
+    /* A CSV file written as a series of independently compressed blocks (see
+     * codec.h), each holding whole rows.  The blocks are compressed and
+     * written by a separate thread, so writing a row costs no more than it
+     * does for a plain CSV file.
+     *
+     * Next to the file is a seek table--a CSV file with the same name plus
+     * ".seek"--holding the offset and length of each block, both in the file
+     * and in the uncompressed data.  A reader can use it to jump to any block
+     * and decompress just that block.  Closing and reopening the file
+     * continues it with new blocks.  Like a CsvFile, the file may have a time
+     * index, whose offsets count uncompressed bytes. */
+    class CompressedCsvFile : public File {
+    public:
+        /* Opens the file at the passed path, with the passed header.  Blocks
+         * are handed to the passed thread, which must outlive the file. */
+        CompressedCsvFile(const std::string &path, const std::string &header,
+                          unsigned int nCols, csv::FloatFormat, Backend,
+                          AsyncWriter &compressor, bool indexed);
+        // Waits for the compressor to finish with this file's blocks.
+        virtual ~CompressedCsvFile();
+
+        template<typename T>
+        inline void write(const T &);
+        virtual void close();
+
+    private:
+        class BlockJob;
+
+        /* Uncompressed size at which a block is handed off.  Blocks end on
+         * row boundaries, so they run a little over. */
+        static const std::string::size_type BLOCK_SIZE = 1024 * 1024;
+
+        /* Prepares an existing file for appending, using its seek table.
+         * Returns false if the file is empty. */
+        bool resume();
+
+        // Hands the pending rows to the compressor as a block.
+        void flushBlock();
+
+        // Compresses and writes a block; runs on the compressor thread.
+        void writeBlock(const std::string &);
+
+        const std::string header;
+        const unsigned int nCols;
+        const csv::FloatFormat floatFormat;
+        AsyncWriter &compressor;
+        // Rows not yet handed to the compressor
+        std::string block;
+        // The uncompressed size of the blocks handed to the compressor
+        unsigned long long handedOff;
+        std::unique_ptr<timeIndex::Writer> index;
+
+        // Used only by the compressor thread once the file is open
+        std::ofstream seekTable;
+        std::string compressed;
+        unsigned long long offset;
+        unsigned long long uncompressedOffset;
+    };
+
+    /* An Arrow IPC stream.  The schema message is written (or, if the file
+     * already holds a stream, checked) when the file is opened, and the
+     * end-of-stream marker when it is closed.  Closing and reopening the file
+     * continues the same stream. */
+    class ArrowFile : public File {
+    public:
+        // Opens the file at the passed path.  The datum determines the schema.
+        ArrowFile(const std::string &path, const arrowIpc::Datum &, Backend);
+
+        void write(const arrowIpc::Datum &);
+        virtual void close();
+
+    private:
+        // Prepares an existing stream for appending.  Returns false if empty.
+        bool resume(const arrowIpc::Schema &);
+
+        std::unique_ptr<arrowIpc::StreamWriter> writer;
+    };
+
+    /* The set of files open for a run, keyed by path.  Files are opened
+     * lazily, the first time a datum is written to them.  Records are written
+     * through their type's csv::Schema (or, in Arrow files, through the
+     * arrowIpc::Datum interface). */
+    class Registry {
+    public:
+        /* An open file, with its class.  Writing through an entry saves
+         * looking the file up by its path; the entry is good until
+         * 'closeAll'. */
+        class Entry {
+        private:
+            friend class Registry;
+
+            enum class Kind {
+                CSV,
+                COMPRESSED_CSV,
+                ARROW
+            };
+
+            Kind kind;
+            std::unique_ptr<File> file;
+        };
+
+        inline Registry();
+        Registry(const Registry &) = delete;
+        Registry &operator=(const Registry &) = delete;
+
+        // Sets the format of files opened from now on.
+        inline void setFormat(Format);
+        // Sets how CSV files opened from now on print floats.
+        inline void setFloatFormat(csv::FloatFormat);
+        // Sets whether CSV files opened from now on are compressed.
+        inline void setCompression(bool);
+        // Sets how files opened from now on are written to the disk.
+        inline void setBackend(Backend);
+        // Sets whether CSV files opened from now on get time indices.
+        inline void setIndexing(bool);
+
+        /* Opens the file at the passed path (without extension) if it is
+         * not open already, and returns its entry.  The datum is used only to
+         * check or write the header. */
+        template<typename T>
+        inline Entry &open(const std::string &path, const T &);
+
+        /* Writes a record, or a run of records of the same type, to the file
+         * at the passed path (without extension), opening it if it is not
+         * open already. */
+        template<typename T>
+        inline void write(const std::string &path, const T &);
+        template<typename T>
+        inline void writeAll(const std::string &path, Span<const T>);
+
+        // Writes a record, or a run of them, to an open file.
+        template<typename T>
+        static inline void write(Entry &, const T &);
+        template<typename T>
+        static inline void writeAll(Entry &, Span<const T>);
+
+        /* Flushes and closes every open file, and stops the compressor
+         * thread, if any. */
+        void closeAll();
+
+    private:
+        template<typename T>
+        inline Entry &get(const std::string &path, const T &);
+        Entry &open(const std::string &path, const std::string &header,
+                    unsigned int nCols, const arrowIpc::Datum &);
+
+        Format format;
+        csv::FloatFormat floatFormat;
+        bool compression;
+        Backend backend;
+        bool indexing;
+        /* The thread compressing blocks for the open files, started when the
+         * first compressed file is opened.  It is declared before 'files' so
+         * it outlives them. */
+        std::unique_ptr<AsyncWriter> compressor;
+        std::map<std::string, Entry> files;
+    };
+
+
+    // Error handling //
+
+    /* An error signaling that a datum does not match the header of the file
+     * it is being written to.  This might occur if an external program
+     * modifies the file in between our writes, but more likely, we've got a
+     * bug somewhere that is causing us to write different data sets to the
+     * same file. */
+    class HeaderMismatchError : public std::logic_error {
+    public:
+        HeaderMismatchError(const std::string &expected,
+                            const std::string &actual);
+    };
+
+}
+
+#include "output-inl.h"
+
+#endif
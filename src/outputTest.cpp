@@ -0,0 +1,241 @@
+/* outputTest.cpp -- unit tests for output files
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cstddef>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "codec.h"
+#include "measurement.h"
+#include "output.h"
+#include "span.h"
+#include "timeIndex.h"
+#include "unitTest.h"
+
+namespace {
+
+    // A fresh temporary directory, removed when it goes out of scope
+    class TemporaryDirectory {
+    public:
+        TemporaryDirectory();
+        ~TemporaryDirectory();
+
+        // The path of a file in the directory
+        std::string operator/(const std::string &) const;
+
+    private:
+        const boost::filesystem::path path;
+    };
+
+    // Enough rows to fill a few compressed blocks
+    const std::size_t N_ROWS = 100000;
+
+    /* Writes the made-up poses from 'first' up to 'last' to a data file at
+     * the passed path (without extension), indexed, and closes it.  Returns
+     * the path of the file written. */
+    std::string writePoses(const std::string &path, bool compressed,
+                           std::size_t first, std::size_t last);
+
+    // The whole of a file
+    std::string readFile(const std::string &path);
+
+    /* Decompresses every block of a compressed file, in turn.  Fails unless
+     * the seek table accounts for every byte of the file and of the text,
+     * in order, in more than one block. */
+    std::string decompress(const std::string &path);
+
+    /* Fails unless a compressed file holds the same text as a plain one,
+     * with the same index, and rows read through the index match. */
+    void expectSameAsPlain(const std::string &compressedPath,
+                           const std::string &plainPath);
+
+
+    // Tests //
+
+    // The blocks decompress to exactly what a plain CSV file holds.
+    void compressedRoundTrip() {
+        if (! codec::available()) {
+            unitTest::skip("built without a codec");
+        }
+        const TemporaryDirectory dir;
+        const std::string plain = writePoses(dir / "plain", false, 0, N_ROWS);
+        const std::string compressed =
+            writePoses(dir / "compressed", true, 0, N_ROWS);
+        expectSameAsPlain(compressed, plain);
+    }
+
+    // A file closed and reopened carries on as if it had never closed.
+    void compressedResumes() {
+        if (! codec::available()) {
+            unitTest::skip("built without a codec");
+        }
+        const TemporaryDirectory dir;
+        const std::string plain = writePoses(dir / "plain", false, 0, N_ROWS);
+        writePoses(dir / "compressed", true, 0, N_ROWS / 3);
+        const std::string compressed =
+            writePoses(dir / "compressed", true, N_ROWS / 3, N_ROWS);
+        expectSameAsPlain(compressed, plain);
+    }
+
+    /* Bytes after the last block in the seek table--part of a block a crash
+     * interrupted--are dropped when the file is reopened. */
+    void compressedDropsTornTail() {
+        if (! codec::available()) {
+            unitTest::skip("built without a codec");
+        }
+        const TemporaryDirectory dir;
+        const std::string plain = writePoses(dir / "plain", false, 0, N_ROWS);
+        const std::string compressed =
+            writePoses(dir / "compressed", true, 0, N_ROWS / 2);
+        {
+            // Repeat the first half of the last block.
+            const output::SeekEntry last =
+                output::readSeekTable(compressed).back();
+            const std::string file = readFile(compressed);
+            std::ofstream out(compressed, std::ios::out | std::ios::binary
+                                          | std::ios::app);
+            out.write(file.data() + last.offset, last.length / 2);
+        }
+        writePoses(dir / "compressed", true, N_ROWS / 2, N_ROWS);
+        expectSameAsPlain(compressed, plain);
+    }
+
+    const unitTest::Test TESTS[] = {
+        {"output/compressed/roundTrip", compressedRoundTrip},
+        {"output/compressed/resume", compressedResumes},
+        {"output/compressed/tornTail", compressedDropsTornTail},
+    };
+
+}
+
+namespace unitTest {
+
+    const Span<const Test> outputTests(TESTS, sizeof TESTS / sizeof TESTS[0]);
+
+}
+
+
+namespace {
+
+    // class TemporaryDirectory
+
+    TemporaryDirectory::TemporaryDirectory()
+        : path(boost::filesystem::temp_directory_path()
+               / boost::filesystem::unique_path("output-test-%%%%-%%%%")) {
+        boost::filesystem::create_directory(path);
+    }
+
+    TemporaryDirectory::~TemporaryDirectory() {
+        boost::system::error_code error;
+        boost::filesystem::remove_all(path, error);
+    }
+
+    std::string TemporaryDirectory::operator/(const std::string &name) const {
+        return (path / name).string();
+    }
+
+
+    // Files //
+
+    std::string writePoses(const std::string &path, const bool compressed,
+                           const std::size_t first, const std::size_t last) {
+        output::Registry files;
+        files.setCompression(compressed);
+        files.setIndexing(true);
+        for (std::size_t i = first; i < last; i++) {
+            const float time = i * 0.01f;
+            files.write(path, Pose(time, time * 3.5f, 1000 - time / 7,
+                                   static_cast<float>(i % 628) / 100));
+        }
+        files.closeAll();
+        return path + output::extension(output::Format::CSV)
+            + (compressed ? codec::extension() : "");
+    }
+
+    std::string readFile(const std::string &path) {
+        std::ifstream file(path, std::ios::in | std::ios::binary);
+        if (! file) {
+            throw output::IoError("could not open", path);
+        }
+        return std::string(std::istreambuf_iterator<char>(file),
+                           std::istreambuf_iterator<char>());
+    }
+
+    std::string decompress(const std::string &path) {
+        const std::vector<output::SeekEntry> table =
+            output::readSeekTable(path);
+        const std::string file = readFile(path);
+        unitTest::expect(table.size() > 1,
+                         std::to_string(table.size()) + " blocks");
+        std::string result;
+        std::string block;
+        for (const output::SeekEntry &entry : table) {
+            unitTest::expect(entry.uncompressedOffset == result.size(),
+                             "block at " + std::to_string(entry.offset)
+                             + " out of place in the text");
+            unitTest::expect(entry.offset <= file.size()
+                             && entry.length <= file.size() - entry.offset,
+                             "block at " + std::to_string(entry.offset)
+                             + " runs past the end of the file");
+            codec::decompressBlock(
+                Span<const char>(file.data() + entry.offset, entry.length),
+                entry.uncompressedLength, block);
+            result += block;
+        }
+        const output::SeekEntry &last = table.back();
+        unitTest::expect(last.offset + last.length == file.size(),
+                         std::to_string(file.size() - last.offset
+                                        - last.length)
+                         + " bytes after the last block");
+        return result;
+    }
+
+
+    // Checks //
+
+    void expectSameAsPlain(const std::string &compressedPath,
+                           const std::string &plainPath) {
+        unitTest::expect(decompress(compressedPath) == readFile(plainPath),
+                         "decompressed text differs");
+        const std::string compressedIndex =
+            compressedPath + timeIndex::EXTENSION;
+        const std::string plainIndex = plainPath + timeIndex::EXTENSION;
+        unitTest::expect(readFile(compressedIndex) == readFile(plainIndex),
+                         "indices differ");
+        // Read some rows back through the seek table.
+        timeIndex::Reader index(compressedIndex);
+        for (std::size_t i = 0; i < index.size(); i += 997) {
+            const unsigned long long offset = index[i].offset;
+            unitTest::expect(timeIndex::readRow(compressedPath, offset)
+                             == timeIndex::readRow(plainPath, offset),
+                             "row " + std::to_string(i) + " differs");
+        }
+    }
+
+}
@@ -0,0 +1,106 @@
+/* reorder-inl.h -- putting several streams of events back in time order
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifndef PPAML_VREP_AUTOMOBILE_PLUGIN_REORDER_INL_H
+#define PPAML_VREP_AUTOMOBILE_PLUGIN_REORDER_INL_H
+
+template<typename T>
+ReorderBuffer<T>::ReorderBuffer(const std::size_t nStreams,
+                                const float lateness,
+                                const std::size_t capacity)
+    : streams(nStreams), lateness_(lateness), capacity(capacity), size(0),
+      nextSequence(0), newest(0), released(0), anyPushed(false),
+      anyReleased(false), late_(0) {
+}
+
+template<typename T>
+void ReorderBuffer<T>::push(const std::size_t stream, const float time,
+                            const T &value) {
+    const Event event = {time, nextSequence++, value};
+    streams[stream].push_back(event);
+    size++;
+    if (! anyPushed || newest < time) {
+        newest = time;
+        anyPushed = true;
+    }
+}
+
+template<typename T>
+void ReorderBuffer<T>::release(std::vector<T> &out) {
+    /* Release everything at least 'lateness' older than the newest event,
+     * then make room if the buffer is over capacity. */
+    const float due = newest - lateness_;
+    for (Stream *stream = earliest();
+         stream && (stream->front().time <= due || size > capacity);
+         stream = earliest()) {
+        releaseNext(*stream, out);
+    }
+}
+
+template<typename T>
+void ReorderBuffer<T>::releaseAll(std::vector<T> &out) {
+    for (Stream *stream = earliest(); stream; stream = earliest()) {
+        releaseNext(*stream, out);
+    }
+}
+
+template<typename T>
+typename ReorderBuffer<T>::Stream *ReorderBuffer<T>::earliest() {
+    // This is the k-way merge; there are only a handful of streams.
+    Stream *result = nullptr;
+    for (Stream &stream : streams) {
+        if (! stream.empty()
+            && (! result || later(result->front(), stream.front()))) {
+            result = &stream;
+        }
+    }
+    return result;
+}
+
+template<typename T>
+void ReorderBuffer<T>::releaseNext(Stream &stream, std::vector<T> &out) {
+    const Event &event = stream.front();
+    if (! anyReleased || released <= event.time) {
+        released = event.time;
+        anyReleased = true;
+    } else {
+        late_++;
+    }
+    out.push_back(event.value);
+    stream.pop_front();
+    size--;
+}
+
+template<typename T>
+float ReorderBuffer<T>::lateness() const {
+    return lateness_;
+}
+
+template<typename T>
+unsigned long long ReorderBuffer<T>::late() const {
+    return late_;
+}
+
+template<typename T>
+bool ReorderBuffer<T>::later(const Event &a, const Event &b) {
+    return a.time > b.time || (a.time == b.time && a.sequence > b.sequence);
+}
+
+#endif
@@ -0,0 +1,103 @@
+/* reorder.h -- putting several streams of events back in time order
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifndef PPAML_VREP_AUTOMOBILE_PLUGIN_REORDER_H
+#define PPAML_VREP_AUTOMOBILE_PLUGIN_REORDER_H
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cstddef>
+
+#include <deque>
+#include <vector>
+
+/* A bounded buffer which merges timestamped events from several streams into
+ * time order.  Each stream is taken to be in time order already--it is the
+ * streams which are out of step with each other--so each is held as a queue,
+ * in the order its events arrived, and releasing is a k-way merge of the
+ * queues.  An event is held until an event more than 'lateness' newer has
+ * arrived (or the buffer is full), so a stream may lag the newest event by
+ * up to 'lateness' and its events still land in their place.  Events with
+ * equal times come out in the order they went in.
+ *
+ * Every event comes out, and each stream's come out in the order they went
+ * in, so the merged events can be matched up one for one with records kept
+ * per stream.  An event which can't go in its place--it arrived too late, or
+ * behind a newer event of its own stream--comes out with its stream anyway,
+ * and is counted as late. */
+template<typename T>
+class ReorderBuffer {
+public:
+    ReorderBuffer(std::size_t nStreams, float lateness, std::size_t capacity);
+    ReorderBuffer(const ReorderBuffer &) = delete;
+    ReorderBuffer &operator=(const ReorderBuffer &) = delete;
+
+    // Adds an event to the end of one of the streams.
+    void push(std::size_t stream, float time, const T &);
+
+    /* Appends the events which no longer need to wait to the passed vector,
+     * merged into time order. */
+    void release(std::vector<T> &);
+
+    // Appends every held event to the passed vector, merged into time order.
+    void releaseAll(std::vector<T> &);
+
+    inline float lateness() const;
+
+    /* The number of events released behind a newer one, out of time
+     * order */
+    inline unsigned long long late() const;
+
+private:
+    struct Event {
+        float time;
+        unsigned long long sequence;
+        T value;
+    };
+
+    // Whether the first event is later than the second
+    static inline bool later(const Event &, const Event &);
+
+    typedef std::deque<Event> Stream;
+
+    // The stream whose next event is earliest, or null if all are empty
+    Stream *earliest();
+
+    // Moves a stream's next event into the vector.
+    void releaseNext(Stream &, std::vector<T> &);
+
+    std::vector<Stream> streams;
+    const float lateness_;
+    const std::size_t capacity;
+    std::size_t size;
+    unsigned long long nextSequence;
+    // The newest time pushed, and the newest released
+    float newest;
+    float released;
+    bool anyPushed;
+    bool anyReleased;
+    unsigned long long late_;
+};
+
+#include "reorder-inl.h"
+
+#endif
@@ -0,0 +1,209 @@
+/* reorderTest.cpp -- unit tests for the reorder buffer
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cstddef>
+
+#include <string>
+#include <vector>
+
+#include "reorder.h"
+#include "span.h"
+#include "unitTest.h"
+
+namespace {
+
+    // An event as the tests push it: its stream, time, and a serial number
+    struct Event {
+        std::size_t stream;
+        float time;
+        unsigned int serial;
+    };
+
+    Event event(std::size_t stream, float time, unsigned int serial);
+
+    // Pushes the events in order, releasing after each.
+    std::vector<Event> run(ReorderBuffer<Event> &, const std::vector<Event> &);
+
+    /* Fails unless the released events are the pushed ones, with each
+     * stream's in the order they were pushed. */
+    void expectStreamsKept(const std::vector<Event> &pushed,
+                           const std::vector<Event> &released,
+                           std::size_t nStreams);
+
+    std::string describe(const std::vector<Event> &);
+
+
+    // Tests //
+
+    // Streams which lag each other by less than the lateness come out sorted.
+    void mergesInWindow() {
+        std::vector<Event> pushed;
+        // Stream 0 runs half a second behind stream 1, and stream 2 between.
+        for (unsigned int i = 0; i < 100; i++) {
+            const float t = i * 0.1f;
+            pushed.push_back(event(1, t + 0.5f, 3 * i));
+            pushed.push_back(event(2, t + 0.25f, 3 * i + 1));
+            pushed.push_back(event(0, t, 3 * i + 2));
+        }
+        ReorderBuffer<Event> buffer(3, 1, 1000);
+        const std::vector<Event> released = run(buffer, pushed);
+        expectStreamsKept(pushed, released, 3);
+        for (std::size_t i = 1; i < released.size(); i++) {
+            unitTest::expect(released[i - 1].time <= released[i].time,
+                             "out of order: " + describe(released));
+        }
+        unitTest::expect(buffer.late() == 0,
+                         std::to_string(buffer.late()) + " late events");
+    }
+
+    /* Events too late for their place still come out, with their stream,
+     * and are counted. */
+    void keepsLateEvents() {
+        const Event events[] = {
+            {0, 1.0f, 0},
+            {2, 0.5f, 1},
+            {1, 0.2f, 2},
+            {0, 3.0f, 3},
+            {1, 0.1f, 4},       // behind its own stream and the window
+            {2, 5.0f, 5},
+            {1, 0.0f, 6},
+        };
+        const std::vector<Event> pushed(
+            events, events + sizeof events / sizeof events[0]);
+        ReorderBuffer<Event> buffer(3, 1, 1000);
+        const std::vector<Event> released = run(buffer, pushed);
+        expectStreamsKept(pushed, released, 3);
+        const unsigned int expected[] = {2, 1, 0, 4, 3, 6, 5};
+        for (std::size_t i = 0; i < released.size(); i++) {
+            unitTest::expect(released[i].serial == expected[i],
+                             "released " + describe(released));
+        }
+        unitTest::expect(buffer.late() == 2,
+                         std::to_string(buffer.late())
+                         + " late events, not 2");
+    }
+
+    // Equal times come out in the order they went in, across streams.
+    void keepsTiesInOrder() {
+        std::vector<Event> pushed;
+        for (unsigned int i = 0; i < 12; i++) {
+            pushed.push_back(event((i * 7) % 3, i < 6 ? 1.0f : 2.0f, i));
+        }
+        ReorderBuffer<Event> buffer(3, 0.5f, 1000);
+        const std::vector<Event> released = run(buffer, pushed);
+        for (std::size_t i = 0; i < released.size(); i++) {
+            unitTest::expect(released[i].serial == i,
+                             "released " + describe(released));
+        }
+    }
+
+    // A full buffer lets its oldest events go before they are due.
+    void releasesWhenFull() {
+        ReorderBuffer<Event> buffer(2, 1000, 4);
+        std::vector<Event> released;
+        for (unsigned int i = 0; i < 10; i++) {
+            const float time = static_cast<float>(i);
+            buffer.push(i % 2, time, event(i % 2, time, i));
+            buffer.release(released);
+            const std::size_t held = i + 1 - released.size();
+            unitTest::expect(held == (i < 4 ? i + 1 : 4),
+                             std::to_string(held) + " events held after "
+                             + std::to_string(i + 1) + " pushes");
+        }
+        buffer.releaseAll(released);
+        unitTest::expect(released.size() == 10,
+                         "released " + describe(released));
+    }
+
+    const unitTest::Test TESTS[] = {
+        {"ReorderBuffer/merge", mergesInWindow},
+        {"ReorderBuffer/late", keepsLateEvents},
+        {"ReorderBuffer/ties", keepsTiesInOrder},
+        {"ReorderBuffer/capacity", releasesWhenFull},
+    };
+
+}
+
+namespace unitTest {
+
+    const Span<const Test> reorderTests(TESTS,
+                                        sizeof TESTS / sizeof TESTS[0]);
+
+}
+
+
+namespace {
+
+    Event event(const std::size_t stream, const float time,
+                const unsigned int serial) {
+        const Event result = {stream, time, serial};
+        return result;
+    }
+
+    std::vector<Event> run(ReorderBuffer<Event> &buffer,
+                           const std::vector<Event> &events) {
+        std::vector<Event> result;
+        for (const Event &event : events) {
+            buffer.push(event.stream, event.time, event);
+            buffer.release(result);
+        }
+        buffer.releaseAll(result);
+        return result;
+    }
+
+    void expectStreamsKept(const std::vector<Event> &pushed,
+                           const std::vector<Event> &released,
+                           const std::size_t nStreams) {
+        unitTest::expect(released.size() == pushed.size(),
+                         "released " + describe(released));
+        for (std::size_t stream = 0; stream < nStreams; stream++) {
+            std::vector<unsigned int> in;
+            std::vector<unsigned int> out;
+            for (const Event &event : pushed) {
+                if (event.stream == stream) {
+                    in.push_back(event.serial);
+                }
+            }
+            for (const Event &event : released) {
+                if (event.stream == stream) {
+                    out.push_back(event.serial);
+                }
+            }
+            unitTest::expect(in == out,
+                             "stream " + std::to_string(stream)
+                             + " reordered: " + describe(released));
+        }
+    }
+
+    std::string describe(const std::vector<Event> &events) {
+        std::string result;
+        for (const Event &event : events) {
+            result += (result.empty() ? "" : " ")
+                + std::to_string(event.serial) + "@"
+                + std::to_string(event.time);
+        }
+        return result;
+    }
+
+}
@@ -0,0 +1,80 @@
+/* ring-inl.h -- bounded single-producer, single-consumer queue
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifndef PPAML_VREP_AUTOMOBILE_PLUGIN_RING_INL_H
+#define PPAML_VREP_AUTOMOBILE_PLUGIN_RING_INL_H
+
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+template<typename T>
+SpscRing<T>::SpscRing(const std::size_t capacity)
+    : slots(roundUpToPowerOfTwo(capacity)), mask(slots.size() - 1),
+      padding0(), head(0), padding1(), tail(0), padding2() {
+}
+
+template<typename T>
+bool SpscRing<T>::tryPush(T &value) {
+    const std::size_t t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) == slots.size()) {
+        return false;
+    }
+    slots[t & mask] = std::move(value);
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+}
+
+template<typename T>
+bool SpscRing<T>::tryPop(T &value) {
+    const std::size_t h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire)) {
+        return false;
+    }
+    value = std::move(slots[h & mask]);
+    head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+template<typename T>
+bool SpscRing<T>::empty() const {
+    return head.load(std::memory_order_acquire)
+        == tail.load(std::memory_order_acquire);
+}
+
+template<typename T>
+std::size_t SpscRing<T>::capacity() const {
+    return slots.size();
+}
+
+template<typename T>
+std::size_t SpscRing<T>::roundUpToPowerOfTwo(const std::size_t n) {
+    // Past the highest power of two, doubling would wrap around to zero.
+    if (n > std::numeric_limits<std::size_t>::max() / 2 + 1) {
+        throw std::length_error("ring capacity too large");
+    }
+    std::size_t result = 1;
+    while (result < n) {
+        result <<= 1;
+    }
+    return result;
+}
+
+#endif
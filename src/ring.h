@@ -0,0 +1,75 @@
+/* ring.h -- bounded single-producer, single-consumer queue
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifndef PPAML_VREP_AUTOMOBILE_PLUGIN_RING_H
+#define PPAML_VREP_AUTOMOBILE_PLUGIN_RING_H
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cstddef>
+
+#include <atomic>
+#include <vector>
+
+/* A fixed-capacity ring buffer which is safe to use without locks as long as
+ * exactly one thread pushes and exactly one (possibly different) thread pops.
+ * The capacity is rounded up to a power of two; the constructor throws a
+ * std::length_error if there is none that large. */
+template<typename T>
+class SpscRing {
+public:
+    explicit SpscRing(std::size_t capacity);
+    SpscRing(const SpscRing &) = delete;
+    SpscRing &operator=(const SpscRing &) = delete;
+
+    /* Moves the passed value into the ring.  Returns false, leaving the value
+     * untouched, if the ring is full.  Call only from the producer thread. */
+    inline bool tryPush(T &);
+
+    /* Moves the oldest value in the ring into the argument.  Returns false if
+     * the ring is empty.  Call only from the consumer thread. */
+    inline bool tryPop(T &);
+
+    /* Whether the ring is empty.  Safe to call from any thread, though the
+     * answer may be stale by the time it returns. */
+    inline bool empty() const;
+
+    inline std::size_t capacity() const;
+
+private:
+    static std::size_t roundUpToPowerOfTwo(std::size_t);
+
+    std::vector<T> slots;
+    const std::size_t mask;
+    /* Keep the two indices on separate cache lines so the producer and
+     * consumer don't fight over them.  (Padding rather than 'alignas', since
+     * C++11 'new' ignores extended alignment.) */
+    char padding0[64];
+    std::atomic<std::size_t> head;  // next slot to pop
+    char padding1[64 - sizeof(std::atomic<std::size_t>)];
+    std::atomic<std::size_t> tail;  // next slot to push
+    char padding2[64 - sizeof(std::atomic<std::size_t>)];
+};
+
+#include "ring-inl.h"
+
+#endif
@@ -0,0 +1,524 @@
+/* sampler.cpp -- generating normally distributed samples in bulk
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef HAVE_X86_SIMD_DISPATCH
+#   include <immintrin.h>
+#endif
+
+#include "cpu.h"
+#include "sampler.h"
+#include "span.h"
+
+namespace {
+
+    const std::size_t LANES = NormalSampler::LANES;
+
+    // Added to the first counter word of each lane
+    const std::uint32_t LANE_INDEX[LANES] = {0, 1, 2, 3, 4, 5, 6, 7};
+
+    // Philox4x32 multipliers and key increments
+    const std::uint32_t PHILOX_M0 = 0xD2511F53;
+    const std::uint32_t PHILOX_M1 = 0xCD9E8D57;
+    const std::uint32_t PHILOX_W0 = 0x9E3779B9;
+    const std::uint32_t PHILOX_W1 = 0xBB67AE85;
+
+
+    // Operations on lanes //
+
+    /* The kernel is written once, against a set of operations on a register's
+     * worth of lanes.  'F' holds floats; 'U' holds 32-bit integers, and also
+     * masks, which have every bit of a lane set or clear. */
+
+    struct ScalarOps {
+        static const std::size_t WIDTH = 1;
+        typedef float F;
+        typedef std::uint32_t U;
+
+        static inline U load(const std::uint32_t *const p) { return *p; }
+        static inline void store(std::uint32_t *const p, const U x) { *p = x; }
+        static inline void store(float *const p, const F x) { *p = x; }
+        static inline U splatU(const std::uint32_t x) { return x; }
+        static inline F splatF(const float x) { return x; }
+
+        static inline U add(const U x, const U y) { return x + y; }
+        static inline U sub(const U x, const U y) { return x - y; }
+        static inline U bitAnd(const U x, const U y) { return x & y; }
+        static inline U bitOr(const U x, const U y) { return x | y; }
+        static inline U bitXor(const U x, const U y) { return x ^ y; }
+        template<int N> static inline U shl(const U x) { return x << N; }
+        template<int N> static inline U shr(const U x) { return x >> N; }
+        static inline U equal(const U x, const U y) { return x == y ? ~0u : 0; }
+        static inline void mulHiLo(const U x, const std::uint32_t y, U &hi,
+                                   U &lo) {
+            const std::uint64_t product = static_cast<std::uint64_t>(x) * y;
+            hi = static_cast<std::uint32_t>(product >> 32);
+            lo = static_cast<std::uint32_t>(product);
+        }
+
+        static inline F add(const F x, const F y) { return x + y; }
+        static inline F sub(const F x, const F y) { return x - y; }
+        static inline F mul(const F x, const F y) { return x * y; }
+        static inline F sqrt(const F x) { return __builtin_sqrtf(x); }
+        static inline U less(const F x, const F y) { return x < y ? ~0u : 0; }
+
+        // Converts a signed integer to float.
+        static inline F toFloat(const U x) {
+            return static_cast<float>(static_cast<std::int32_t>(x));
+        }
+        // Converts a float to a signed integer, rounding toward zero.
+        static inline U truncate(const F x) {
+            return static_cast<std::uint32_t>(static_cast<std::int32_t>(x));
+        }
+        static inline U bits(const F x) {
+            U result;
+            __builtin_memcpy(&result, &x, sizeof result);
+            return result;
+        }
+        static inline F fromBits(const U x) {
+            F result;
+            __builtin_memcpy(&result, &x, sizeof result);
+            return result;
+        }
+        static inline F select(const U mask, const F x, const F y) {
+            return mask ? x : y;
+        }
+    };
+
+#   ifdef HAVE_X86_SIMD_DISPATCH
+
+#   pragma GCC push_options
+#   pragma GCC target("sse2")
+
+    struct Sse2Ops {
+        static const std::size_t WIDTH = 4;
+        typedef __m128 F;
+        typedef __m128i U;
+
+        static inline U load(const std::uint32_t *const p) {
+            return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        }
+        static inline void store(std::uint32_t *const p, const U x) {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(p), x);
+        }
+        static inline void store(float *const p, const F x) {
+            _mm_storeu_ps(p, x);
+        }
+        static inline U splatU(const std::uint32_t x) {
+            return _mm_set1_epi32(static_cast<int>(x));
+        }
+        static inline F splatF(const float x) { return _mm_set1_ps(x); }
+
+        static inline U add(const U x, const U y) {
+            return _mm_add_epi32(x, y);
+        }
+        static inline U sub(const U x, const U y) {
+            return _mm_sub_epi32(x, y);
+        }
+        static inline U bitAnd(const U x, const U y) {
+            return _mm_and_si128(x, y);
+        }
+        static inline U bitOr(const U x, const U y) {
+            return _mm_or_si128(x, y);
+        }
+        static inline U bitXor(const U x, const U y) {
+            return _mm_xor_si128(x, y);
+        }
+        template<int N>
+        static inline U shl(const U x) {
+            return _mm_slli_epi32(x, N);
+        }
+        template<int N>
+        static inline U shr(const U x) {
+            return _mm_srli_epi32(x, N);
+        }
+        static inline U equal(const U x, const U y) {
+            return _mm_cmpeq_epi32(x, y);
+        }
+        static inline void mulHiLo(const U x, const std::uint32_t y, U &hi,
+                                   U &lo) {
+            // Multiply the even lanes and the odd lanes, then interleave.
+            const U factor = splatU(y);
+            const U even = _mm_shuffle_epi32(_mm_mul_epu32(x, factor),
+                                             _MM_SHUFFLE(3, 1, 2, 0));
+            const U odd = _mm_shuffle_epi32(
+                _mm_mul_epu32(_mm_srli_epi64(x, 32), factor),
+                _MM_SHUFFLE(3, 1, 2, 0));
+            lo = _mm_unpacklo_epi32(even, odd);
+            hi = _mm_unpackhi_epi32(even, odd);
+        }
+
+        static inline F add(const F x, const F y) { return _mm_add_ps(x, y); }
+        static inline F sub(const F x, const F y) { return _mm_sub_ps(x, y); }
+        static inline F mul(const F x, const F y) { return _mm_mul_ps(x, y); }
+        static inline F sqrt(const F x) { return _mm_sqrt_ps(x); }
+        static inline U less(const F x, const F y) {
+            return _mm_castps_si128(_mm_cmplt_ps(x, y));
+        }
+
+        static inline F toFloat(const U x) { return _mm_cvtepi32_ps(x); }
+        static inline U truncate(const F x) { return _mm_cvttps_epi32(x); }
+        static inline U bits(const F x) { return _mm_castps_si128(x); }
+        static inline F fromBits(const U x) { return _mm_castsi128_ps(x); }
+        static inline F select(const U mask, const F x, const F y) {
+            const F m = _mm_castsi128_ps(mask);
+            return _mm_or_ps(_mm_and_ps(m, x), _mm_andnot_ps(m, y));
+        }
+    };
+
+#   pragma GCC pop_options
+
+#   pragma GCC push_options
+#   pragma GCC target("avx2")
+
+    struct Avx2Ops {
+        static const std::size_t WIDTH = 8;
+        typedef __m256 F;
+        typedef __m256i U;
+
+        static inline U load(const std::uint32_t *const p) {
+            return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        }
+        static inline void store(std::uint32_t *const p, const U x) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), x);
+        }
+        static inline void store(float *const p, const F x) {
+            _mm256_storeu_ps(p, x);
+        }
+        static inline U splatU(const std::uint32_t x) {
+            return _mm256_set1_epi32(static_cast<int>(x));
+        }
+        static inline F splatF(const float x) { return _mm256_set1_ps(x); }
+
+        static inline U add(const U x, const U y) {
+            return _mm256_add_epi32(x, y);
+        }
+        static inline U sub(const U x, const U y) {
+            return _mm256_sub_epi32(x, y);
+        }
+        static inline U bitAnd(const U x, const U y) {
+            return _mm256_and_si256(x, y);
+        }
+        static inline U bitOr(const U x, const U y) {
+            return _mm256_or_si256(x, y);
+        }
+        static inline U bitXor(const U x, const U y) {
+            return _mm256_xor_si256(x, y);
+        }
+        template<int N>
+        static inline U shl(const U x) {
+            return _mm256_slli_epi32(x, N);
+        }
+        template<int N>
+        static inline U shr(const U x) {
+            return _mm256_srli_epi32(x, N);
+        }
+        static inline U equal(const U x, const U y) {
+            return _mm256_cmpeq_epi32(x, y);
+        }
+        static inline void mulHiLo(const U x, const std::uint32_t y, U &hi,
+                                   U &lo) {
+            // As for SSE2, within each 128-bit half
+            const U factor = splatU(y);
+            const U even = _mm256_shuffle_epi32(_mm256_mul_epu32(x, factor),
+                                                _MM_SHUFFLE(3, 1, 2, 0));
+            const U odd = _mm256_shuffle_epi32(
+                _mm256_mul_epu32(_mm256_srli_epi64(x, 32), factor),
+                _MM_SHUFFLE(3, 1, 2, 0));
+            lo = _mm256_unpacklo_epi32(even, odd);
+            hi = _mm256_unpackhi_epi32(even, odd);
+        }
+
+        static inline F add(const F x, const F y) {
+            return _mm256_add_ps(x, y);
+        }
+        static inline F sub(const F x, const F y) {
+            return _mm256_sub_ps(x, y);
+        }
+        static inline F mul(const F x, const F y) {
+            return _mm256_mul_ps(x, y);
+        }
+        static inline F sqrt(const F x) { return _mm256_sqrt_ps(x); }
+        static inline U less(const F x, const F y) {
+            return _mm256_castps_si256(_mm256_cmp_ps(x, y, _CMP_LT_OQ));
+        }
+
+        static inline F toFloat(const U x) { return _mm256_cvtepi32_ps(x); }
+        static inline U truncate(const F x) { return _mm256_cvttps_epi32(x); }
+        static inline U bits(const F x) { return _mm256_castps_si256(x); }
+        static inline F fromBits(const U x) { return _mm256_castsi256_ps(x); }
+        static inline F select(const U mask, const F x, const F y) {
+            return _mm256_blendv_ps(y, x, _mm256_castsi256_ps(mask));
+        }
+    };
+
+#   pragma GCC pop_options
+
+#   endif
+
+
+    // The kernel //
+
+    /* These are compiled for the default instruction set, where GCC warns
+     * that AVX vectors have no register calling convention.  That doesn't
+     * matter here, since the AVX2 instantiations are all inlined into
+     * 'generateAvx2' (and the warning comes out at the end of the file, so it
+     * can't be scoped with push/pop). */
+#   pragma GCC diagnostic ignored "-Wpsabi"
+
+    // Applies the ten Philox4x32 rounds to a vector of counters in place.
+    template<typename Ops>
+    inline void philox(const std::uint32_t key[2], typename Ops::U &x0,
+                       typename Ops::U &x1, typename Ops::U &x2,
+                       typename Ops::U &x3) {
+        typedef typename Ops::U U;
+        std::uint32_t k0 = key[0];
+        std::uint32_t k1 = key[1];
+        for (int round = 0; round < 10; round++) {
+            U hi0;
+            U lo0;
+            U hi1;
+            U lo1;
+            Ops::mulHiLo(x0, PHILOX_M0, hi0, lo0);
+            Ops::mulHiLo(x2, PHILOX_M1, hi1, lo1);
+            x0 = Ops::bitXor(Ops::bitXor(hi1, x1), Ops::splatU(k0));
+            x1 = lo1;
+            x2 = Ops::bitXor(Ops::bitXor(hi0, x3), Ops::splatU(k1));
+            x3 = lo0;
+            k0 += PHILOX_W0;
+            k1 += PHILOX_W1;
+        }
+    }
+
+    /* Computes sqrt(-2 ln u), where u is uniform on (0, 1] and drawn from
+     * the top 24 bits of the argument.  The logarithm is Cephes's logf. */
+    template<typename Ops>
+    inline void radius(const typename Ops::U &random, typename Ops::F &r) {
+        typedef typename Ops::F F;
+        typedef typename Ops::U U;
+        const F u = Ops::mul(
+            Ops::toFloat(Ops::add(Ops::template shr<8>(random),
+                                  Ops::splatU(1))),
+            Ops::splatF(1.0f / 16777216));
+        // Split u into m * 2^e, with m in [sqrt(1/2), sqrt(2)).
+        const U uBits = Ops::bits(u);
+        U e = Ops::sub(Ops::bitAnd(Ops::template shr<23>(uBits),
+                                   Ops::splatU(0xFF)),
+                       Ops::splatU(126));
+        const F m = Ops::fromBits(Ops::bitOr(Ops::bitAnd(uBits,
+                                                         Ops::splatU(0x7FFFFF)),
+                                             Ops::splatU(0x3F000000)));
+        const U small = Ops::less(m, Ops::splatF(0.707106781186547524f));
+        e = Ops::add(e, small);  // subtracts one where 'small' is set
+        const F x = Ops::sub(
+            Ops::add(m, Ops::fromBits(Ops::bitAnd(Ops::bits(m), small))),
+            Ops::splatF(1));
+        // ln m = ln(1 + x)
+        const F z = Ops::mul(x, x);
+        F y = Ops::splatF(7.0376836292e-2f);
+        y = Ops::sub(Ops::mul(y, x), Ops::splatF(1.1514610310e-1f));
+        y = Ops::add(Ops::mul(y, x), Ops::splatF(1.1676998740e-1f));
+        y = Ops::sub(Ops::mul(y, x), Ops::splatF(1.2420140846e-1f));
+        y = Ops::add(Ops::mul(y, x), Ops::splatF(1.4249322787e-1f));
+        y = Ops::sub(Ops::mul(y, x), Ops::splatF(1.6668057665e-1f));
+        y = Ops::add(Ops::mul(y, x), Ops::splatF(2.0000714765e-1f));
+        y = Ops::sub(Ops::mul(y, x), Ops::splatF(2.4999993993e-1f));
+        y = Ops::add(Ops::mul(y, x), Ops::splatF(3.3333331174e-1f));
+        y = Ops::mul(y, Ops::mul(x, z));
+        const F fe = Ops::toFloat(e);
+        y = Ops::sub(y, Ops::mul(fe, Ops::splatF(2.12194440e-4f)));
+        y = Ops::sub(y, Ops::mul(z, Ops::splatF(0.5f)));
+        F logU = Ops::add(x, y);
+        logU = Ops::add(logU, Ops::mul(fe, Ops::splatF(0.693359375f)));
+        r = Ops::sqrt(Ops::mul(logU, Ops::splatF(-2)));
+    }
+
+    /* Computes the sine and cosine of 2 pi u, where u is uniform on [0, 1)
+     * and drawn from the top 24 bits of the argument.  The angle is reduced
+     * to [-pi/4, pi/4] exactly, then handed to Cephes's sinf and cosf
+     * polynomials. */
+    template<typename Ops>
+    inline void sinCos(const typename Ops::U &random, typename Ops::F &sin,
+                       typename Ops::F &cos) {
+        typedef typename Ops::F F;
+        typedef typename Ops::U U;
+        // The angle in quarter turns
+        const F t = Ops::mul(Ops::toFloat(Ops::template shr<8>(random)),
+                             Ops::splatF(4.0f / 16777216));
+        const U quadrant = Ops::truncate(Ops::add(t, Ops::splatF(0.5f)));
+        const F x = Ops::mul(Ops::sub(t, Ops::toFloat(quadrant)),
+                             Ops::splatF(1.57079632679489662f));
+        const F z = Ops::mul(x, x);
+        F s = Ops::splatF(-1.9515295891e-4f);
+        s = Ops::add(Ops::mul(s, z), Ops::splatF(8.3321608736e-3f));
+        s = Ops::sub(Ops::mul(s, z), Ops::splatF(1.6666654611e-1f));
+        s = Ops::add(Ops::mul(Ops::mul(s, z), x), x);
+        F c = Ops::splatF(2.443315711809948e-5f);
+        c = Ops::sub(Ops::mul(c, z), Ops::splatF(1.388731625493765e-3f));
+        c = Ops::add(Ops::mul(c, z), Ops::splatF(4.166664568298827e-2f));
+        c = Ops::mul(Ops::mul(c, z), z);
+        c = Ops::add(Ops::sub(c, Ops::mul(z, Ops::splatF(0.5f))),
+                     Ops::splatF(1));
+        // Rotate by the quadrant.
+        const U odd = Ops::equal(Ops::bitAnd(quadrant, Ops::splatU(1)),
+                                 Ops::splatU(1));
+        const U sinSign = Ops::template shl<30>(
+            Ops::bitAnd(quadrant, Ops::splatU(2)));
+        const U cosSign = Ops::template shl<30>(
+            Ops::bitAnd(Ops::add(quadrant, Ops::splatU(1)), Ops::splatU(2)));
+        sin = Ops::fromBits(Ops::bitXor(Ops::bits(Ops::select(odd, c, s)),
+                                        sinSign));
+        cos = Ops::fromBits(Ops::bitXor(Ops::bits(Ops::select(odd, s, c)),
+                                        cosSign));
+    }
+
+    /* Writes a block of standard normal samples.  Lane i of the block uses
+     * the counter (8 * block + i, stream): its first two output words make
+     * samples i and 8 + i, and its last two make samples 16 + i and 24 + i. */
+    template<typename Ops>
+    inline void generate(const std::uint32_t key[2],
+                         const std::uint64_t stream,
+                         const std::uint64_t block, float *const out) {
+        typedef typename Ops::F F;
+        typedef typename Ops::U U;
+        const std::uint64_t first = block * LANES;
+        for (std::size_t lane = 0; lane < LANES; lane += Ops::WIDTH) {
+            U x0 = Ops::bitOr(
+                Ops::splatU(static_cast<std::uint32_t>(first)),
+                Ops::load(LANE_INDEX + lane));
+            U x1 = Ops::splatU(static_cast<std::uint32_t>(first >> 32));
+            U x2 = Ops::splatU(static_cast<std::uint32_t>(stream));
+            U x3 = Ops::splatU(static_cast<std::uint32_t>(stream >> 32));
+            philox<Ops>(key, x0, x1, x2, x3);
+            F r;
+            F sin;
+            F cos;
+            radius<Ops>(x0, r);
+            sinCos<Ops>(x1, sin, cos);
+            Ops::store(out + lane, Ops::mul(r, cos));
+            Ops::store(out + LANES + lane, Ops::mul(r, sin));
+            radius<Ops>(x2, r);
+            sinCos<Ops>(x3, sin, cos);
+            Ops::store(out + 2 * LANES + lane, Ops::mul(r, cos));
+            Ops::store(out + 3 * LANES + lane, Ops::mul(r, sin));
+        }
+    }
+
+    void generateScalar(const std::uint32_t key[2],
+                        const std::uint64_t stream, const std::uint64_t block,
+                        float *const out) {
+        generate<ScalarOps>(key, stream, block, out);
+    }
+
+#   ifdef HAVE_X86_SIMD_DISPATCH
+
+    /* 'flatten' inlines the generic kernel into these, so it gets compiled
+     * for the right instruction set and no vector crosses a call. */
+
+    __attribute__((target("sse2"), flatten))
+    void generateSse2(const std::uint32_t key[2],
+                      const std::uint64_t stream, const std::uint64_t block,
+                      float *const out) {
+        generate<Sse2Ops>(key, stream, block, out);
+    }
+
+    __attribute__((target("avx2"), flatten))
+    void generateAvx2(const std::uint32_t key[2],
+                      const std::uint64_t stream, const std::uint64_t block,
+                      float *const out) {
+        generate<Avx2Ops>(key, stream, block, out);
+    }
+
+#   endif
+
+}
+
+
+void philox4x32(const std::uint32_t counter[4], const std::uint32_t key[2],
+                std::uint32_t out[4]) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = counter[i];
+    }
+    philox<ScalarOps>(key, out[0], out[1], out[2], out[3]);
+}
+
+
+// class NormalSampler
+
+NormalSampler::NormalSampler(const std::uint64_t seed,
+                             const std::uint64_t stream, const cpu::Isa isa)
+    : stream(stream), block(0), kernel(generateScalar), nSpare(0) {
+    key[0] = static_cast<std::uint32_t>(seed);
+    key[1] = static_cast<std::uint32_t>(seed >> 32);
+#   ifdef HAVE_X86_SIMD_DISPATCH
+        if (isa == cpu::Isa::AVX2) {
+            kernel = generateAvx2;
+        } else if (isa == cpu::Isa::SSE2) {
+            kernel = generateSse2;
+        }
+#   else
+        static_cast<void>(isa);
+#   endif
+}
+
+void NormalSampler::fill(const Span<float> out, const float mean,
+                         const float stddev) {
+    float *next = out.data();
+    float *const end = next + out.size();
+    // Hand out samples left over from the last call first.
+    for (; next < end && nSpare > 0; nSpare--) {
+        *next++ = spare[BLOCK - nSpare];
+    }
+    // Generate whole blocks in place.
+    for (; end - next >= static_cast<std::ptrdiff_t>(BLOCK); next += BLOCK) {
+        kernel(key, stream, block++, next);
+    }
+    // Generate one more block for the remainder, saving the rest.
+    if (next < end) {
+        refill();
+        for (; next < end; nSpare--) {
+            *next++ = spare[BLOCK - nSpare];
+        }
+    }
+    // Shift and scale, exactly as 'next' does.
+    for (float &x : out) {
+        x = x * stddev + mean;
+    }
+}
+
+void NormalSampler::seek(const std::uint64_t k) {
+    block = k / BLOCK;
+    nSpare = 0;
+    if (k % BLOCK != 0) {
+        refill();
+        nSpare = BLOCK - k % BLOCK;
+    }
+}
+
+void NormalSampler::refill() {
+    kernel(key, stream, block++, spare);
+    nSpare = BLOCK;
+}
@@ -0,0 +1,92 @@
+/* sampler.h -- generating normally distributed samples in bulk
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifndef PPAML_VREP_AUTOMOBILE_PLUGIN_SAMPLER_H
+#define PPAML_VREP_AUTOMOBILE_PLUGIN_SAMPLER_H
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cstddef>
+#include <cstdint>
+
+#include "cpu.h"
+#include "span.h"
+
+/* The Philox4x32-10 counter-based generator (Salmon et al., "Parallel Random
+ * Numbers: As Easy as 1, 2, 3," SC 2011): a keyed bijection from 128-bit
+ * counters to 128-bit outputs.  This is the scalar reference version; the
+ * sampler uses vectorized copies of the same rounds. */
+void philox4x32(const std::uint32_t counter[4], const std::uint32_t key[2],
+                std::uint32_t out[4]);
+
+/* A generator of normally distributed floats which produces whole arrays at
+ * a time.  Samples come from Philox4x32-10 and the Box-Muller transform, and
+ * sample k of stream s is a pure function of (seed, s, k): nothing depends on
+ * how requests are split into calls, on the instruction set used, or on what
+ * other streams are doing.  Any stream can therefore be regenerated exactly,
+ * and streams (or pieces of one stream, via 'seek') can be produced in
+ * parallel.
+ *
+ * Uniforms carry 24 bits, so samples are never more than about 5.8 standard
+ * deviations from the mean. */
+class NormalSampler {
+public:
+    NormalSampler(std::uint64_t seed, std::uint64_t stream,
+                  cpu::Isa = cpu::bestIsa());
+
+    // Fills the passed array with samples from N(mean, stddev^2).
+    void fill(Span<float>, float mean = 0, float stddev = 1);
+
+    // Returns one sample from N(mean, stddev^2).
+    inline float next(float mean = 0, float stddev = 1);
+
+    // Arranges for the next sample handed out to be sample k of the stream.
+    void seek(std::uint64_t k);
+
+    // The index in the stream of the next sample to be handed out
+    inline std::uint64_t position() const;
+
+    // The number of Philox counters evaluated side by side
+    static const std::size_t LANES = 8;
+    // The number of samples produced per step: four per counter
+    static const std::size_t BLOCK = 4 * LANES;
+
+private:
+    typedef void Kernel(const std::uint32_t key[2], std::uint64_t stream,
+                        std::uint64_t block, float *out);
+
+    // Generates the next block into 'spare'.
+    void refill();
+
+    std::uint32_t key[2];
+    std::uint64_t stream;
+    // The index of the next block to generate
+    std::uint64_t block;
+    Kernel *kernel;
+    // Samples generated but not yet handed out
+    float spare[BLOCK];
+    std::size_t nSpare;
+};
+
+#include "sampler-inl.h"
+
+#endif
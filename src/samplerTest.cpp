@@ -0,0 +1,243 @@
+/* samplerTest.cpp -- unit tests for the batch Gaussian sampler
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "cpu.h"
+#include "noise.h"
+#include "sampler.h"
+#include "span.h"
+#include "unitTest.h"
+
+namespace {
+
+    /* The seeds are fixed, so every run draws the same samples and a test
+     * which passes once always passes.  The tolerances are still set as if
+     * the samples were fresh, at five standard errors, so a sampler that
+     * passes is one whose moments are right, not one tuned to these
+     * seeds. */
+
+    const unsigned int TOLERANCE = 5;
+
+    // Samples per moment check
+    const std::size_t N_SAMPLES = std::size_t(1) << 20;
+
+    // (seed, stream) pairs to draw from
+    const std::uint64_t STREAMS[][2] = {
+        {1, 0},
+        {20140601, 3},
+        {0xfedcba9876543210ULL, 0xffffffffffffffffULL},
+    };
+
+    /* Fails unless the mean and variance of the samples are those of
+     * N(mean, stddev^2), to within the tolerance.  'what' names the samples
+     * in the message. */
+    void expectNormal(Span<const float>, double mean, double stddev,
+                      const std::string &what);
+
+    std::string describeStream(const char *source, std::uint64_t seed,
+                               std::uint64_t stream);
+
+    // Checks the moments of each stream through 'fill'.
+    void checkMoments(cpu::Isa);
+
+
+    // Tests //
+
+    void scalarMoments() {
+        checkMoments(cpu::Isa::SCALAR);
+    }
+
+    void sse2Moments() {
+        checkMoments(cpu::Isa::SSE2);
+    }
+
+    void avx2Moments() {
+        checkMoments(cpu::Isa::AVX2);
+    }
+
+    // Every instruction set gives the same bits.
+    void isaIndependence() {
+        unitTest::requireIsa(cpu::Isa::SSE2);
+        const cpu::Isa vectorIsas[] = {cpu::Isa::SSE2, cpu::Isa::AVX2};
+        std::vector<float> expected(10000);
+        std::vector<float> actual(expected.size());
+        for (const std::uint64_t *const stream : STREAMS) {
+            NormalSampler(stream[0], stream[1], cpu::Isa::SCALAR)
+                .fill(expected);
+            for (const cpu::Isa isa : vectorIsas) {
+                if (cpu::bestIsa() < isa) {
+                    continue;
+                }
+                NormalSampler(stream[0], stream[1], isa).fill(actual);
+                unitTest::expect(
+                    std::memcmp(expected.data(), actual.data(),
+                                expected.size() * sizeof(float)) == 0,
+                    describeStream(cpu::name(isa), stream[0], stream[1])
+                    + " differs from the scalar sampler");
+            }
+        }
+    }
+
+    /* Samples are the same however they are asked for: in one 'fill', in
+     * fills of odd sizes, one by one, or after seeking. */
+    void splitIndependence() {
+        const std::size_t n = 1000;
+        const std::uint64_t seed = STREAMS[1][0];
+        const std::uint64_t stream = STREAMS[1][1];
+        std::vector<float> expected(n);
+        NormalSampler(seed, stream).fill(expected);
+
+        std::vector<float> pieces(n);
+        NormalSampler sampler(seed, stream);
+        std::size_t done = 0;
+        for (std::size_t size = 1; done < n; size = size * 3 + 1) {
+            const std::size_t piece = std::min(size, n - done);
+            sampler.fill(Span<float>(pieces.data() + done, piece));
+            done += piece;
+            if (done < n) {
+                pieces[done++] = sampler.next();
+            }
+        }
+        unitTest::expect(
+            std::memcmp(expected.data(), pieces.data(),
+                        n * sizeof(float)) == 0,
+            "samples drawn piecemeal differ from one fill");
+
+        const std::size_t starts[] = {0, 1, 31, 32, 33, 500, 999};
+        for (const std::size_t start : starts) {
+            sampler.seek(start);
+            unitTest::expect(sampler.position() == start,
+                             "seek(" + std::to_string(start)
+                             + ") left the position at "
+                             + std::to_string(sampler.position()));
+            std::vector<float> rest(n - start);
+            sampler.fill(rest);
+            unitTest::expect(
+                std::memcmp(expected.data() + start, rest.data(),
+                            rest.size() * sizeof(float)) == 0,
+                "samples after seek(" + std::to_string(start)
+                + ") differ from one fill");
+        }
+    }
+
+    // The noise sources shift and scale through both of their interfaces.
+    void noiseSourceMoments() {
+        const float mean = 3;
+        const float stddev = 0.25f;
+        std::vector<float> samples(N_SAMPLES);
+        for (const std::uint64_t *const stream : STREAMS) {
+            GaussianNoiseSource filled(mean, stddev, stream[0], stream[1]);
+            filled.fill(samples);
+            expectNormal(samples, mean, stddev,
+                         describeStream("GaussianNoiseSource::fill",
+                                        stream[0], stream[1]));
+            GaussianNoiseSource drawn(mean, stddev, stream[0],
+                                      stream[1] ^ 1);
+            for (float &x : samples) {
+                x = drawn.get();
+            }
+            expectNormal(samples, mean, stddev,
+                         describeStream("GaussianNoiseSource::get",
+                                        stream[0], stream[1] ^ 1));
+        }
+    }
+
+    const unitTest::Test TESTS[] = {
+        {"NormalSampler::fill/moments/scalar", scalarMoments},
+        {"NormalSampler::fill/moments/sse2", sse2Moments},
+        {"NormalSampler::fill/moments/avx2", avx2Moments},
+        {"NormalSampler::fill/isa", isaIndependence},
+        {"NormalSampler::seek", splitIndependence},
+        {"GaussianNoiseSource/moments", noiseSourceMoments},
+    };
+
+}
+
+namespace unitTest {
+
+    const Span<const Test> samplerTests(TESTS,
+                                        sizeof TESTS / sizeof TESTS[0]);
+
+}
+
+
+namespace {
+
+    void checkMoments(const cpu::Isa isa) {
+        unitTest::requireIsa(isa);
+        std::vector<float> samples(N_SAMPLES);
+        for (const std::uint64_t *const stream : STREAMS) {
+            NormalSampler(stream[0], stream[1], isa).fill(samples);
+            expectNormal(samples, 0, 1,
+                         describeStream(cpu::name(isa), stream[0],
+                                        stream[1]));
+        }
+    }
+
+    void expectNormal(const Span<const float> samples, const double mean,
+                      const double stddev, const std::string &what) {
+        const double n = static_cast<double>(samples.size());
+        double sum = 0;
+        for (const float x : samples) {
+            sum += x;
+        }
+        const double sampleMean = sum / n;
+        double sumOfSquares = 0;
+        for (const float x : samples) {
+            sumOfSquares += (x - sampleMean) * (x - sampleMean);
+        }
+        const double sampleVariance = sumOfSquares / (n - 1);
+
+        const double variance = stddev * stddev;
+        // Standard errors of the sample mean and variance of a normal
+        const double meanError = stddev / std::sqrt(n);
+        const double varianceError = variance * std::sqrt(2 / (n - 1));
+        char message[200];
+        std::snprintf(message, sizeof message,
+                      ": mean %.6g, variance %.6g; expected %g and %g",
+                      sampleMean, sampleVariance, mean, variance);
+        unitTest::expect(
+            std::fabs(sampleMean - mean) <= TOLERANCE * meanError
+            && std::fabs(sampleVariance - variance)
+               <= TOLERANCE * varianceError,
+            what + message);
+    }
+
+    std::string describeStream(const char *const source,
+                               const std::uint64_t seed,
+                               const std::uint64_t stream) {
+        return std::string(source) + " seed " + std::to_string(seed)
+            + " stream " + std::to_string(stream);
+    }
+
+}
@@ -0,0 +1,783 @@
+/* sink.cpp -- low-level output backends
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef HAVE_IO_URING
+#   include <linux/io_uring.h>
+#   include <sys/syscall.h>
+#   include <sys/uio.h>
+#endif
+
+#include "sink.h"
+
+namespace output {
+
+    namespace {
+
+        // Size of the buffer in front of a buffered file
+        const std::size_t BUFFER_SIZE = 256 * 1024;
+
+        /* Size of the part of a memory-mapped file which is mapped at once.
+         * It must be a multiple of the page size. */
+        const std::size_t WINDOW_SIZE = 8 * 1024 * 1024;
+        // How far ahead of the window to preallocate space
+        const off_t PREALLOCATION = 64 * 1024 * 1024;
+        /* The file name extension of the file holding a memory-mapped file's
+         * logical size, appended to the file's name */
+        const std::string SIZE_EXTENSION = ".size";
+
+        // Number and size of the buffers handed to io_uring
+        const unsigned int URING_BUFFERS = 4;
+        const std::size_t URING_BUFFER_SIZE = 1024 * 1024;
+
+
+        // Plumbing //
+
+        // Writes all the passed bytes to a file descriptor.
+        void writeAll(const int fd, const char *data, std::size_t size,
+                      const std::string &path) {
+            while (size > 0) {
+                const ssize_t written = ::write(fd, data, size);
+                if (written < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    throw IoError("could not write to", path);
+                }
+                data += written;
+                size -= written;
+            }
+        }
+
+        // Returns the size of an open file.
+        off_t sizeOf(const int fd, const std::string &path) {
+            struct stat status;
+            if (fstat(fd, &status) != 0) {
+                throw IoError("could not open", path);
+            }
+            return status.st_size;
+        }
+
+
+        // Buffered //
+
+        class BufferedSink : public Sink {
+        public:
+            explicit BufferedSink(const std::string &path);
+            virtual ~BufferedSink();
+
+            virtual void write(const char *, std::size_t);
+            virtual void close();
+
+        private:
+            void flush();
+
+            const std::string path;
+            int fd;
+            std::vector<char> buffer;
+            std::size_t used;
+        };
+
+        BufferedSink::BufferedSink(const std::string &path)
+            : path(path),
+              fd(::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                        0666)),
+              buffer(BUFFER_SIZE), used(0) {
+            if (fd < 0) {
+                throw IoError("could not open", path);
+            }
+        }
+
+        BufferedSink::~BufferedSink() {
+            if (fd >= 0) {
+                try {
+                    flush();
+                } catch (const IoError &) {
+                }
+                ::close(fd);
+            }
+        }
+
+        void BufferedSink::write(const char *const data,
+                                 const std::size_t size) {
+            if (used + size > buffer.size()) {
+                flush();
+            }
+            if (size >= buffer.size()) {
+                // No point copying it.
+                writeAll(fd, data, size, path);
+            } else {
+                std::memcpy(&buffer[used], data, size);
+                used += size;
+            }
+        }
+
+        void BufferedSink::flush() {
+            writeAll(fd, buffer.data(), used, path);
+            used = 0;
+        }
+
+        void BufferedSink::close() {
+            if (fd >= 0) {
+                flush();
+                const int status = ::close(fd);
+                fd = -1;
+                if (status != 0) {
+                    throw IoError("could not close", path);
+                }
+            }
+        }
+
+
+        // Memory-mapped //
+
+        /* While it is open, a memory-mapped file runs on past its data into
+         * the space allocated ahead of the window, which reads as zeros.  If
+         * the run dies before the file is closed, the padding stays, and it
+         * cannot be told from zeros in the data (an Arrow stream's or a
+         * compressed block's, say).  So the sink keeps the file's logical size
+         * in a small file next to it, mapped too, so that keeping it current
+         * costs one store per write.  It survives the process dying just as
+         * the window does.  Opening the file again trims it to that size;
+         * closing it trims the file and removes the size file. */
+        class MappedSink : public Sink {
+        public:
+            explicit MappedSink(const std::string &path);
+            virtual ~MappedSink();
+
+            virtual void write(const char *, std::size_t);
+            virtual void close();
+
+        private:
+            // Maps the window holding the end of the file.
+            void slide();
+
+            // Makes sure the file has space up to the passed offset.
+            void reserve(off_t end);
+
+            /* Trims the file to the size a sink which was never closed left
+             * in the size file, if there is one. */
+            void recover();
+
+            // Opens and maps the size file.
+            void mapSize();
+
+            /* Unmaps the window, trims the preallocated space, and removes the
+             * size file. */
+            void release();
+
+            const std::string path;
+            const std::string sizePath;
+            int fd;
+            // The logical end of the file
+            off_t size;
+            // The end of the space allocated to the file
+            off_t allocated;
+            char *window;
+            off_t windowStart;
+            // The logical size, as the size file holds it
+            std::uint64_t *mappedSize;
+        };
+
+        MappedSink::MappedSink(const std::string &path)
+            : path(path),
+              sizePath(path + SIZE_EXTENSION),
+              fd(::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666)),
+              size(0), allocated(0), window(nullptr), windowStart(0),
+              mappedSize(nullptr) {
+            if (fd < 0) {
+                throw IoError("could not open", path);
+            }
+            try {
+                recover();
+                size = sizeOf(fd, path);
+                allocated = size;
+                mapSize();
+            } catch (const IoError &) {
+                ::close(fd);
+                throw;
+            }
+        }
+
+        MappedSink::~MappedSink() {
+            if (fd >= 0) {
+                try {
+                    release();
+                } catch (const IoError &) {
+                }
+                ::close(fd);
+            }
+        }
+
+        void MappedSink::recover() {
+            const int sizeFd = ::open(sizePath.c_str(), O_RDONLY | O_CLOEXEC);
+            if (sizeFd < 0) {
+                return;
+            }
+            std::uint64_t logicalSize;
+            const ssize_t got =
+                ::read(sizeFd, &logicalSize, sizeof logicalSize);
+            ::close(sizeFd);
+            // Ignore a size file which doesn't fit the file.
+            if (got == static_cast<ssize_t>(sizeof logicalSize)
+                && logicalSize <= static_cast<std::uint64_t>(sizeOf(fd, path))
+                && ftruncate(fd, logicalSize) != 0) {
+                throw IoError("could not trim", path);
+            }
+        }
+
+        void MappedSink::mapSize() {
+            const int sizeFd = ::open(sizePath.c_str(),
+                                      O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+            if (sizeFd < 0) {
+                throw IoError("could not open", sizePath);
+            }
+            void *mapping = MAP_FAILED;
+            if (ftruncate(sizeFd, sizeof *mappedSize) == 0) {
+                mapping = mmap(nullptr, sizeof *mappedSize,
+                               PROT_READ | PROT_WRITE, MAP_SHARED, sizeFd, 0);
+            }
+            // The mapping keeps the file open.
+            ::close(sizeFd);
+            if (mapping == MAP_FAILED) {
+                throw IoError("could not map", sizePath);
+            }
+            mappedSize = static_cast<std::uint64_t *>(mapping);
+            *mappedSize = size;
+        }
+
+        void MappedSink::write(const char *data, std::size_t remaining) {
+            while (remaining > 0) {
+                if (! window
+                    || size >= windowStart + static_cast<off_t>(WINDOW_SIZE)) {
+                    slide();
+                }
+                const std::size_t offset = size - windowStart;
+                const std::size_t chunk =
+                    std::min(remaining, WINDOW_SIZE - offset);
+                std::memcpy(window + offset, data, chunk);
+                data += chunk;
+                remaining -= chunk;
+                size += chunk;
+            }
+            *mappedSize = size;
+        }
+
+        void MappedSink::slide() {
+            if (window) {
+                munmap(window, WINDOW_SIZE);
+                window = nullptr;
+            }
+            // Windows start on window boundaries, which are page boundaries.
+            windowStart = size - size % WINDOW_SIZE;
+            reserve(windowStart + WINDOW_SIZE);
+            void *const mapping = mmap(nullptr, WINDOW_SIZE, PROT_WRITE,
+                                       MAP_SHARED, fd, windowStart);
+            if (mapping == MAP_FAILED) {
+                throw IoError("could not map", path);
+            }
+            window = static_cast<char *>(mapping);
+        }
+
+        void MappedSink::reserve(const off_t end) {
+            if (end <= allocated) {
+                return;
+            }
+            const off_t target = end + PREALLOCATION;
+            /* Really allocate the space if the file system can, so running
+             * out of disk is an error here rather than a SIGBUS later.  If it
+             * can't, settle for a sparse file. */
+#           ifdef HAVE_FALLOCATE
+                if (fallocate(fd, 0, allocated, target - allocated) == 0) {
+                    allocated = target;
+                    return;
+                }
+                if (errno != EOPNOTSUPP && errno != ENOSYS) {
+                    throw IoError("could not allocate space for", path);
+                }
+#           endif
+            if (ftruncate(fd, target) != 0) {
+                throw IoError("could not allocate space for", path);
+            }
+            allocated = target;
+        }
+
+        void MappedSink::release() {
+            if (window) {
+                munmap(window, WINDOW_SIZE);
+                window = nullptr;
+            }
+            if (allocated != size) {
+                if (ftruncate(fd, size) != 0) {
+                    throw IoError("could not trim", path);
+                }
+                allocated = size;
+            }
+            // The file is its logical size now, so the size file can go.
+            if (mappedSize) {
+                munmap(mappedSize, sizeof *mappedSize);
+                mappedSize = nullptr;
+                ::unlink(sizePath.c_str());
+            }
+        }
+
+        void MappedSink::close() {
+            if (fd >= 0) {
+                release();
+                const int status = ::close(fd);
+                fd = -1;
+                if (status != 0) {
+                    throw IoError("could not close", path);
+                }
+            }
+        }
+
+
+#       ifdef HAVE_IO_URING
+
+            // io_uring //
+
+            /* Writes all the passed bytes to a file descriptor at an
+             * offset. */
+            void pwriteAll(const int fd, const char *data, std::size_t size,
+                           off_t offset, const std::string &path) {
+                while (size > 0) {
+                    const ssize_t written = ::pwrite(fd, data, size, offset);
+                    if (written < 0) {
+                        if (errno == EINTR) {
+                            continue;
+                        }
+                        throw IoError("could not write to", path);
+                    }
+                    data += written;
+                    size -= written;
+                    offset += written;
+                }
+            }
+
+            /* Just enough of an io_uring to write buffers to one file.  The
+             * ring is set up with raw system calls, so liburing is not
+             * needed. */
+            class Ring {
+            public:
+                /* Sets up a ring for writing the file at the passed path.
+                 * Throws 'IoError' if the kernel will not. */
+                Ring(const std::string &path, unsigned int entries);
+                inline ~Ring();
+                Ring(const Ring &) = delete;
+                Ring &operator=(const Ring &) = delete;
+
+                // Queues a write and submits it to the kernel.
+                void submitWritev(int fd, const iovec *, off_t offset,
+                                  std::uint64_t userData);
+
+                /* Waits for a completion and returns it.  The result is the
+                 * number of bytes written or a negated errno. */
+                void waitCompletion(std::uint64_t &userData, int &result);
+
+            private:
+                // Unmaps the ring and closes it.
+                void release();
+
+                const std::string path;
+                int fd;
+                void *sqRing;
+                std::size_t sqRingSize;
+                void *cqRing;
+                std::size_t cqRingSize;
+                io_uring_sqe *sqes;
+                std::size_t sqesSize;
+                unsigned int *sqTail;
+                unsigned int *sqMask;
+                unsigned int *sqArray;
+                unsigned int *cqHead;
+                unsigned int *cqTail;
+                unsigned int *cqMask;
+                io_uring_cqe *cqes;
+            };
+
+            Ring::Ring(const std::string &path, const unsigned int entries)
+                : path(path), fd(-1), sqRing(MAP_FAILED), sqRingSize(0),
+                  cqRing(MAP_FAILED), cqRingSize(0),
+                  sqes(static_cast<io_uring_sqe *>(MAP_FAILED)), sqesSize(0) {
+                io_uring_params params;
+                std::memset(&params, 0, sizeof params);
+                fd = syscall(__NR_io_uring_setup, entries, &params);
+                if (fd < 0) {
+                    throw IoError("could not set up io_uring for", path);
+                }
+                sqRingSize =
+                    params.sq_off.array + params.sq_entries * sizeof(unsigned);
+                cqRingSize =
+                    params.cq_off.cqes
+                    + params.cq_entries * sizeof(io_uring_cqe);
+                const bool singleMmap =
+                    params.features & IORING_FEAT_SINGLE_MMAP;
+                if (singleMmap) {
+                    sqRingSize = cqRingSize =
+                        std::max(sqRingSize, cqRingSize);
+                }
+                sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE, fd,
+                              IORING_OFF_SQ_RING);
+                cqRing = singleMmap
+                    ? sqRing
+                    : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+                sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+                sqes = static_cast<io_uring_sqe *>(
+                    mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+                if (sqRing == MAP_FAILED || cqRing == MAP_FAILED
+                    || sqes == MAP_FAILED) {
+                    release();
+                    throw IoError("could not map io_uring for", path);
+                }
+                char *const sq = static_cast<char *>(sqRing);
+                char *const cq = static_cast<char *>(cqRing);
+                sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+                sqMask =
+                    reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+                sqArray =
+                    reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+                cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+                cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+                cqMask =
+                    reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+                cqes = reinterpret_cast<io_uring_cqe *>(
+                    cq + params.cq_off.cqes);
+            }
+
+            Ring::~Ring() {
+                release();
+            }
+
+            void Ring::release() {
+                if (sqes != MAP_FAILED) {
+                    munmap(sqes, sqesSize);
+                    sqes = static_cast<io_uring_sqe *>(MAP_FAILED);
+                }
+                if (cqRing != MAP_FAILED && cqRing != sqRing) {
+                    munmap(cqRing, cqRingSize);
+                }
+                cqRing = MAP_FAILED;
+                if (sqRing != MAP_FAILED) {
+                    munmap(sqRing, sqRingSize);
+                    sqRing = MAP_FAILED;
+                }
+                if (fd >= 0) {
+                    ::close(fd);
+                    fd = -1;
+                }
+            }
+
+            void Ring::submitWritev(const int file, const iovec *const vec,
+                                    const off_t offset,
+                                    const std::uint64_t userData) {
+                // Only this thread moves the tail, so it can read it plainly.
+                const unsigned int tail = *sqTail;
+                const unsigned int index = tail & *sqMask;
+                io_uring_sqe &sqe = sqes[index];
+                std::memset(&sqe, 0, sizeof sqe);
+                sqe.opcode = IORING_OP_WRITEV;
+                sqe.fd = file;
+                sqe.addr = reinterpret_cast<std::uint64_t>(vec);
+                sqe.len = 1;
+                sqe.off = offset;
+                sqe.user_data = userData;
+                sqArray[index] = index;
+                // Publish the entry before the kernel can see the new tail.
+                __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+                while (syscall(__NR_io_uring_enter, fd, 1, 0, 0, nullptr, 0)
+                       < 0) {
+                    if (errno != EINTR) {
+                        throw IoError("could not submit a write to", path);
+                    }
+                }
+            }
+
+            void Ring::waitCompletion(std::uint64_t &userData, int &result) {
+                for (;;) {
+                    const unsigned int head = *cqHead;
+                    if (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+                        const io_uring_cqe &cqe = cqes[head & *cqMask];
+                        userData = cqe.user_data;
+                        result = cqe.res;
+                        __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+                        return;
+                    }
+                    if (syscall(__NR_io_uring_enter, fd, 0, 1,
+                                IORING_ENTER_GETEVENTS, nullptr, 0) < 0
+                        && errno != EINTR) {
+                        throw IoError("could not wait for a write to", path);
+                    }
+                }
+            }
+
+            /* A file written through io_uring.  Data are copied into one of
+             * a few large buffers; when it fills, it is submitted and the
+             * next one is used, so the disk works while the caller goes on.
+             * A buffer is only reused once its write has completed. */
+            class UringSink : public Sink {
+            public:
+                UringSink(const std::string &path,
+                          std::unique_ptr<Ring> &&ring);
+                virtual ~UringSink();
+
+                virtual void write(const char *, std::size_t);
+                virtual void close();
+
+            private:
+                // Submits the current buffer and moves on to the next.
+                void submit();
+
+                // Waits for a write to complete and checks it.
+                void reap();
+
+                // Waits for every write in flight.
+                void drain();
+
+                const std::string path;
+                int fd;
+                // The offset of the next buffer to be submitted
+                off_t offset;
+                std::vector<std::vector<char>> buffers;
+                std::vector<iovec> vecs;
+                std::vector<off_t> offsets;
+                std::vector<bool> inFlight;
+                unsigned int current;
+                std::size_t used;
+                /* Declared after the buffers, so it is torn down before the
+                 * kernel's view of them goes away */
+                std::unique_ptr<Ring> ring;
+            };
+
+            UringSink::UringSink(const std::string &path,
+                                 std::unique_ptr<Ring> &&ring)
+                : path(path),
+                  fd(::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC,
+                            0666)),
+                  offset(0), buffers(URING_BUFFERS), vecs(URING_BUFFERS),
+                  offsets(URING_BUFFERS), inFlight(URING_BUFFERS, false),
+                  current(0), used(0), ring(std::move(ring)) {
+                if (fd < 0) {
+                    throw IoError("could not open", path);
+                }
+                try {
+                    offset = sizeOf(fd, path);
+                } catch (const IoError &) {
+                    ::close(fd);
+                    throw;
+                }
+                for (std::vector<char> &buffer : buffers) {
+                    buffer.resize(URING_BUFFER_SIZE);
+                }
+            }
+
+            UringSink::~UringSink() {
+                if (fd >= 0) {
+                    try {
+                        close();
+                    } catch (const IoError &) {
+                        /* The kernel may still be reading the buffers, so
+                         * wait for whatever writes it will still finish. */
+                        try {
+                            for (unsigned int i = 0; i < URING_BUFFERS; i++) {
+                                while (inFlight[i]) {
+                                    try {
+                                        reap();
+                                    } catch (const IoError &) {
+                                        if (inFlight[i]) {
+                                            throw;
+                                        }
+                                    }
+                                }
+                            }
+                        } catch (const IoError &) {
+                        }
+                        if (fd >= 0) {
+                            ::close(fd);
+                        }
+                    }
+                }
+            }
+
+            void UringSink::write(const char *data, std::size_t size) {
+                while (size > 0) {
+                    const std::size_t chunk =
+                        std::min(size, URING_BUFFER_SIZE - used);
+                    std::memcpy(&buffers[current][used], data, chunk);
+                    used += chunk;
+                    data += chunk;
+                    size -= chunk;
+                    if (used == URING_BUFFER_SIZE) {
+                        submit();
+                    }
+                }
+            }
+
+            void UringSink::submit() {
+                if (used == 0) {
+                    return;
+                }
+                vecs[current].iov_base = buffers[current].data();
+                vecs[current].iov_len = used;
+                offsets[current] = offset;
+                ring->submitWritev(fd, &vecs[current], offset, current);
+                inFlight[current] = true;
+                offset += used;
+                current = (current + 1) % URING_BUFFERS;
+                used = 0;
+                while (inFlight[current]) {
+                    reap();
+                }
+            }
+
+            void UringSink::reap() {
+                std::uint64_t slot;
+                int result;
+                ring->waitCompletion(slot, result);
+                inFlight[slot] = false;
+                if (result < 0) {
+                    throw IoError("could not write to", path);
+                }
+                // Short writes are rare enough to finish synchronously.
+                const std::size_t written = result;
+                if (written < vecs[slot].iov_len) {
+                    pwriteAll(fd,
+                              static_cast<const char *>(vecs[slot].iov_base)
+                                  + written,
+                              vecs[slot].iov_len - written,
+                              offsets[slot] + written, path);
+                }
+            }
+
+            void UringSink::drain() {
+                for (unsigned int i = 0; i < URING_BUFFERS; i++) {
+                    while (inFlight[i]) {
+                        reap();
+                    }
+                }
+            }
+
+            void UringSink::close() {
+                if (fd >= 0) {
+                    submit();
+                    drain();
+                    const int status = ::close(fd);
+                    fd = -1;
+                    if (status != 0) {
+                        throw IoError("could not close", path);
+                    }
+                }
+            }
+
+#       endif
+
+    }
+
+    const char *name(const Backend backend) {
+        switch (backend) {
+        case Backend::MMAP:
+            return "mmap";
+        case Backend::URING:
+            return "uring";
+        default:
+            return "buffered";
+        }
+    }
+
+
+    // class Sink
+
+    Sink::~Sink() {
+    }
+
+    std::unique_ptr<Sink> openSink(const std::string &path,
+                                   const Backend backend) {
+        switch (backend) {
+        case Backend::MMAP:
+            return std::unique_ptr<Sink>(new MappedSink(path));
+        case Backend::URING:
+#           ifdef HAVE_IO_URING
+                {
+                    std::unique_ptr<Ring> ring;
+                    try {
+                        ring.reset(new Ring(path, URING_BUFFERS));
+                    } catch (const IoError &) {
+                        // The kernel is too old or won't let us.
+                        return std::unique_ptr<Sink>(new BufferedSink(path));
+                    }
+                    return std::unique_ptr<Sink>(
+                        new UringSink(path, std::move(ring)));
+                }
+#           endif
+        default:
+            return std::unique_ptr<Sink>(new BufferedSink(path));
+        }
+    }
+
+
+    // class SinkBuf
+
+    SinkBuf::SinkBuf(Sink &sink)
+        : std::streambuf(), sink(sink) {
+    }
+
+    SinkBuf::int_type SinkBuf::overflow(const int_type c) {
+        if (! traits_type::eq_int_type(c, traits_type::eof())) {
+            const char_type byte = traits_type::to_char_type(c);
+            sink.write(&byte, 1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize SinkBuf::xsputn(const char_type *const data,
+                                    const std::streamsize size) {
+        sink.write(data, size);
+        return size;
+    }
+
+
+    // Error handling //
+
+    IoError::IoError(const std::string &what, const std::string &path)
+        : std::runtime_error(what + " output file " + path) {
+    }
+
+}
@@ -0,0 +1,104 @@
+/* sink.h -- low-level output backends
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifndef PPAML_VREP_AUTOMOBILE_PLUGIN_SINK_H
+#define PPAML_VREP_AUTOMOBILE_PLUGIN_SINK_H
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cstddef>
+
+#include <memory>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+
+namespace output {
+
+    // The ways bytes can get from an output file to the disk
+    enum class Backend {
+        /* write(2) from a large buffer.  This is the default and works
+         * everywhere. */
+        BUFFERED,
+        /* Space is preallocated with fallocate(2) and bytes are copied into a
+         * window of the file mapped with mmap(2), which slides forward as the
+         * file grows.  No system call is made until the window is used up.
+         * The file's logical size is kept in a file next to it (its name plus
+         * ".size") until it is closed, so a file left padded by a crash is
+         * trimmed when it is next opened. */
+        MMAP,
+        /* Buffers are written with io_uring, so writing one does not wait for
+         * the kernel to copy it.  Falls back to BUFFERED if the plugin was
+         * built without io_uring (HAVE_IO_URING) or the kernel refuses to set
+         * up a ring. */
+        URING
+    };
+
+    // The name of a backend ("buffered", "mmap", or "uring")
+    const char *name(Backend);
+
+    /* The end of an output file: a place to append bytes.  A sink is opened
+     * on an existing file to continue it.  Sinks throw 'IoError' when the
+     * disk fails. */
+    class Sink {
+    public:
+        // Closes the file if it is still open, ignoring any error.
+        virtual ~Sink();
+
+        virtual void write(const char *, std::size_t) = 0;
+
+        // Writes out everything and closes the file.
+        virtual void close() = 0;
+    };
+
+    /* Opens the file at the passed path for appending, creating it if
+     * necessary.  The file's directory must already exist. */
+    std::unique_ptr<Sink> openSink(const std::string &path, Backend);
+
+    /* A stream buffer which passes everything straight through to a sink, for
+     * code that writes to a 'std::ostream'.  It does no buffering of its own;
+     * the sink does that.  Set 'badbit' in the stream's exception mask to get
+     * the sink's errors back out. */
+    class SinkBuf : public std::streambuf {
+    public:
+        explicit SinkBuf(Sink &);
+
+    protected:
+        virtual int_type overflow(int_type);
+        virtual std::streamsize xsputn(const char_type *, std::streamsize);
+
+    private:
+        Sink &sink;
+    };
+
+
+    // Error handling //
+
+    // An error signaling that an output file could not be opened or written.
+    class IoError : public std::runtime_error {
+    public:
+        IoError(const std::string &what, const std::string &path);
+    };
+
+}
+
+#endif
@@ -0,0 +1,220 @@
+/* sinkTest.cpp -- unit tests for output backends
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cstddef>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+
+#include <boost/filesystem.hpp>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "sink.h"
+#include "span.h"
+#include "unitTest.h"
+
+namespace {
+
+    // A path for a fresh temporary file, removed when it goes out of scope
+    class TemporaryFile {
+    public:
+        TemporaryFile();
+        ~TemporaryFile();
+
+        std::string path() const;
+
+    private:
+        const boost::filesystem::path path_;
+    };
+
+    // The size of the memory-mapped backend's window, as in sink.cpp
+    const std::size_t WINDOW_SIZE = 8 * 1024 * 1024;
+
+    const output::Backend BACKENDS[] = {
+        output::Backend::BUFFERED,
+        output::Backend::MMAP,
+        output::Backend::URING,
+    };
+
+    /* 'n' made-up bytes, zeros among them, ending in a run of zeros as
+     * Arrow streams and compressed blocks may */
+    std::string madeUpBytes(std::size_t n, unsigned int seed);
+
+    /* Appends bytes to the file through a sink, in chunks of assorted sizes,
+     * and closes the sink. */
+    void append(const std::string &path, output::Backend,
+                const std::string &bytes);
+
+    // The whole of a file
+    std::string readFile(const std::string &path);
+
+    // Fails unless the file holds just the passed bytes.
+    void expectFile(const std::string &path, const std::string &expected,
+                    const std::string &what);
+
+
+    // Tests //
+
+    /* Writes which cross window boundaries, from files opened before,
+     * after, and right on a boundary, come out whole. */
+    void crossesWindows() {
+        for (const output::Backend backend : BACKENDS) {
+            const TemporaryFile file;
+            const std::string bytes = madeUpBytes(2 * WINDOW_SIZE + 5000, 1);
+            const std::size_t stops[] = {
+                WINDOW_SIZE - 3,
+                WINDOW_SIZE + 100,
+                2 * WINDOW_SIZE,
+                bytes.size(),
+            };
+            std::size_t start = 0;
+            for (const std::size_t stop : stops) {
+                append(file.path(), backend,
+                       bytes.substr(start, stop - start));
+                start = stop;
+            }
+            expectFile(file.path(), bytes, output::name(backend));
+        }
+    }
+
+    /* A memory-mapped file whose writer died without closing it is trimmed
+     * to its data when it is opened again. */
+    void mappedRecoversFromCrash() {
+        const TemporaryFile file;
+        const std::string before = madeUpBytes(WINDOW_SIZE + 1000, 2);
+        const std::string after = madeUpBytes(3000, 3);
+        const pid_t child = fork();
+        if (child < 0) {
+            unitTest::skip("could not fork");
+        } else if (child == 0) {
+            // Die with the file open.
+            try {
+                const std::unique_ptr<output::Sink> sink =
+                    output::openSink(file.path(), output::Backend::MMAP);
+                sink->write(before.data(), before.size());
+                _exit(0);
+            } catch (...) {
+                _exit(1);
+            }
+        }
+        int status;
+        unitTest::expect(waitpid(child, &status, 0) == child
+                         && WIFEXITED(status) && WEXITSTATUS(status) == 0,
+                         "writer failed");
+        unitTest::expect(boost::filesystem::file_size(file.path())
+                         > before.size(),
+                         "crashed file not padded");
+        append(file.path(), output::Backend::MMAP, after);
+        expectFile(file.path(), before + after, "recovered file");
+        unitTest::expect(! boost::filesystem::exists(file.path() + ".size"),
+                         "size file left behind");
+    }
+
+    const unitTest::Test TESTS[] = {
+        {"sink/windows", crossesWindows},
+        {"sink/mmap/crash", mappedRecoversFromCrash},
+    };
+
+}
+
+namespace unitTest {
+
+    const Span<const Test> sinkTests(TESTS, sizeof TESTS / sizeof TESTS[0]);
+
+}
+
+
+namespace {
+
+    // class TemporaryFile
+
+    TemporaryFile::TemporaryFile()
+        : path_(boost::filesystem::temp_directory_path()
+                / boost::filesystem::unique_path("sink-test-%%%%-%%%%")) {
+    }
+
+    TemporaryFile::~TemporaryFile() {
+        boost::system::error_code error;
+        boost::filesystem::remove(path_, error);
+        boost::filesystem::remove(path_.string() + ".size", error);
+    }
+
+    std::string TemporaryFile::path() const {
+        return path_.string();
+    }
+
+
+    // Files //
+
+    std::string madeUpBytes(const std::size_t n, const unsigned int seed) {
+        std::mt19937 generator(seed);
+        std::string result(n, '\0');
+        for (char &byte : result) {
+            // Zero about one byte in four.
+            const unsigned int value = generator() % 1024;
+            byte = static_cast<char>(value < 256 ? 0 : value);
+        }
+        std::fill(result.end() - std::min<std::size_t>(n, 64), result.end(),
+                  '\0');
+        return result;
+    }
+
+    void append(const std::string &path, const output::Backend backend,
+                const std::string &bytes) {
+        const std::unique_ptr<output::Sink> sink =
+            output::openSink(path, backend);
+        std::size_t chunk = 1;
+        for (std::size_t start = 0; start < bytes.size(); start += chunk) {
+            chunk = std::min(chunk * 3 % 700001 + 1, bytes.size() - start);
+            sink->write(bytes.data() + start, chunk);
+        }
+        sink->close();
+    }
+
+    std::string readFile(const std::string &path) {
+        std::ifstream file(path, std::ios::in | std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(file),
+                           std::istreambuf_iterator<char>());
+    }
+
+
+    // Checks //
+
+    void expectFile(const std::string &path, const std::string &expected,
+                    const std::string &what) {
+        const std::string actual = readFile(path);
+        unitTest::expect(actual.size() == expected.size(),
+                         what + " has " + std::to_string(actual.size())
+                         + " bytes, not "
+                         + std::to_string(expected.size()));
+        unitTest::expect(actual == expected, what + " differs");
+    }
+
+}
@@ -0,0 +1,76 @@
+/* span-inl.h -- non-owning views of contiguous arrays
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifndef PPAML_VREP_AUTOMOBILE_PLUGIN_SPAN_INL_H
+#define PPAML_VREP_AUTOMOBILE_PLUGIN_SPAN_INL_H
+
+template<typename T>
+Span<T>::Span()
+    : data_(nullptr), size_(0) {
+}
+
+template<typename T>
+Span<T>::Span(T *const data, const std::size_t size)
+    : data_(data), size_(size) {
+}
+
+template<typename T>
+template<typename U>
+Span<T>::Span(std::vector<U> &vector)
+    : data_(vector.data()), size_(vector.size()) {
+}
+
+template<typename T>
+template<typename U>
+Span<T>::Span(const std::vector<U> &vector)
+    : data_(vector.data()), size_(vector.size()) {
+}
+
+template<typename T>
+T *Span<T>::data() const {
+    return data_;
+}
+
+template<typename T>
+std::size_t Span<T>::size() const {
+    return size_;
+}
+
+template<typename T>
+bool Span<T>::empty() const {
+    return size_ == 0;
+}
+
+template<typename T>
+T &Span<T>::operator[](const std::size_t i) const {
+    return data_[i];
+}
+
+template<typename T>
+typename Span<T>::iterator Span<T>::begin() const {
+    return data_;
+}
+
+template<typename T>
+typename Span<T>::iterator Span<T>::end() const {
+    return data_ + size_;
+}
+
+#endif
@@ -0,0 +1,64 @@
+/* span.h -- non-owning views of contiguous arrays
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifndef PPAML_VREP_AUTOMOBILE_PLUGIN_SPAN_H
+#define PPAML_VREP_AUTOMOBILE_PLUGIN_SPAN_H
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cstddef>
+
+#include <vector>
+
+/* A pointer and a length, standing in for an array owned by someone else.
+ * Copying a span copies neither the array nor its elements, so a span is only
+ * good for as long as the underlying array is.  Use 'Span<const T>' for a
+ * read-only view. */
+template<typename T>
+class Span {
+public:
+    typedef T *iterator;
+
+    inline Span();
+    inline Span(T *data, std::size_t size);
+
+    // Views the contents of a vector.  Resizing the vector invalidates this.
+    template<typename U>
+    inline Span(std::vector<U> &);
+    template<typename U>
+    inline Span(const std::vector<U> &);
+
+    inline T *data() const;
+    inline std::size_t size() const;
+    inline bool empty() const;
+    inline T &operator[](std::size_t) const;
+    inline iterator begin() const;
+    inline iterator end() const;
+
+private:
+    T *data_;
+    std::size_t size_;
+};
+
+#include "span-inl.h"
+
+#endif
@@ -0,0 +1,301 @@
+/* timeIndex.cpp -- binary sidecars mapping times to rows of data files
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "codec.h"
+#include "output.h"
+#include "sink.h"
+#include "span.h"
+#include "timeIndex.h"
+
+namespace timeIndex {
+
+    namespace {
+
+        const std::string MAGIC("TIMEIDX1");
+        const std::size_t ENTRY_SIZE = 12;
+        // The number of entries read at a time when reading a whole index
+        const std::size_t CHUNK = 4096;
+
+        void encode(const Entry &entry, char *const out) {
+            std::uint32_t bits;
+            std::memcpy(&bits, &entry.time, sizeof bits);
+            for (unsigned int i = 0; i < 4; i++) {
+                out[i] = static_cast<char>(bits >> 8 * i & 0xFF);
+            }
+            for (unsigned int i = 0; i < 8; i++) {
+                out[4 + i] = static_cast<char>(entry.offset >> 8 * i & 0xFF);
+            }
+        }
+
+        Entry decode(const char *const in) {
+            std::uint32_t bits = 0;
+            for (unsigned int i = 0; i < 4; i++) {
+                bits |= static_cast<std::uint32_t>(
+                    static_cast<unsigned char>(in[i])) << 8 * i;
+            }
+            Entry result;
+            std::memcpy(&result.time, &bits, sizeof bits);
+            result.offset = 0;
+            for (unsigned int i = 0; i < 8; i++) {
+                result.offset |= static_cast<unsigned long long>(
+                    static_cast<unsigned char>(in[4 + i])) << 8 * i;
+            }
+            return result;
+        }
+
+        // Reads and checks the magic number at the start of an index.
+        void checkMagic(std::istream &in, const std::string &path) {
+            std::string magic(MAGIC.size(), '\0');
+            in.read(&magic[0], magic.size());
+            if (! in || magic != MAGIC) {
+                throw output::IoError("bad time index in", path);
+            }
+        }
+
+        // For searching a seek table by uncompressed offset
+        bool startsAfter(const unsigned long long offset,
+                         const output::SeekEntry &block) {
+            return offset < block.uncompressedOffset;
+        }
+
+        // For sorting a reader's entries by time
+        template<typename Position>
+        bool earlier(const Position &a, const Position &b) {
+            return a.time < b.time;
+        }
+
+        // Whether a path ends with the compressed file extension
+        bool isCompressed(const std::string &path) {
+            const std::string &extension = codec::extension();
+            return ! extension.empty() && path.size() > extension.size()
+                && path.compare(path.size() - extension.size(),
+                                extension.size(), extension) == 0;
+        }
+
+    }
+
+    const std::string EXTENSION = ".idx";
+
+
+    // class Writer
+
+    Writer::Writer(const std::string &path)
+        : path(path), out() {
+        boost::system::error_code error;
+        const boost::uintmax_t size =
+            boost::filesystem::file_size(path, error);
+        const bool resuming = ! error && size > 0;
+        if (resuming) {
+            {
+                std::ifstream existing(path,
+                                       std::ios::in | std::ios::binary);
+                checkMagic(existing, path);
+            }
+            // Drop any partial entry a crash might have left behind.
+            const boost::uintmax_t whole = MAGIC.size()
+                + (size - MAGIC.size()) / ENTRY_SIZE * ENTRY_SIZE;
+            if (size > whole) {
+                boost::filesystem::resize_file(path, whole);
+            }
+        }
+        out.open(path, std::ios::out | std::ios::binary
+                           | (resuming ? std::ios::app : std::ios::trunc));
+        if (! out) {
+            throw output::IoError("could not open", path);
+        }
+        if (! resuming) {
+            out.write(MAGIC.data(), MAGIC.size());
+        }
+    }
+
+    void Writer::add(const float time, const unsigned long long offset) {
+        char bytes[ENTRY_SIZE];
+        const Entry entry = {time, offset};
+        encode(entry, bytes);
+        out.write(bytes, sizeof bytes);
+        if (! out) {
+            throw output::IoError("could not write to", path);
+        }
+    }
+
+    void Writer::close() {
+        if (out.is_open()) {
+            out.close();
+            if (! out) {
+                throw output::IoError("could not close", path);
+            }
+        }
+    }
+
+
+    // class Reader
+
+    Reader::Reader(const std::string &path)
+        : path(path), in(path, std::ios::in | std::ios::binary), size_(0),
+          sorted() {
+        checkMagic(in, path);
+        const boost::uintmax_t size = boost::filesystem::file_size(path);
+        size_ = (size - MAGIC.size()) / ENTRY_SIZE;
+        // Look for a time that goes backwards...
+        std::vector<char> bytes(CHUNK * ENTRY_SIZE);
+        bool ordered = true;
+        float last = 0;
+        for (std::size_t first = 0; first < size_ && ordered;
+             first += CHUNK) {
+            const std::size_t count = std::min(CHUNK, size_ - first);
+            read(first, count, &bytes[0]);
+            for (std::size_t i = 0; i < count && ordered; i++) {
+                const float time = decode(&bytes[i * ENTRY_SIZE]).time;
+                if (first + i > 0 && time < last) {
+                    ordered = false;
+                }
+                last = time;
+            }
+        }
+        if (ordered) {
+            return;
+        }
+        // ...and if there is one, sort the times, keeping ties in the
+        // index's order.
+        sorted.reserve(size_);
+        for (std::size_t first = 0; first < size_; first += CHUNK) {
+            const std::size_t count = std::min(CHUNK, size_ - first);
+            read(first, count, &bytes[0]);
+            for (std::size_t i = 0; i < count; i++) {
+                const Position position =
+                    {decode(&bytes[i * ENTRY_SIZE]).time, first + i};
+                sorted.push_back(position);
+            }
+        }
+        std::stable_sort(sorted.begin(), sorted.end(), earlier<Position>);
+    }
+
+    Entry Reader::operator[](const std::size_t i) {
+        if (i >= size_) {
+            throw std::out_of_range("time index entry out of range");
+        }
+        char bytes[ENTRY_SIZE];
+        read(i, 1, bytes);
+        return decode(bytes);
+    }
+
+    std::size_t Reader::nearest(const float time) {
+        if (size_ == 0) {
+            throw std::out_of_range("empty time index");
+        }
+        // Find the first entry at or after the time...
+        std::size_t low = 0;
+        std::size_t high = size_;
+        while (low < high) {
+            const std::size_t middle = low + (high - low) / 2;
+            if (timeAt(middle) < time) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        // ...and see whether the one before it is closer.
+        std::size_t rank;
+        if (low == size_) {
+            rank = size_ - 1;
+        } else if (low == 0) {
+            rank = 0;
+        } else {
+            rank = time - timeAt(low - 1) <= timeAt(low) - time
+                ? low - 1
+                : low;
+        }
+        return sorted.empty() ? rank : sorted[rank].position;
+    }
+
+    void Reader::read(const std::size_t first, const std::size_t count,
+                      char *const out) {
+        in.seekg(MAGIC.size() + first * ENTRY_SIZE);
+        in.read(out, count * ENTRY_SIZE);
+        if (! in) {
+            throw output::IoError("could not read", path);
+        }
+    }
+
+    float Reader::timeAt(const std::size_t rank) {
+        return sorted.empty() ? (*this)[rank].time : sorted[rank].time;
+    }
+
+
+    // Reading rows //
+
+    std::string readRow(const std::string &dataPath,
+                        const unsigned long long offset) {
+        std::string row;
+        if (! isCompressed(dataPath)) {
+            std::ifstream file(dataPath, std::ios::in | std::ios::binary);
+            file.seekg(offset);
+            if (! std::getline(file, row)) {
+                throw output::IoError("could not read", dataPath);
+            }
+            return row;
+        }
+        // Find the block holding the row, and decompress just that.
+        const std::vector<output::SeekEntry> table =
+            output::readSeekTable(dataPath);
+        std::vector<output::SeekEntry>::const_iterator block =
+            std::upper_bound(table.begin(), table.end(), offset, startsAfter);
+        if (block == table.begin()) {
+            throw output::IoError("offset not in", dataPath);
+        }
+        --block;
+        if (offset >= block->uncompressedOffset + block->uncompressedLength) {
+            throw output::IoError("offset not in", dataPath);
+        }
+        std::string compressed(block->length, '\0');
+        {
+            std::ifstream file(dataPath, std::ios::in | std::ios::binary);
+            file.seekg(block->offset);
+            file.read(&compressed[0], compressed.size());
+            if (! file) {
+                throw output::IoError("could not read", dataPath);
+            }
+        }
+        std::string rows;
+        codec::decompressBlock(
+            Span<const char>(compressed.data(), compressed.size()),
+            block->uncompressedLength, rows);
+        const std::string::size_type start =
+            offset - block->uncompressedOffset;
+        return rows.substr(start, rows.find('\n', start) - start);
+    }
+
+}
@@ -0,0 +1,124 @@
+/* timeIndex.h -- binary sidecars mapping times to rows of data files
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifndef PPAML_VREP_AUTOMOBILE_PLUGIN_TIME_INDEX_H
+#define PPAML_VREP_AUTOMOBILE_PLUGIN_TIME_INDEX_H
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cstddef>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+/* A time index sits next to a CSV data file, with the same name plus ".idx",
+ * and lets a reader find the row taken nearest a given time without parsing
+ * the file.  It is written a row at a time along with the data file.
+ *
+ * The index is an eight-byte magic number ("TIMEIDX1") followed by one
+ * twelve-byte entry per row: the row's time, as a little-endian IEEE 754
+ * single, and the offset of the start of the row, as a little-endian 64-bit
+ * unsigned integer.  The offset counts bytes of CSV text--for a compressed
+ * file, bytes of the decompressed text, which the file's seek table maps to
+ * a block.  Entries are in the order the rows were written, so their times
+ * can go backwards wherever the rows themselves do (as saves from several
+ * threads may). */
+namespace timeIndex {
+
+    // The file name extension of an index, appended to the data file's name
+    extern const std::string EXTENSION;
+
+    struct Entry {
+        float time;
+        unsigned long long offset;
+    };
+
+    // Appends entries to an index.
+    class Writer {
+    public:
+        /* Opens the index at the passed path, continuing it if it already
+         * has entries. */
+        explicit Writer(const std::string &path);
+
+        void add(float time, unsigned long long offset);
+
+        // Flushes and closes the index.  Throws if any write failed.
+        void close();
+
+    private:
+        const std::string path;
+        std::ofstream out;
+    };
+
+    /* Looks entries up in an index.  Opening a reader reads the index
+     * through once to see whether its times ever go backwards.  If they
+     * don't, a lookup reads just the O(log n) entries it needs; if they do,
+     * the reader keeps the entries' times in memory, sorted, and looks them
+     * up there. */
+    class Reader {
+    public:
+        explicit Reader(const std::string &path);
+
+        // The number of entries in the index
+        inline std::size_t size() const;
+
+        // Whether times never decrease from one entry to the next
+        inline bool ordered() const;
+
+        Entry operator[](std::size_t);
+
+        /* The position of the entry nearest the passed time (the earlier one
+         * in a tie), wherever it is in the index.  The index must not be
+         * empty. */
+        std::size_t nearest(float time);
+
+    private:
+        struct Position {
+            float time;
+            std::size_t position;
+        };
+
+        // Reads count entries, starting with the first, into out.
+        void read(std::size_t first, std::size_t count, char *out);
+
+        /* The time of the entry at the passed rank (the position in time
+         * order) */
+        float timeAt(std::size_t rank);
+
+        const std::string path;
+        std::ifstream in;
+        std::size_t size_;
+        // The entries in time order, when that isn't the index's order
+        std::vector<Position> sorted;
+    };
+
+    /* Reads the row of a CSV data file (plain or compressed) at the passed
+     * offset, without its newline.  A compressed file's row is found through
+     * its seek table, and only the block holding it is decompressed. */
+    std::string readRow(const std::string &dataPath, unsigned long long offset);
+
+}
+
+#include "timeIndex-inl.h"
+
+#endif
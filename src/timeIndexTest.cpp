@@ -0,0 +1,189 @@
+/* timeIndexTest.cpp -- unit tests for time indices
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cmath>
+#include <cstddef>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "span.h"
+#include "timeIndex.h"
+#include "unitTest.h"
+
+namespace {
+
+    // An index in a fresh temporary file, removed when it goes out of scope
+    class TemporaryIndex {
+    public:
+        // Writes the times to the index, with made-up offsets.
+        explicit TemporaryIndex(const std::vector<float> &times);
+        ~TemporaryIndex();
+
+        std::string path() const;
+
+    private:
+        const boost::filesystem::path path_;
+    };
+
+    /* Fails unless the index's nearest entry to each time has the nearest
+     * of the passed times--the earlier one in a tie--and the entry's offset
+     * is that of its own row. */
+    void expectNearest(timeIndex::Reader &, const std::vector<float> &times);
+
+    /* Jittered times, each a little after the last, except that every
+     * so often one is behind the one before, as rows saved from several
+     * threads can be. */
+    std::vector<float> jitteredTimes(std::size_t n, bool backwards);
+
+
+    // Tests //
+
+    // Times in order, with repeats, are searched in the file.
+    void searchesOrdered() {
+        std::vector<float> times = jitteredTimes(10000, false);
+        times.insert(times.begin() + 5000, 3, times[5000]);
+        const TemporaryIndex file(times);
+        timeIndex::Reader index(file.path());
+        unitTest::expect(index.size() == times.size(),
+                         std::to_string(index.size()) + " entries");
+        unitTest::expect(index.ordered(), "in-order index not ordered");
+        expectNearest(index, times);
+    }
+
+    // Times which go backwards are noticed, and still searched correctly.
+    void searchesBackwards() {
+        const std::vector<float> times = jitteredTimes(10000, true);
+        const TemporaryIndex file(times);
+        timeIndex::Reader index(file.path());
+        unitTest::expect(! index.ordered(), "out-of-order index ordered");
+        expectNearest(index, times);
+    }
+
+    // A single step backwards past the first chunk read is noticed too.
+    void findsLateStepBackwards() {
+        std::vector<float> times = jitteredTimes(9000, false);
+        std::swap(times[8000], times[8001]);
+        const TemporaryIndex file(times);
+        timeIndex::Reader index(file.path());
+        unitTest::expect(! index.ordered(), "out-of-order index ordered");
+        expectNearest(index, times);
+    }
+
+    const unitTest::Test TESTS[] = {
+        {"timeIndex/ordered", searchesOrdered},
+        {"timeIndex/backwards", searchesBackwards},
+        {"timeIndex/lateStepBackwards", findsLateStepBackwards},
+    };
+
+}
+
+namespace unitTest {
+
+    const Span<const Test> timeIndexTests(TESTS,
+                                          sizeof TESTS / sizeof TESTS[0]);
+
+}
+
+
+namespace {
+
+    // The made-up offset of the row at a position
+    unsigned long long offsetOf(const std::size_t position) {
+        return 1000 + 37ULL * position;
+    }
+
+
+    // class TemporaryIndex
+
+    TemporaryIndex::TemporaryIndex(const std::vector<float> &times)
+        : path_(boost::filesystem::temp_directory_path()
+                / boost::filesystem::unique_path(
+                    "time-index-test-%%%%-%%%%.idx")) {
+        timeIndex::Writer writer(path_.string());
+        for (std::size_t i = 0; i < times.size(); i++) {
+            writer.add(times[i], offsetOf(i));
+        }
+        writer.close();
+    }
+
+    TemporaryIndex::~TemporaryIndex() {
+        boost::filesystem::remove(path_);
+    }
+
+    std::string TemporaryIndex::path() const {
+        return path_.string();
+    }
+
+
+    // Checks //
+
+    void expectNearest(timeIndex::Reader &index,
+                       const std::vector<float> &times) {
+        std::mt19937 generator(22);
+        std::uniform_real_distribution<float> pick(-1, times.size() * 0.1f);
+        for (unsigned int i = 0; i < 2000; i++) {
+            // Ask for times between the rows', and exactly the rows' own.
+            const float time = i % 2 == 0
+                ? pick(generator)
+                : times[generator() % times.size()];
+            float expected = times[0];
+            for (const float candidate : times) {
+                const float distance = std::fabs(candidate - time);
+                const float best = std::fabs(expected - time);
+                if (distance < best
+                    || (distance == best && candidate < expected)) {
+                    expected = candidate;
+                }
+            }
+            const std::size_t found = index.nearest(time);
+            const timeIndex::Entry entry = index[found];
+            unitTest::expect(entry.time == expected,
+                             "nearest " + std::to_string(time) + " is "
+                             + std::to_string(entry.time) + ", not "
+                             + std::to_string(expected));
+            unitTest::expect(entry.offset == offsetOf(found),
+                             "entry " + std::to_string(found)
+                             + " has the wrong offset");
+        }
+    }
+
+    std::vector<float> jitteredTimes(const std::size_t n,
+                                     const bool backwards) {
+        std::mt19937 generator(7);
+        std::uniform_real_distribution<float> step(0.05f, 0.15f);
+        std::vector<float> result;
+        float time = 0;
+        for (std::size_t i = 0; i < n; i++) {
+            time += step(generator);
+            result.push_back(backwards && i % 97 == 50 ? time - 0.4f : time);
+        }
+        return result;
+    }
+
+}
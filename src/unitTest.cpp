@@ -0,0 +1,154 @@
+/* unitTest.cpp -- unit tests run by 'make check'
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <exception>
+#include <stdexcept>
+#include <string>
+
+#include "cpu.h"
+#include "span.h"
+#include "unitTest.h"
+
+namespace {
+
+    // Automake's test driver reads this exit status as "skipped".
+    const int EXIT_SKIPPED = 77;
+
+    // Every table of tests, in the order they run
+    const Span<const unitTest::Test> *const TABLES[] = {
+        &unitTest::csvTests,
+        &unitTest::lidarTests,
+        &unitTest::samplerTests,
+        &unitTest::reorderTests,
+        &unitTest::intakeTests,
+        &unitTest::arrowIpcTests,
+        &unitTest::timeIndexTests,
+        &unitTest::sinkTests,
+        &unitTest::outputTests,
+        &unitTest::automobileTests,
+    };
+
+    // Whether the test was asked for on the command line
+    bool isSelected(const unitTest::Test &, int argc, char *argv[]);
+
+}
+
+
+int main(int argc, char *argv[]) {
+    unsigned int passed = 0;
+    unsigned int failed = 0;
+    unsigned int skipped = 0;
+    for (const Span<const unitTest::Test> *const table : TABLES) {
+        for (const unitTest::Test &test : *table) {
+            if (! isSelected(test, argc, argv)) {
+                continue;
+            }
+            try {
+                test.run();
+                std::printf("PASS: %s\n", test.name);
+                passed++;
+            } catch (const unitTest::Skipped &reason) {
+                std::printf("SKIP: %s: %s\n", test.name, reason.what());
+                skipped++;
+            } catch (const std::exception &error) {
+                std::printf("FAIL: %s: %s\n", test.name, error.what());
+                failed++;
+            }
+            std::fflush(stdout);
+        }
+    }
+    if (passed + failed + skipped == 0) {
+        std::fprintf(stderr, "%s: no test matches the arguments\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    std::printf("%u passed, %u failed, %u skipped\n", passed, failed,
+                skipped);
+    if (failed > 0) {
+        return EXIT_FAILURE;
+    } else if (passed == 0) {
+        return EXIT_SKIPPED;
+    } else {
+        return EXIT_SUCCESS;
+    }
+}
+
+
+namespace {
+
+    bool isSelected(const unitTest::Test &test, const int argc,
+                    char *argv[]) {
+        if (argc <= 1) {
+            return true;
+        }
+        const std::string name = test.name;
+        for (int i = 1; i < argc; i++) {
+            if (name.compare(0, std::strlen(argv[i]), argv[i]) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+}
+
+
+namespace unitTest {
+
+    void expect(const bool held, const std::string &message) {
+        if (! held) {
+            throw Failure(message);
+        }
+    }
+
+    void skip(const std::string &reason) {
+        throw Skipped(reason);
+    }
+
+    void requireIsa(const cpu::Isa isa) {
+#       ifndef HAVE_X86_SIMD_DISPATCH
+            if (isa != cpu::Isa::SCALAR) {
+                skip("built without x86 SIMD kernels");
+            }
+#       endif
+        if (cpu::bestIsa() < isa) {
+            skip(std::string("the processor lacks ") + cpu::name(isa));
+        }
+    }
+
+
+    // Error handling //
+
+    Failure::Failure(const std::string &message)
+        : std::logic_error(message) {
+    }
+
+    Skipped::Skipped(const std::string &reason)
+        : std::runtime_error(reason) {
+    }
+
+}
@@ -0,0 +1,98 @@
+/* unitTest.h -- unit tests run by 'make check'
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifndef PPAML_VREP_AUTOMOBILE_PLUGIN_UNITTEST_H
+#define PPAML_VREP_AUTOMOBILE_PLUGIN_UNITTEST_H
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <stdexcept>
+#include <string>
+
+#include "cpu.h"
+#include "span.h"
+
+/* The unit tests are gathered into one program, which 'make check' runs.  Each
+ * module's tests live in a file named after it (lidarTest.cpp for lidar.cpp,
+ * and so on) as a table of named cases; unitTest.cpp runs the tables.  The
+ * program exits with status 0 if no test failed, 77 (which Automake reads as
+ * "skipped") if every test had to be skipped, and 1 otherwise.  Pass names of
+ * tests (or prefixes of them) to run only those tests. */
+
+namespace unitTest {
+
+    // A check of one behavior.  'run' fails the test by throwing anything.
+    struct Test {
+        const char *name;
+        void (*run)();
+    };
+
+    // Fails the running test with the passed message unless the check held.
+    void expect(bool, const std::string &message);
+
+    /* Gives up the running test, without failing it, because it cannot run
+     * on this machine or build. */
+    void skip(const std::string &reason);
+
+    /* Skips the running test unless kernels for the passed instruction set
+     * were built and the processor can run them. */
+    void requireIsa(cpu::Isa);
+
+    // Thrown by 'expect'
+    class Failure : public std::logic_error {
+    public:
+        explicit Failure(const std::string &message);
+    };
+
+    // Thrown by 'skip'
+    class Skipped : public std::runtime_error {
+    public:
+        explicit Skipped(const std::string &reason);
+    };
+
+
+    // Tables //
+
+    // Defined in arrowIpcTest.cpp
+    extern const Span<const Test> arrowIpcTests;
+    // Defined in automobileTest.cpp
+    extern const Span<const Test> automobileTests;
+    // Defined in csvTest.cpp
+    extern const Span<const Test> csvTests;
+    // Defined in intakeTest.cpp
+    extern const Span<const Test> intakeTests;
+    // Defined in lidarTest.cpp
+    extern const Span<const Test> lidarTests;
+    // Defined in outputTest.cpp
+    extern const Span<const Test> outputTests;
+    // Defined in reorderTest.cpp
+    extern const Span<const Test> reorderTests;
+    // Defined in samplerTest.cpp
+    extern const Span<const Test> samplerTests;
+    // Defined in sinkTest.cpp
+    extern const Span<const Test> sinkTests;
+    // Defined in timeIndexTest.cpp
+    extern const Span<const Test> timeIndexTests;
+
+}
+
+#endif
@@ -27,20 +27,13 @@ namespace vrep {
 
         // Converting a variadic template type to a Lua type list //
 
-        std::forward_list<int> toLuaTypes() {
+        std::forward_list<int> LuaTypeList<>::get() {
             return std::forward_list<int>();
         }
 
-        template<typename Car>
-        std::forward_list<int> toLuaTypes() {
-            std::forward_list<int> luaTypes = toLuaTypes();
-            luaTypes.push_front(LuaType<Car>::id);
-            return luaTypes;
-        }
-
-        template<typename Car, typename Cadr, typename ...Cddr>
-        std::forward_list<int> toLuaTypes() {
-            std::forward_list<int> luaTypes = toLuaTypes<Cadr, Cddr...>();
+        template<typename Car, typename ...Cdr>
+        std::forward_list<int> LuaTypeList<Car, Cdr...>::get() {
+            std::forward_list<int> luaTypes = LuaTypeList<Cdr...>::get();
             luaTypes.push_front(LuaType<Car>::id);
             return luaTypes;
         }
@@ -56,7 +49,7 @@ namespace vrep {
         // Compute the Lua signature.
         std::vector<int> luaTypes;
         luaTypes.push_back(0);
-        for (int type : toLuaTypes<Args...>()) {
+        for (int type : LuaTypeList<Args...>::get()) {
             luaTypes.push_back(type);
             // We just added an argument.
             luaTypes[0]++;
@@ -86,15 +79,31 @@ namespace vrep {
     }
 
     template<typename T>
-    std::vector<T> LuaCall::unsafeGetTable() {
-        // Determine how long the table is.
-        size_t tableLen;
-        if (simCall->inputArgTypeAndSize[2 * argIdx] & sim_lua_arg_table) {
-            tableLen = simCall->inputArgTypeAndSize[2 * argIdx + 1];
+    Span<const T> LuaCall::viewTable() {
+        ensureNextArgType(LuaType<std::vector<T>>::id);
+        T *&next = cursor<T>();
+        const Span<const T> result(next, nextArgLength());
+        next += result.size();
+        argIdx++;
+        return result;
+    }
+
+    template<typename T>
+    boost::optional<T> LuaCall::optionalAtom() {
+        if (! hasNextArg()) {
+            return boost::none;
+        } else if (simCall->inputArgTypeAndSize[2 * argIdx]
+                   == sim_lua_arg_nil) {
+            argIdx++;
+            return boost::none;
         } else {
-            tableLen = 1;
+            return expectAtom<T>();
         }
-        // Build the result.
+    }
+
+    template<typename T>
+    std::vector<T> LuaCall::unsafeGetTable() {
+        const size_t tableLen = nextArgLength();
         std::vector<T> result(tableLen);
         for (size_t i = 0; i < tableLen; i++) {
             result[i] = unsafeGetAtom<T>();
@@ -117,6 +126,24 @@ namespace vrep {
         return *cursorFloat++;
     }
 
+    size_t LuaCall::nextArgLength() const {
+        if (simCall->inputArgTypeAndSize[2 * argIdx] & sim_lua_arg_table) {
+            return simCall->inputArgTypeAndSize[2 * argIdx + 1];
+        } else {
+            return 1;
+        }
+    }
+
+    template<>
+    int *&LuaCall::cursor() {
+        return cursorInt;
+    }
+
+    template<>
+    float *&LuaCall::cursor() {
+        return cursorFloat;
+    }
+
 
     // Error handling //
 
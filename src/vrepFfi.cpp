@@ -22,10 +22,16 @@
 #   include <config.h>
 #endif
 
+#include <cstddef>
 #include <cstring>
 
 #include <string>
+#include <vector>
 
+#include <boost/optional.hpp>
+#include <v_repLib.h>
+
+#include "vrep.h"
 #include "vrepFfi.h"
 
 namespace vrep {
@@ -38,7 +44,18 @@ namespace vrep {
           cursorChar(simCall->inputChar) {
     }
 
+    bool LuaCall::hasNextArg() const {
+        return static_cast<int>(argIdx) < simCall->inputArgCount;
+    }
+
     void LuaCall::ensureNextArgType(const int expected) {
+        if (! hasNextArg()) {
+            throw MarshalingError("too few Lua arguments (expected type "
+                                  + std::to_string(expected)
+                                  + " in position "
+                                  + std::to_string(argIdx + 1)
+                                  + ")");
+        }
         const int nextType = simCall->inputArgTypeAndSize[2 * argIdx];
         if (nextType != expected) {
             throw MarshalingError("unexpected Lua argument (expected type "
@@ -49,19 +66,95 @@ namespace vrep {
         }
     }
 
+    boost::optional<int> LuaCall::optionalIntAt(const std::size_t index)
+        const {
+        if (static_cast<int>(index) >= simCall->inputArgCount
+            || simCall->inputArgTypeAndSize[2 * index] == sim_lua_arg_nil) {
+            return boost::none;
+        }
+        const int type = simCall->inputArgTypeAndSize[2 * index];
+        if (type != sim_lua_arg_int) {
+            throw MarshalingError("unexpected Lua argument (expected type "
+                                  + std::to_string(sim_lua_arg_int)
+                                  + ", got type "
+                                  + std::to_string(type)
+                                  + ")");
+        }
+        // Skip the integers passed in the arguments before it.
+        const simInt *value = simCall->inputInt;
+        for (std::size_t i = 0; i < index; i++) {
+            const int argType = simCall->inputArgTypeAndSize[2 * i];
+            if (argType == sim_lua_arg_int) {
+                value++;
+            } else if (argType == (sim_lua_arg_table | sim_lua_arg_int)) {
+                value += simCall->inputArgTypeAndSize[2 * i + 1];
+            }
+        }
+        return *value;
+    }
+
     template<>
     std::string LuaCall::unsafeGetAtom() {
-        // Determine how long the string is.  Lua uses '@' as its sentinel.
-        size_t len;
-        simChar *sentinel = std::strchr(cursorChar, '@');
-        if (sentinel) {
-            len = sentinel - cursorChar;
-        } else {
-            len = std::strlen(cursorChar);
+        // V-REP passes string arguments one after another, each terminated.
+        const std::string result(cursorChar);
+        cursorChar += result.size() + 1;
+        return result;
+    }
+
+
+    // Returning values from C++ to Lua //
+
+    LuaReturn::LuaReturn(SLuaCallBack *const simCall)
+        : simCall(simCall), typesAndSizes(), ints(), floats(), chars() {
+    }
+
+    void LuaReturn::addAtom(const int value) {
+        typesAndSizes.push_back(sim_lua_arg_int);
+        typesAndSizes.push_back(0);
+        ints.push_back(value);
+    }
+
+    void LuaReturn::addTable(const std::vector<int> &values) {
+        typesAndSizes.push_back(sim_lua_arg_table | sim_lua_arg_int);
+        typesAndSizes.push_back(values.size());
+        ints.insert(ints.end(), values.begin(), values.end());
+    }
+
+    void LuaReturn::addTable(const std::vector<float> &values) {
+        typesAndSizes.push_back(sim_lua_arg_table | sim_lua_arg_float);
+        typesAndSizes.push_back(values.size());
+        floats.insert(floats.end(), values.begin(), values.end());
+    }
+
+    void LuaReturn::addTable(const std::vector<std::string> &values) {
+        // V-REP takes the strings one after another, each terminated.
+        typesAndSizes.push_back(sim_lua_arg_table | sim_lua_arg_string);
+        typesAndSizes.push_back(values.size());
+        for (const std::string &value : values) {
+            chars.insert(chars.end(), value.begin(), value.end());
+            chars.push_back('\0');
+        }
+    }
+
+    void LuaReturn::commit() {
+        simCall->outputArgCount = typesAndSizes.size() / 2;
+        simCall->outputArgTypeAndSize = toBuffer(typesAndSizes);
+        simCall->outputInt = toBuffer(ints);
+        simCall->outputFloat = toBuffer(floats);
+        simCall->outputChar = toBuffer(chars);
+    }
+
+    template<typename T>
+    T *LuaReturn::toBuffer(const std::vector<T> &values) {
+        if (values.empty()) {
+            return nullptr;
+        }
+        simChar *const buffer = simCreateBuffer(values.size() * sizeof(T));
+        if (buffer == nullptr) {
+            throw Error("V-REP function invocation simCreateBuffer failed");
         }
-        // Build the 'std::string'.
-        const std::string result = std::string(cursorChar, len);
-        cursorChar += len + (sentinel ? 1 : 0);
+        T *const result = reinterpret_cast<T *>(buffer);
+        std::memcpy(result, values.data(), values.size() * sizeof(T));
         return result;
     }
 
@@ -32,8 +32,10 @@
 #include <string>
 #include <vector>
 
+#include <boost/optional.hpp>
 #include <v_repLib.h>
 
+#include "span.h"
 #include "vrep.h"
 
 namespace vrep {
@@ -88,13 +90,20 @@ namespace vrep {
 
         // Converting a variadic template type to a Lua type list //
 
-        std::forward_list<int> toLuaTypes();
+        /* A class rather than overloaded functions, so the list can be
+         * empty. */
+        template<typename ...Args>
+        struct LuaTypeList;
 
-        template<typename Car>
-        std::forward_list<int> toLuaTypes();
+        template<>
+        struct LuaTypeList<> {
+            static inline std::forward_list<int> get();
+        };
 
-        template<typename Car, typename Cadr, typename ...Cddr>
-        std::forward_list<int> toLuaTypes();
+        template<typename Car, typename ...Cdr>
+        struct LuaTypeList<Car, Cdr...> {
+            static inline std::forward_list<int> get();
+        };
     }
 
 
@@ -120,7 +129,30 @@ namespace vrep {
         template<typename T>
         std::vector<T> expectTable();
 
+        /* Like 'expectTable', but returns a view of the table in V-REP's
+         * argument buffer instead of copying it.  The view is valid until the
+         * exposed C++ function returns.  Only numeric tables ('int' and
+         * 'float') can be viewed. */
+        template<typename T>
+        Span<const T> viewTable();
+
+        /* Like 'expectAtom', but returns 'boost::none' if the caller passed
+         * nil or ran out of arguments.  Use this for optional trailing
+         * arguments. */
+        template<typename T>
+        boost::optional<T> optionalAtom();
+
+        /* The integer the caller passed in the argument at 'index' (counting
+         * from zero), or 'boost::none' if they passed nil or fewer
+         * arguments.  Unlike the functions above, this reads any argument
+         * without moving on, so a trailing optional argument can be read
+         * before the ones ahead of it. */
+        boost::optional<int> optionalIntAt(std::size_t index) const;
+
     private:
+        // Returns true iff the caller passed an argument in the next slot.
+        bool hasNextArg() const;
+
         void ensureNextArgType(const int expected);
 
         template<typename T>
@@ -129,6 +161,13 @@ namespace vrep {
         template<typename T>
         std::vector<T> unsafeGetTable();
 
+        // The number of elements in the next argument
+        inline size_t nextArgLength() const;
+
+        // The cursor into V-REP's buffer for arguments of each type
+        template<typename T>
+        T *&cursor();
+
         SLuaCallBack *const simCall;
         size_t argIdx;
         simBool *cursorBool;
@@ -140,6 +179,41 @@ namespace vrep {
     template<> inline int LuaCall::unsafeGetAtom();
     template<> inline float LuaCall::unsafeGetAtom();
     template<> std::string LuaCall::unsafeGetAtom();
+    template<> inline int *&LuaCall::cursor();
+    template<> inline float *&LuaCall::cursor();
+
+
+    // Returning values from C++ to Lua //
+
+    /* Collects the values a C++ function exposed to Lua returns, then hands
+     * them to V-REP, in buffers V-REP frees, with 'commit'.  Only integers and
+     * tables are supported so far. */
+    class LuaReturn {
+    public:
+        explicit LuaReturn(SLuaCallBack *);
+        LuaReturn(const LuaReturn &) = delete;
+        LuaReturn &operator=(const LuaReturn &) = delete;
+
+        void addAtom(int);
+        void addTable(const std::vector<int> &);
+        void addTable(const std::vector<float> &);
+        void addTable(const std::vector<std::string> &);
+
+        /* Hands the values added so far to V-REP.  Call this last, once
+         * nothing else can throw. */
+        void commit();
+
+    private:
+        // Copies values into a buffer from V-REP, or returns null if empty.
+        template<typename T>
+        static T *toBuffer(const std::vector<T> &);
+
+        SLuaCallBack *const simCall;
+        std::vector<simInt> typesAndSizes;
+        std::vector<simInt> ints;
+        std::vector<simFloat> floats;
+        std::vector<simChar> chars;
+    };
 
 
     // Error handling //
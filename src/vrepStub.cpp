@@ -0,0 +1,227 @@
+/* vrepStub.cpp -- a stand-in for the V-REP library, for running the plugin without V-REP
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <cstdlib>
+#include <cstring>
+
+#include <map>
+#include <stdexcept>
+#include <string>
+
+#include <v_repLib.h>
+
+#include "span.h"
+#include "vrepStub.h"
+
+namespace {
+
+    typedef simVoid LuaFunc(SLuaCallBack *);
+
+    // The functions registered so far, by name
+    std::map<std::string, LuaFunc *> &registeredFunctions() {
+        static std::map<std::string, LuaFunc *> functions;
+        return functions;
+    }
+
+    // A version new enough for anything the plugin checks
+    simInt version = 30200;
+
+    // Something for loadVrepLibrary to point to
+    char library;
+
+    simInt registerCustomLuaFunction(const simChar *const name,
+                                     const simChar *, const simInt *,
+                                     LuaFunc *const function) {
+        registeredFunctions()[name] = function;
+        return 1;
+    }
+
+    simInt lockInterface(simBool) {
+        return 1;
+    }
+
+    simChar *createBuffer(const simInt size) {
+        return static_cast<simChar *>(std::malloc(size == 0 ? 1 : size));
+    }
+
+    simInt releaseBuffer(simChar *const buffer) {
+        std::free(buffer);
+        return 1;
+    }
+
+    simInt getIntegerParameter(const simInt parameter, simInt *const state) {
+        if (parameter != sim_intparam_program_version) {
+            return -1;
+        }
+        *state = version;
+        return 1;
+    }
+
+}
+
+
+// The V-REP library's interface //
+
+ptrSimRegisterCustomLuaFunction simRegisterCustomLuaFunction =
+    registerCustomLuaFunction;
+ptrSimLockInterface simLockInterface = lockInterface;
+ptrSimGetIntegerParameter simGetIntegerParameter = getIntegerParameter;
+ptrSimCreateBuffer simCreateBuffer = createBuffer;
+ptrSimReleaseBuffer simReleaseBuffer = releaseBuffer;
+
+LIBRARY loadVrepLibrary(const char *) {
+    return &library;
+}
+
+void unloadVrepLibrary(LIBRARY) {
+}
+
+int getVrepProcAddresses(LIBRARY) {
+    return 1;
+}
+
+
+namespace vrepStub {
+
+    void setVersion(const simInt newVersion) {
+        version = newVersion;
+    }
+
+    bool isRegistered(const std::string &name) {
+        return registeredFunctions().count(name) != 0;
+    }
+
+    void call(const std::string &name, SLuaCallBack *const callBack) {
+        const std::map<std::string, LuaFunc *>::const_iterator function =
+            registeredFunctions().find(name);
+        if (function == registeredFunctions().end()) {
+            throw std::invalid_argument("no Lua function `" + name
+                                        + "' has been registered");
+        }
+        function->second(callBack);
+    }
+
+
+    // class LuaCallBuilder
+
+    LuaCallBuilder::LuaCallBuilder()
+        : typesAndSizes(), bools(), ints(), floats(), chars() {
+        std::memset(&callBack, 0, sizeof callBack);
+    }
+
+    LuaCallBuilder::~LuaCallBuilder() {
+        releaseOutputs();
+    }
+
+    void LuaCallBuilder::clear() {
+        releaseOutputs();
+        typesAndSizes.clear();
+        bools.clear();
+        ints.clear();
+        floats.clear();
+        chars.clear();
+    }
+
+    LuaCallBuilder &LuaCallBuilder::nil() {
+        addType(sim_lua_arg_nil, 0);
+        return *this;
+    }
+
+    LuaCallBuilder &LuaCallBuilder::boolean(const bool value) {
+        addType(sim_lua_arg_bool, 0);
+        bools.push_back(value);
+        return *this;
+    }
+
+    LuaCallBuilder &LuaCallBuilder::integer(const int value) {
+        addType(sim_lua_arg_int, 0);
+        ints.push_back(value);
+        return *this;
+    }
+
+    LuaCallBuilder &LuaCallBuilder::number(const float value) {
+        addType(sim_lua_arg_float, 0);
+        floats.push_back(value);
+        return *this;
+    }
+
+    LuaCallBuilder &LuaCallBuilder::string(const std::string &value) {
+        // Strings are packed one after another, each terminated.
+        addType(sim_lua_arg_string, 0);
+        chars.insert(chars.end(), value.begin(), value.end());
+        chars.push_back('\0');
+        return *this;
+    }
+
+    LuaCallBuilder &LuaCallBuilder::integerTable(const Span<const int> values) {
+        addType(sim_lua_arg_table | sim_lua_arg_int, values.size());
+        ints.insert(ints.end(), values.begin(), values.end());
+        return *this;
+    }
+
+    LuaCallBuilder &LuaCallBuilder::numberTable(
+        const Span<const float> values) {
+        addType(sim_lua_arg_table | sim_lua_arg_float, values.size());
+        floats.insert(floats.end(), values.begin(), values.end());
+        return *this;
+    }
+
+    SLuaCallBack *LuaCallBuilder::get() {
+        /* The buffers may have moved since the last call, so point into them
+         * afresh. */
+        callBack.inputArgCount = typesAndSizes.size() / 2;
+        callBack.inputArgTypeAndSize = typesAndSizes.data();
+        callBack.inputBool = bools.data();
+        callBack.inputInt = ints.data();
+        callBack.inputFloat = floats.data();
+        callBack.inputChar = chars.data();
+        return &callBack;
+    }
+
+    void LuaCallBuilder::call(const std::string &name) {
+        releaseOutputs();
+        vrepStub::call(name, get());
+    }
+
+    void LuaCallBuilder::addType(const int type, const simInt size) {
+        typesAndSizes.push_back(type);
+        typesAndSizes.push_back(size);
+    }
+
+    void LuaCallBuilder::releaseOutputs() {
+        simReleaseBuffer(reinterpret_cast<simChar *>(
+                             callBack.outputArgTypeAndSize));
+        simReleaseBuffer(reinterpret_cast<simChar *>(callBack.outputBool));
+        simReleaseBuffer(reinterpret_cast<simChar *>(callBack.outputInt));
+        simReleaseBuffer(reinterpret_cast<simChar *>(callBack.outputFloat));
+        simReleaseBuffer(callBack.outputChar);
+        callBack.outputArgCount = 0;
+        callBack.outputArgTypeAndSize = nullptr;
+        callBack.outputBool = nullptr;
+        callBack.outputInt = nullptr;
+        callBack.outputFloat = nullptr;
+        callBack.outputChar = nullptr;
+    }
+
+}
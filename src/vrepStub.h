@@ -0,0 +1,109 @@
+/* vrepStub.h -- a stand-in for the V-REP library, for running the plugin without V-REP
+ * Copyright (C) 2014  Galois, Inc.
+ *
+ * This library is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * To contact Galois, complete the Web form at <http://corp.galois.com/contact/>
+ * or write to Galois, Inc., 421 Southwest 6th Avenue, Suite 300, Portland,
+ * Oregon, 97204-1622. */
+
+#ifndef PPAML_VREP_AUTOMOBILE_PLUGIN_VREPSTUB_H_
+#define PPAML_VREP_AUTOMOBILE_PLUGIN_VREPSTUB_H_
+
+#ifdef HAVE_CONFIG_H
+#   include <config.h>
+#endif
+
+#include <string>
+#include <vector>
+
+#include <v_repLib.h>
+
+#include "span.h"
+
+/* The plugin normally links against libv_repLib, which looks the sim*
+ * functions up in a running V-REP.  Linking libautomobile against
+ * libv_repStub instead gives a program the whole plugin with no V-REP at all:
+ *
+ *   - simRegisterCustomLuaFunction remembers each function by name, so the
+ *     program can call it with 'call';
+ *   - simLockInterface does nothing;
+ *   - simGetIntegerParameter reports a version of the program's choosing;
+ *   - simCreateBuffer and simReleaseBuffer use malloc and free;
+ *   - loading "the V-REP library" always succeeds, so v_repStart works.
+ *
+ * Calls are built with 'LuaCallBuilder', which lays the arguments out the way
+ * V-REP does.  None of this is thread-safe; like V-REP, drive the plugin from
+ * one thread. */
+namespace vrepStub {
+
+    // Sets the version simGetIntegerParameter reports.
+    void setVersion(simInt);
+
+    // Whether a Lua function has been registered under the passed name
+    bool isRegistered(const std::string &name);
+
+    /* Calls the Lua function registered under the passed name.  Throws a
+     * 'std::invalid_argument' if there is none.  Exceptions from the function
+     * itself propagate. */
+    void call(const std::string &name, SLuaCallBack *);
+
+    /* Builds the 'SLuaCallBack' V-REP passes to a Lua function.  Clearing a
+     * builder keeps its buffers, so a program can drive a function over and
+     * over without allocating once the buffers have grown.
+     *
+     * Values the function returns are left in the call's output fields (see
+     * 'get') until the builder is next cleared or called with, which frees
+     * them as V-REP would. */
+    class LuaCallBuilder {
+    public:
+        LuaCallBuilder();
+        ~LuaCallBuilder();
+        LuaCallBuilder(const LuaCallBuilder &) = delete;
+        LuaCallBuilder &operator=(const LuaCallBuilder &) = delete;
+
+        // Drops the arguments added so far, and the last call's results.
+        void clear();
+
+        // Adds an argument.
+        LuaCallBuilder &nil();
+        LuaCallBuilder &boolean(bool);
+        LuaCallBuilder &integer(int);
+        LuaCallBuilder &number(float);
+        LuaCallBuilder &string(const std::string &);
+        LuaCallBuilder &integerTable(Span<const int>);
+        LuaCallBuilder &numberTable(Span<const float>);
+
+        /* The call, with the arguments added so far.  It points into the
+         * builder, so it is good until the builder next changes. */
+        SLuaCallBack *get();
+
+        // Calls the named function with the arguments added so far.
+        void call(const std::string &name);
+
+    private:
+        void addType(int type, simInt size);
+        void releaseOutputs();
+
+        std::vector<simInt> typesAndSizes;
+        std::vector<simBool> bools;
+        std::vector<simInt> ints;
+        std::vector<simFloat> floats;
+        std::vector<simChar> chars;
+        SLuaCallBack callBack;
+    };
+
+}
+
+#endif